@@ -153,6 +153,11 @@
  * rather expensive: It takes time to run the garbage collector, and
  * even worse is that the internal operation cache is cleared on each
  * invocation. You can add hooks to the garbage collector.
+ *
+ * After long runs the live nodes end up scattered over many chunks,
+ * which makes traversals slow. The garbage collector can optionally
+ * compact the nodes, relocating them into fresh chunks in level
+ * order. See \c cdd_compact() and \c cdd_compact_threshold().
  */
 
 /**
@@ -166,6 +171,13 @@
 #include <dbm/dbm.h>
 
 #ifdef __cplusplus
+#include <utility>
+#include <vector>
+
+namespace dbm {
+class fed_t;
+}
+
 extern "C" {
 #endif
 
@@ -195,6 +207,12 @@ extern "C" {
 /** Base type for decision diagram nodes. */
 typedef struct node_ ddNode;
 
+/** An instance of the library. @see cdd_context_create() */
+typedef struct cddcontext_ cdd_context;
+
+/** A walk over the zones of a CDD. @see cdd_dbm_iterator_create() */
+typedef struct cdd_dbm_iterator_ cdd_dbm_iterator;
+
 /** Structure with information about garbage collection runs. */
 typedef struct s_CddGbcStat
 {
@@ -217,6 +235,45 @@ typedef struct s_CddRehashStat
     int64_t sumtime; /**< Accumulated time used to rehash */
 } CddRehashStat;
 
+/** Structure with information about compactions */
+typedef struct s_CddCompactStat
+{
+    int32_t moved;   /**< Number of nodes relocated */
+    int32_t pinned;  /**< Number of nodes left in place */
+    int32_t chunks;  /**< Number of chunks after compaction */
+    int32_t freed;   /**< Number of chunks returned to the OS */
+    int64_t time;    /**< Time used to compact, i.e. the pause */
+    int64_t sumtime; /**< Accumulated time used to compact */
+    int32_t num;     /**< How many times we have compacted */
+} CddCompactStat;
+
+/**
+ * Structure with information about the lookups in an operation
+ * cache. Garbage collection voids all entries at once rather than
+ * scanning the cache for those of collected nodes, so the pause does
+ * not grow with the cache size. Entries of live nodes are lost as
+ * well; \c stale counts the lookups which would have found one.
+ */
+typedef struct s_CddCacheStat
+{
+    int64_t lookups;    /**< Number of lookups */
+    int64_t hits;       /**< Number of lookups finding the result */
+    int64_t overwrites; /**< Number of misses replacing another entry */
+    int64_t reclaims;   /**< Number of hits on a result which was garbage */
+    int64_t stale;      /**< Number of misses on an entry voided by garbage collection */
+} CddCacheStat;
+
+/** Structure with information about the operation caches of a context */
+typedef struct s_CddCacheStats
+{
+    CddCacheStat apply;   /**< Cache of \c cdd_apply() and \c cdd_reduce() */
+    CddCacheStat quant;   /**< Cache of the quantification operations */
+    CddCacheStat replace; /**< Cache of \c cdd_replace() */
+    CddCacheStat test;    /**< Cache of \c cdd_equiv(), \c cdd_is_empty() and \c cdd_subset() */
+    CddCacheStat relax;   /**< Cache of \c cdd_relax() */
+    CddCacheStat ite;     /**< Cache of \c cdd_ite() and \c cdd_and_exist() */
+} CddCacheStats;
+
 /** Structure with information about a level in a decision diagram */
 typedef struct
 {
@@ -233,6 +290,78 @@ typedef struct
 //#define CDD_CLOCK2(t) ((t) & 0x3FF)
 //#define CDD_ISVALIDDIFF(t) (CDD_CLOCK1(t) < CDD_CLOCK2(t))
 
+/**
+ * @name Contexts
+ * All state of the library is kept in a context. Each thread has a
+ * current context on which all other functions of the library
+ * operate. Initially this is the default context, which is shared by
+ * all threads. Additional contexts are completely independent
+ * instances of the library and can be used concurrently, one per
+ * thread. Decision diagrams (including \c cdd objects) must only be
+ * used and destroyed while the context in which they were created
+ * is current.
+ * @{
+ */
+
+/**
+ * Allocate a new context. The context must be made current with \c
+ * cdd_context_set() and initialised with \c cdd_init() before use.
+ * @return a new uninitialised context or NULL if out of memory
+ */
+extern cdd_context* cdd_context_create();
+
+/**
+ * Release a context. If the context is initialised, \c cdd_done()
+ * is called on it first. If it is the current context of the
+ * calling thread, the default context becomes current. The default
+ * context cannot be destroyed.
+ * @param ctx a context returned by \c cdd_context_create()
+ */
+extern void cdd_context_destroy(cdd_context* ctx);
+
+/**
+ * Make \a ctx the current context of the calling thread.
+ * @param ctx a context, or NULL for the default context
+ * @return the previously current context
+ */
+extern cdd_context* cdd_context_set(cdd_context* ctx);
+
+/**
+ * Returns the current context of the calling thread.
+ * @return the current context
+ */
+extern cdd_context* cdd_context_get();
+
+/**
+ * Returns the default context.
+ * @return the default context
+ */
+extern cdd_context* cdd_context_default();
+
+#ifdef CDD_CONCURRENT
+/**
+ * Initialise \a ctx to share the nodes of the current context. The
+ * shared context has its own operation caches and reference stack,
+ * so each thread can make its own share current and build decision
+ * diagrams in the same node tables as the other threads, i.e. equal
+ * diagrams are represented by the same node in all of them.
+ *
+ * All variables must be declared before the first share is created.
+ * Garbage is only collected, on allocation or by \c cdd_gbc(), while
+ * no shares exist (idle workers of \c cdd_apply_parallel() do not
+ * count). Shares must be released with \c cdd_done() or \c
+ * cdd_context_destroy() before the owning context.
+ * Only available when the library is built with \c CDD_CONCURRENT.
+ * @param ctx       an uninitialised context
+ * @param cs        initial number of entries in each operation cache.
+ * @param stacksize initial size of stack used to keep temporary references.
+ * @return 0 on success or a negative error code
+ */
+extern int32_t cdd_context_share(cdd_context* ctx, int32_t cs, size_t stacksize);
+#endif
+
+/** @} */
+
 /**
  * @name Initialisation and Information
  * Functions for library initialisation and for querying the
@@ -241,17 +370,18 @@ typedef struct
  */
 
 /**
- * Initialise CDD library.
+ * Initialise CDD library. Only the current context is initialised.
  * @param maxsize   the maximum arity of a decision diagram node.
- * @param cs        number of entries in operation cache.
- * @param stacksize size of stack used to keep temporary references.
+ * @param cs        initial number of entries in each operation cache.
+ * @param stacksize initial size of stack used to keep temporary references.
+ *                  The stack grows on demand.
  * @return 0 on success, or a non-zero error code on failure
  */
 extern int32_t cdd_init(int32_t maxsize, int32_t cs, size_t stacksize);
 
 /**
  * Deinitialized CDD library. This method frees all resources allocated
- * by the library.
+ * by the library in the current context.
  */
 extern void cdd_done();
 
@@ -297,7 +427,8 @@ extern void cdd_add_clocks(int32_t n);
  * BDD/CDD. They are like tautologies but we want to
  * know which one will be evaluated to true instead of just "true".
  * This function should never be called after nodes containing
- * extra terminals have been created.
+ * extra terminals have been created. If memory is exhausted, fewer
+ * terminals are added and the error condition is set.
  */
 extern void cdd_add_tautologies(int32_t n);
 
@@ -342,10 +473,33 @@ extern int32_t cdd_get_number_of_tautologies();
 extern int32_t cdd_get_level_count();
 
 /**
- * Checks for equivalence between two CDDs.
+ * Checks for equivalence between two CDDs. The CDDs are walked
+ * together along consistent paths only, without making any nodes,
+ * and the walk stops at the first path on which they differ.
+ * Results for subgraphs not below a clock constraint are cached
+ * until the next garbage collection.
  */
 extern int32_t cdd_equiv(ddNode* c, ddNode* d);
 
+/**
+ * Checks whether a CDD is empty, i.e. has no consistent path to
+ * true, like \c cdd_equiv(c, cddfalse) but cheaper than reducing \a
+ * c and comparing it with \c cddfalse.
+ * @param c a cdd
+ * @return 1 if \a c is empty, 0 otherwise
+ */
+extern int32_t cdd_is_empty(ddNode* c);
+
+/**
+ * Checks for inclusion between two CDDs, like \c cdd_is_empty() of
+ * \a c minus \a d but without making any nodes. The walk stops at
+ * the first consistent path on which \a c holds and \a d does not.
+ * @param c a cdd
+ * @param d a cdd
+ * @return 1 if \a c is included in \a d, 0 otherwise
+ */
+extern int32_t cdd_subset(ddNode* c, ddNode* d);
+
 /**
  * Returns the number of BDD levels.
  */
@@ -364,6 +518,21 @@ extern int32_t cdd_getclocks();
  */
 extern int32_t cdd_isrunning();
 
+/**
+ * Returns the error condition of the current context. It is set by
+ * the first operation which fails, e.g. with \c CDD_MEMORY or \c
+ * CDD_STACKOVERFLOW, and stays set until \c cdd_clear_error() is
+ * called. Meanwhile all operations return NULL.
+ * @return an error code, or 0 if no operation has failed
+ */
+extern int32_t cdd_get_error();
+
+/**
+ * Clears the error condition of the current context, such that
+ * operations can be used again after an error has been handled.
+ */
+extern void cdd_clear_error();
+
 /**
  * Returns the version identification of the library.
  * @return the version string
@@ -433,6 +602,14 @@ extern void cdd_prerehash_hook(void (*func)(void));
  */
 extern void cdd_postrehash_hook(void (*func)(CddRehashStat*));
 
+/**
+ * Set post compaction hook. The hook is called after each compaction
+ * of the node tables.
+ * @param func a pointer to a function taking a CddCompactStat pointer argument
+ * @see cdd_compact
+ */
+extern void cdd_postcompact_hook(void (*func)(CddCompactStat*));
+
 /**
  * The default post GBC hook. It will print the GBC information to stderr.
  * @param info pointer to a GBC statistics structure.
@@ -447,13 +624,91 @@ extern void cdd_default_gbhandler(CddGbcStat* info);
  */
 extern void cdd_default_rehashhandler(CddRehashStat* info);
 
+/**
+ * The default post compaction hook. It will print the information to stderr.
+ * @param info compaction information
+ * @see cdd_postcompact_hook
+ */
+extern void cdd_default_compacthandler(CddCompactStat* info);
+
 /**
  * Trigger a garbage collector. The library will automatically run
  * the garbage collector when needed, but it can be triggered manually with
- * this function.
+ * this function. It does nothing while contexts sharing the nodes of
+ * the current one (see \c cdd_context_share()) are in use.
  */
 extern void cdd_gbc();
 
+/**
+ * Get the lookup statistics of the operation caches of the current
+ * context, accumulated since \c cdd_init(). Hit rates help choosing
+ * the ceiling passed to \c cdd_cache_limit(). The statistics are all
+ * zero unless the library is built with \c CDD_CACHESTATS.
+ * @param stats structure receiving the statistics
+ */
+extern void cdd_cache_stats(CddCacheStats* stats);
+
+/**
+ * Set the memory ceiling of the operation caches of the current
+ * context. The caches start with the size passed to \c cdd_init()
+ * and grow and shrink with the number of nodes in use and their hit
+ * rates, such that they together never take more than \a bytes,
+ * except for a minimum size of each. Caches above the ceiling are
+ * shrunk right away, discarding their entries. The default is 64MB.
+ * @param bytes memory ceiling, or 0 to keep the size of the caches fixed
+ */
+extern void cdd_cache_limit(size_t bytes);
+
+/**
+ * Set the number of empty chunks of nodes a node manager keeps after
+ * garbage collection. Chunks beyond this are returned to the OS, such
+ * that memory use shrinks after a peak. The default is 16.
+ * @param chunks number of empty chunks to keep
+ */
+extern void cdd_chunk_retention(int32_t chunks);
+
+/**
+ * Compact the node tables. All garbage is collected and the live
+ * nodes are relocated into fresh chunks, grouped by level and laid
+ * out in depth first order from the roots, such that traversals touch
+ * fewer cache lines and pages. Registered roots (see \c
+ * cdd_register_root()), which include the roots of \c cdd objects
+ * while root tracking is enabled, are updated. Nodes with references
+ * from elsewhere are left in place. Unreferenced nodes must not be
+ * used afterwards and the operation caches are cleared.
+ */
+extern void cdd_compact();
+
+/**
+ * Enable compaction when garbage is collected by \c cdd_gbc() and
+ * the free nodes in chunks holding live nodes exceed \a percent of
+ * those chunks. This also enables tracking of the roots of \c cdd
+ * objects, so it should be called before any of them is created.
+ * Compaction is never started by allocation, as the operations keep
+ * pointers to nodes on the C stack. The default is 0 (disabled).
+ * @param percent fragmentation threshold, or 0 to disable compaction
+ * @see cdd_compact
+ */
+extern void cdd_compact_threshold(int32_t percent);
+
+/**
+ * Register a location holding a reference to a node, such that \c
+ * cdd_compact() updates it when the node is relocated. Does nothing
+ * unless root tracking has been enabled by \c
+ * cdd_compact_threshold(). The location must be unregistered before
+ * it goes out of scope. If the root table cannot grow, \c CDD_MEMORY
+ * is reported and the location may not be tracked, in which case
+ * compaction leaves its node in place.
+ * @param root location of a node pointer
+ */
+extern void cdd_register_root(ddNode** root);
+
+/**
+ * Unregister a location registered by \c cdd_register_root().
+ * @param root location of a node pointer
+ */
+extern void cdd_unregister_root(ddNode** root);
+
 /** @} */
 
 // extern int32_t         cdd_setmaxnodenum(int);
@@ -504,6 +759,29 @@ extern ddNode* cdd_bddvar(int32_t level);
  */
 extern ddNode* cdd_apply(ddNode* left, ddNode* right, int32_t op);
 
+/**
+ * Performs a binary operation on two decision diagrams using \a
+ * nthreads threads. The applies on the children of the nodes near
+ * the roots are forked as tasks onto a work-stealing pool of
+ * threads, which share the nodes of the current context and are
+ * kept until the context is released. Below the cutoff depth set by
+ * \c cdd_parallel_cutoff() the operation is sequential. Without \c
+ * CDD_CONCURRENT this is the same as \c cdd_apply().
+ * @param left     the left argument to the operation
+ * @param right    the right argument to the operation
+ * @param op       the binary operation to perform
+ * @param nthreads the number of threads, including the calling one
+ * @return the resulting decision diagram
+ */
+extern ddNode* cdd_apply_parallel(ddNode* left, ddNode* right, int32_t op, int32_t nthreads);
+
+/**
+ * Set the depth up to which \c cdd_apply_parallel() forks tasks in
+ * the current context. The default is 8.
+ * @param depth the cutoff depth
+ */
+extern void cdd_parallel_cutoff(int32_t depth);
+
 /**
  * Performs a binary operation on two decision diagrams. The
  * result is in semi-canonical form.
@@ -545,15 +823,117 @@ extern int32_t cdd_edgecount(ddNode* dd);
  */
 extern ddNode* cdd_exist(ddNode*, int32_t*, int32_t*, int32_t, int32_t);
 
+/**
+ * Existential quantification of a conjunction, i.e. \c cdd_exist()
+ * of \a l & \a r without making the conjunction in full. Boolean
+ * levels are quantified while the two CDDs are walked together, and
+ * the conjunction is only made below the first level constraining a
+ * quantified clock.
+ * @param l a cdd
+ * @param r a cdd
+ * @param levels boolean levels to quantify
+ * @param clocks clocks to quantify
+ * @param num_bools the number of elements of \a levels
+ * @param num_clocks the number of elements of \a clocks
+ * @return the quantified conjunction
+ */
+extern ddNode* cdd_and_exist(ddNode* l, ddNode* r, int32_t* levels, int32_t* clocks, int32_t num_bools,
+                             int32_t num_clocks);
+
 /**
  * Variable substitution. @todo
  */
 extern ddNode* cdd_replace(ddNode*, int32_t*, int32_t*);
 
 /**
- * If then else operation. @todo
+ * Register the arguments of \c cdd_exist() for repeated use. The
+ * arrays are copied. Quantifying with the returned handle through \c
+ * cdd_exist_set() reuses the results cached by earlier calls with the
+ * same handle, whereas every call to \c cdd_exist() starts afresh.
+ * Handles belong to the current context and stay valid until \c
+ * cdd_done().
+ * @param levels boolean levels to quantify
+ * @param clocks clocks to quantify
+ * @param num_bools the number of elements of \a levels
+ * @param num_clocks the number of elements of \a clocks
+ * @return a handle, or a negative error code
+ */
+extern int32_t cdd_register_exist_set(int32_t* levels, int32_t* clocks, int32_t num_bools, int32_t num_clocks);
+
+/**
+ * Existential quantification of a set registered with \c
+ * cdd_register_exist_set().
+ * @param cdd a cdd
+ * @param handle the handle of the set
+ * @return \a cdd with the variables of the set quantified, or NULL
+ *      if \a handle is not an exist set or variables were added
+ *      since it was registered
+ */
+extern ddNode* cdd_exist_set(ddNode* cdd, int32_t handle);
+
+/**
+ * Existential quantification of a conjunction like \c
+ * cdd_and_exist(), for a set registered with \c
+ * cdd_register_exist_set().
+ * @param l a cdd
+ * @param r a cdd
+ * @param handle the handle of the set
+ * @return the quantified conjunction, or NULL if \a handle is not an
+ *      exist set or variables were added since it was registered
+ */
+extern ddNode* cdd_and_exist_set(ddNode* l, ddNode* r, int32_t handle);
+
+/**
+ * Register the arguments of \c cdd_replace() for repeated use, like
+ * \c cdd_register_exist_set(). The map covers the levels and clocks
+ * existing when it is registered.
+ * @param levels the new level of each level
+ * @param clocks the new clock of each clock
+ * @return a handle, or a negative error code
+ */
+extern int32_t cdd_register_replace_map(int32_t* levels, int32_t* clocks);
+
+/**
+ * Variable substitution with a map registered with \c
+ * cdd_register_replace_map().
+ * @param cdd a cdd
+ * @param handle the handle of the map
+ * @return \a cdd with the variables renamed, or NULL if \a handle
+ *      is not a replace map or variables were added since it was
+ *      registered
+ */
+extern ddNode* cdd_replace_map(ddNode* cdd, int32_t handle);
+
+/**
+ * Delay, i.e. the valuations reachable from \a cdd by letting time
+ * pass. The CDD is transformed node by node without splitting it into
+ * zones, and results are cached per node. Clock values are not
+ * required to be positive; use \c cdd_remove_negative() on \a cdd to
+ * delay only its non-negative valuations.
+ * @param cdd a cdd
+ * @return the delayed cdd
+ */
+extern ddNode* cdd_up(ddNode* cdd);
+
+/**
+ * Past, i.e. the valuations from which \a cdd is reached by letting
+ * time pass, computed like \c cdd_up(). The result contains negative
+ * clock values unless it is restricted with \c cdd_remove_negative().
+ * @param cdd a cdd
+ * @return the past of \a cdd
  */
-extern ddNode* cdd_ite(ddNode*, ddNode*, ddNode*);
+extern ddNode* cdd_down(ddNode* cdd);
+
+/**
+ * If then else operation, i.e. (\a f & \a g) | (!\a f & \a h). The
+ * three diagrams are traversed together in one recursion, falling
+ * back to \c cdd_apply() when \a g or \a h is constant.
+ * @param f the condition
+ * @param g the diagram where \a f holds
+ * @param h the diagram where \a f does not hold
+ * @return the resulting decision diagram
+ */
+extern ddNode* cdd_ite(ddNode* f, ddNode* g, ddNode* h);
 
 /**
  * Another reduced form? @todo
@@ -602,6 +982,39 @@ extern ddNode* cdd_extract_dbm(ddNode* cdd, raw_t* dbm, uint32_t dim);
  */
 extern ddNode* cdd_extract_bdd(ddNode* cdd, uint32_t dim);
 
+/**
+ * Start a walk over the zones of \a cdd. The walk follows the paths
+ * of \a cdd depth first and keeps the closed DBM of the current path,
+ * so paths whose constraints are inconsistent or only hold for
+ * negative clock values are skipped without building any nodes. The
+ * zones yielded are disjoint and, together with their BDD parts, make
+ * up \a cdd; \a cdd need not be reduced. \a cdd is referenced by the
+ * iterator until it is destroyed.
+ * @param cdd a cdd
+ * @param dim the dimension of the DBMs, at least the number of clocks of \a cdd
+ * @return an iterator, or NULL if out of memory
+ * @see cdd_dbm_iterator_next()
+ */
+extern cdd_dbm_iterator* cdd_dbm_iterator_create(ddNode* cdd, uint32_t dim);
+
+/**
+ * Advance a walk over the zones of a CDD to the next path that does not
+ * end in false. The BDD part is the node below the last clock
+ * difference of the path, i.e. a BDD node or a terminal; it stays
+ * referenced until the next call.
+ * @param it an iterator
+ * @param dbm a DBM receiving the zone of the path
+ * @param bdd_part receives the BDD part of the path
+ * @return 1 if a path was found, 0 at the end of the walk
+ */
+extern int32_t cdd_dbm_iterator_next(cdd_dbm_iterator* it, raw_t* dbm, ddNode** bdd_part);
+
+/**
+ * End a walk over the zones of a CDD and release its resources.
+ * @param it an iterator
+ */
+extern void cdd_dbm_iterator_destroy(cdd_dbm_iterator* it);
+
 /**
  * Print a CDD \a r as a dot input file \a ofile.\n\n
  *
@@ -750,7 +1163,11 @@ public:
     /**
      * Default constructor. Constructs a NULL decision tree.
      */
-    cdd() { assert(cdd_isrunning()); }
+    cdd()
+    {
+        assert(cdd_isrunning());
+        cdd_register_root(&root);
+    }
 
     /**
      * Copy constructor.
@@ -760,12 +1177,17 @@ public:
 
     /**
      * Construct from DBM.
+     * @throws std::bad_alloc or std::runtime_error if the CDD cannot
+     * be built, see cdd(ddNode*)
      */
     cdd(const raw_t* dbm, uint32_t dim);
 
     /**
      * Construct cdd object by wrapping a ddNode pointer.
-     * @param r a ddNode
+     * @param r a ddNode, or the NULL returned by a failed operation
+     * @throws std::bad_alloc if \a r is NULL because memory ran out,
+     * std::runtime_error if it is NULL for another error. The error
+     * condition is cleared.
      */
     explicit cdd(ddNode* r);
 
@@ -889,6 +1311,8 @@ private:
     friend cdd cdd_extract_dbm(const cdd&, raw_t* dbm, uint32_t dim);
     friend cdd cdd_extract_bdd(const cdd&, uint32_t dim);
     friend extraction_result cdd_extract_bdd_and_dbm(const cdd&);
+    friend dbm::fed_t cdd_to_fed(const cdd&);
+    friend std::vector<std::pair<cdd, dbm::fed_t>> cdd_to_fed_partitioned(const cdd&);
     friend void cdd_fprintdot(FILE* ofile, const cdd&, bool push_negate);
     friend void cdd_printdot(const cdd&, bool push_negate);
     friend void cdd_fprint_code(FILE* ofile, const cdd&, cdd_print_varloc_f printer1, cdd_print_clockdiff_f printer2,
@@ -938,7 +1362,7 @@ inline cdd operator&(const cdd& l, const cdd& r) { return cdd_apply(l, r, cddop_
 /**
  * If-then-else operator.
  */
-inline cdd cdd_ite(const cdd& f, const cdd& g, const cdd& h) { return (f & g) | ((!f) & h); }
+inline cdd cdd_ite(const cdd& f, const cdd& g, const cdd& h) { return cdd(cdd_ite(f.root, g.root, h.root)); }
 
 /**
  * Creates a new CDD node corresponding to the constraint \a i - \a j
@@ -977,6 +1401,18 @@ inline cdd cdd_remove_negative(const cdd& node) { return cdd(cdd_remove_negative
  */
 inline bool cdd_equiv(const cdd& l, const cdd& r) { return cdd_equiv(l.root, r.root); }
 
+/**
+ * Checks whether a CDD is empty.
+ * @see cdd_is_empty(ddNode*)
+ */
+inline bool cdd_is_empty(const cdd& c) { return cdd_is_empty(c.handle()); }
+
+/**
+ * Checks for inclusion between two CDDs.
+ * @see cdd_subset(ddNode*, ddNode*)
+ */
+inline bool cdd_subset(const cdd& c, const cdd& d) { return cdd_subset(c.handle(), d.handle()); }
+
 /**
  * Creates a new CDD node corresponding to the constraint \a lower
  * <~ \a i - \a j <~ \a upper, where \a i and \a j are clock indexes and
@@ -1041,6 +1477,49 @@ inline cdd cdd_exist(const cdd& r, int32_t* levels, int32_t* clocks, int32_t num
  */
 inline cdd cdd_replace(const cdd& r, int32_t* f, int32_t* g) { return cdd(cdd_replace(r.root, f, g)); }
 
+/**
+ * Existential quantification of a registered set.
+ * @see cdd_exist_set(ddNode*, int32_t)
+ */
+inline cdd cdd_exist_set(const cdd& r, int32_t handle) { return cdd(cdd_exist_set(r.handle(), handle)); }
+
+/**
+ * Existential quantification of a conjunction.
+ * @see cdd_and_exist(ddNode*, ddNode*, int32_t*, int32_t*, int32_t, int32_t)
+ */
+inline cdd cdd_and_exist(const cdd& l, const cdd& r, int32_t* levels, int32_t* clocks, int32_t num_bools,
+                         int32_t num_clocks)
+{
+    return cdd(cdd_and_exist(l.handle(), r.handle(), levels, clocks, num_bools, num_clocks));
+}
+
+/**
+ * Existential quantification of a conjunction with a registered set.
+ * @see cdd_and_exist_set(ddNode*, ddNode*, int32_t)
+ */
+inline cdd cdd_and_exist_set(const cdd& l, const cdd& r, int32_t handle)
+{
+    return cdd(cdd_and_exist_set(l.handle(), r.handle(), handle));
+}
+
+/**
+ * Variable substitution with a registered map.
+ * @see cdd_replace_map(ddNode*, int32_t)
+ */
+inline cdd cdd_replace_map(const cdd& r, int32_t handle) { return cdd(cdd_replace_map(r.handle(), handle)); }
+
+/**
+ * Delay of a CDD.
+ * @see cdd_up(ddNode*)
+ */
+inline cdd cdd_up(const cdd& r) { return cdd(cdd_up(r.handle())); }
+
+/**
+ * Past of a CDD.
+ * @see cdd_down(ddNode*)
+ */
+inline cdd cdd_down(const cdd& r) { return cdd(cdd_down(r.handle())); }
+
 /**
  * Returns the number of nodes (size) of the CDD.
  * @param r a CDD
@@ -1060,6 +1539,20 @@ inline cdd cdd_apply(const cdd& left, const cdd& right, int32_t op)
     return cdd(cdd_apply(left.root, right.root, op));
 }
 
+/**
+ * Performs a binary operation on two decision diagrams using several
+ * threads. @see cdd_apply_parallel(ddNode*, ddNode*, int32_t, int32_t)
+ * @param left     the left argument to the operation
+ * @param right    the right argument to the operation
+ * @param op       the binary operation to perform
+ * @param nthreads the number of threads, including the calling one
+ * @return the resulting decision diagram
+ */
+inline cdd cdd_apply_parallel(const cdd& left, const cdd& right, int32_t op, int32_t nthreads)
+{
+    return cdd(cdd_apply_parallel(left.handle(), right.handle(), op, nthreads));
+}
+
 /**
  * Performs a binary operation on two decision diagrams. The
  * result is in semi-canonical form.
@@ -1196,6 +1689,35 @@ inline int32_t cdd::operator==(const cdd& r) const { return r.root == root; }
 
 inline int32_t cdd::operator!=(const cdd& r) const { return r.root != root; }
 
+/**
+ * Construct a cdd from a federation.
+ * @param fed a federation
+ * @return the cdd representing \a fed.
+ */
+cdd cdd_from_fed(const dbm::fed_t& fed);
+
+/**
+ * Convert a cdd into a federation, the inverse of \c cdd_from_fed().
+ * The BDD parts are dropped, so the federation holds the clock
+ * valuations of any boolean valuation. Only non-negative clock
+ * valuations are covered.
+ * @param state a cdd
+ * @return the federation of the clock valuations of \a state
+ * @throws std::bad_alloc if the zones of \a state cannot be walked
+ */
+dbm::fed_t cdd_to_fed(const cdd& state);
+
+/**
+ * Convert a cdd into federations grouped by BDD part. Each pair
+ * holds a distinct BDD part of \a state and the federation of the
+ * zones joined with it. Only non-negative clock valuations are
+ * covered.
+ * @param state a cdd
+ * @return pairs of a BDD part and its federation
+ * @throws std::bad_alloc if the zones of \a state cannot be walked
+ */
+std::vector<std::pair<cdd, dbm::fed_t>> cdd_to_fed_partitioned(const cdd& state);
+
 /** @} cplusplus */
 
 #endif /* CPLUSPLUS */
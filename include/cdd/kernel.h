@@ -16,6 +16,10 @@
 #include "cdd/cdd.h"
 #include "cdd/config.h"
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -89,11 +93,10 @@ extern "C" {
 /// @defgroup refcount Reference counting
 ///
 /// Each node has a 10-bit reference counter. Since this is a rather
-/// limited size, the library detects when the maximum number of
-/// references is reached and from that point onward the reference
-/// count is never modified. As a consequence the node is never
-/// deallocated (until \c cdd_done() is called). This does not happen
-/// very often and thus the leakage is negligible.
+/// limited size, the references of a node beyond \c OVERREF are kept
+/// in an overflow table of the forest. Only heavily shared nodes ever
+/// get there, so the table is small and rarely touched. Nodes with
+/// \c MAXREF references (the terminals) are never deallocated.
 ///
 /// @{
 ///
@@ -101,23 +104,139 @@ extern "C" {
 /** Max number of references */
 #define MAXREF 0x3FF
 
+/** Reference count from which references are kept in the overflow table */
+#define OVERREF (MAXREF - 1)
+
+/** An entry of the overflow table. */
+typedef struct
+{
+    ddNode* node;    ///< Node, or NULL if the entry is free
+    uint32_t count;  ///< Number of references beyond \c OVERREF
+} RefOverflow;
+
 /** Max number of levels.
  *  The allowed number of variables (BDD+CDD) must
  *  be < MAXLEVEL.
  */
 #define MAXLEVEL ((1 << 20) - 1)
 
+/**
+ * Flag set on a node when its reference count drops to zero in \c
+ * cdd_rec_deref(), i.e. when the references to its children have
+ * been released. This distinguishes dead nodes from nodes with a
+ * zero count which were never referenced. Clearing the flag is what
+ * entitles a thread to reacquire the references, which guarantees
+ * that this happens exactly once even if several threads resurrect
+ * the node at the same time.
+ */
+#define MARKDEAD 0x2
+
+#ifdef CDD_COMPRESSED
+/**
+ * A reference to a DD node stored inside another node: the index of
+ * the chunk holding the node in \c cdd_chunktable, followed by the
+ * offset of the node in the chunk in units of 4 bytes and by the
+ * complement bit. Nodes hence take half the memory for their
+ * references, at the cost of decoding them when following an edge.
+ */
+typedef uint32_t cdd_handle_t;
+#else
+/** A reference to a DD node stored inside another node. */
+typedef ddNode* cdd_handle_t;
+#endif
+
+#ifdef CDD_CONCURRENT
+
+/**
+ * The header of a node (level, reference count and flags) seen as a
+ * single word, such that it can be updated atomically.
+ */
+typedef union
+{
+    uint32_t word;
+    struct
+    {
+        uint32_t level : 20;
+        uint32_t ref : 10;
+        uint32_t flag : 2;
+    } bits;
+} NodeHeader;
+
+/** Returns a pointer to the header word of \a node */
+#define cdd_header(node) ((uint32_t*)((cdd_handle_t*)(node) + 1))
+
+/**
+ * Same as \c cdd_atomic_addref() for a node which had \c OVERREF
+ * references.
+ */
+NodeHeader cdd_atomic_addref_overflow(ddNode* node, int32_t delta);
+
+/**
+ * Atomically adds \a delta to the reference count of \a node unless
+ * it is equal to MAXREF. Incrementing also clears \c MARKDEAD. The
+ * count only leaves or exceeds \c OVERREF with the overflow table
+ * locked, see \c cdd_atomic_addref_overflow().
+ * @return the header before the update
+ */
+static inline NodeHeader cdd_atomic_addref(ddNode* node, int32_t delta)
+{
+    NodeHeader old, upd;
+    old.word = __atomic_load_n(cdd_header(node), __ATOMIC_RELAXED);
+    do {
+        if (old.bits.ref == MAXREF) {
+            return old;
+        }
+        if (old.bits.ref == OVERREF) {
+            return cdd_atomic_addref_overflow(node, delta);
+        }
+        upd = old;
+        upd.bits.ref += delta;
+        if (delta > 0) {
+            upd.bits.flag &= ~MARKDEAD;
+        }
+    } while (!__atomic_compare_exchange_n(cdd_header(node), &old.word, upd.word, 1, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_RELAXED));
+    return old;
+}
+
+/**
+ * Reacquires the references to the children of a dead node after
+ * \c MARKDEAD has been cleared on it.
+ * @param node a node
+ */
+void cdd_revive(ddNode* node);
+
 /** Increment references on \a node */
-#define cdd_ref(node) (cdd_satinc(cdd_rglr(node)->ref))
+#define cdd_ref(node)                                                     \
+    do {                                                                  \
+        ddNode* cdd_ref_node_ = cdd_rglr(node);                           \
+        if (cdd_atomic_addref(cdd_ref_node_, 1).bits.flag & MARKDEAD) { \
+            cdd_revive(cdd_ref_node_);                                    \
+        }                                                                 \
+    } while (0)
 
 /** Decrement reference on \a node */
-#define cdd_deref(node) (cdd_satdec(cdd_rglr(node)->ref))
+#define cdd_deref(node) ((void)cdd_atomic_addref(cdd_rglr(node), -1))
 
-/** Increments \a ref if it is not equal to MAXREF */
-#define cdd_satinc(ref) ((ref) += ((ref) != MAXREF))
+#else
 
-/** Decrements \a ref if it is not equal to MAXREF */
-#define cdd_satdec(ref) ((ref) -= ((ref) != MAXREF))
+/** Increment references on \a node */
+#define cdd_ref(node) (cdd_refinc(cdd_rglr(node)))
+
+/** Decrement reference on \a node */
+#define cdd_deref(node) (cdd_refdec(cdd_rglr(node)))
+
+#endif
+
+/**
+ * Adds \a delta, which is 1 or -1, to the references of \a node kept
+ * in the overflow table. The reference count of \a node must be \c
+ * OVERREF. If the table cannot grow, the node gets \c MAXREF
+ * references instead and is never deallocated.
+ * @return 0 if \a delta is -1 and the table has no references to
+ * \a node, 1 otherwise
+ */
+int32_t cdd_overflow_update(ddNode* node, int32_t delta);
 
 #ifdef MULTI_TERMINAL
 int32_t cdd_isterminal(ddNode*);
@@ -157,12 +276,33 @@ extern void cdd_rec_deref(ddNode* node);
 #define MARKOFF  0x2 /**< Mask used to unmark a node */
 #define MARKHIDE 0x2
 
+#ifdef CDD_CONCURRENT
+
+/** Returns the header word with only the flag bits \a flag set. */
+static inline uint32_t cdd_flagword(uint32_t flag)
+{
+    NodeHeader h;
+    h.word = 0;
+    h.bits.flag = flag;
+    return h.word;
+}
+
+/** Mark node \a n */
+#define cdd_setmark(n) __atomic_fetch_or(cdd_header(cdd_rglr(n)), cdd_flagword(MARKON), __ATOMIC_RELAXED)
+
+/** Unmark node \a n */
+#define cdd_resetmark(n) __atomic_fetch_and(cdd_header(cdd_rglr(n)), ~cdd_flagword(MARKON), __ATOMIC_RELAXED)
+
+#else
+
 /** Mark node \a n */
 #define cdd_setmark(n) (cdd_rglr(n)->flag) |= MARKON
 
 /** Unmark node \a n */
 #define cdd_resetmark(n) (cdd_rglr(n)->flag) &= MARKOFF
 
+#endif
+
 /** Returns true if \a n is marked. */
 #define cdd_ismarked(n) ((cdd_rglr(n)->flag) & MARKON)
 
@@ -213,21 +353,24 @@ void cdd_force_unmark(ddNode* node);
 /// The library needs to maintain different types of nodes: fixed size
 /// BDD nodes and variable size CDD nodes.
 ///
-/// Each type/size of node is managed by a different node manager. A
-/// node manager allocates memory in 64KB chunks which is divided into
-/// equally sized nodes. It maintains a free list of unused nodes and
-/// some statistical information about the nodes, which are used by
-/// the garbage collector.
+/// BDD nodes are managed by one node manager. CDD nodes are grouped
+/// in size classes (see \c cdd_classsize()), each managed by a
+/// different node manager, such that nodes of similar arity share
+/// memory. A node manager allocates memory in 64KB chunks which is
+/// divided into equally sized nodes. It maintains a free list of
+/// unused nodes and some statistical information about the nodes,
+/// which are used by the garbage collector.
 ///
-/// Each node manager maintains a number of subtables -- one for each
-/// level. A subtable is basically a hash table containing nodes. The
-/// hash table uses a collision list embedded into the nodes; each
-/// node contains a \c next pointer which points to the next element
-/// in the collision list. From time to time the hash table is resized
-/// by doubling the size and rehashing all the elements. Notice that
-/// since subtables are local to a node manager and tied to a specific
-/// level, searching for existing nodes in a subtable is relatively
-/// simple.
+/// Nodes are kept in a number of subtables -- one for each level.
+/// The BDD node manager has its own subtables, whereas the CDD size
+/// classes share theirs. A subtable is basically a hash table
+/// containing nodes. The hash table uses a collision list embedded
+/// into the nodes; each node contains a \c next pointer which points
+/// to the next element in the collision list. From time to time the
+/// hash table is resized by doubling the size and rehashing all the
+/// elements. Collision lists are sorted, with CDD nodes ordered by
+/// arity first, so searching for existing nodes in a subtable is
+/// relatively simple.
 ///
 /// @{
 ///
@@ -241,23 +384,59 @@ typedef struct xtermnode_ xtermNode;
 typedef struct chunk_ Chunk;
 typedef uint32_t (*NodeHashFunc)(NodeManager*, ddNode*);
 
+#if defined(CDD_CONCURRENT) || defined(CDD_COMPRESSED)
+/** A spin lock. Zero when unlocked. */
+typedef int32_t cdd_lock_t;
+#endif
+
+#ifdef CDD_CONCURRENT
+
+/**
+ * Number of locks protecting the hash table of a subtable. A bucket
+ * is protected by the lock given by the most significant bits of the
+ * hash value. These do not change when the table is resized.
+ */
+#define CDD_STRIPES      64
+#define CDD_STRIPE_SHIFT 26
+#endif
+
 /**
  * Base type for DD nodes.
  */
 struct node_
 {
-    ddNode* next;         ///< Pointer to next element in hash table
+    cdd_handle_t next;    ///< Next element in hash table
     uint32_t level : 20;  ///< Level of the node
     uint32_t ref : 10;    ///< Reference count
     uint32_t flag : 2;    ///< Flag used when marking nodes
 };
 
+#ifndef CDD_CONCURRENT
+/** Increments the reference count of \a node unless it is equal to MAXREF */
+static inline void cdd_refinc(ddNode* node)
+{
+    if (node->ref < OVERREF) {
+        node->ref++;
+    } else if (node->ref == OVERREF) {
+        cdd_overflow_update(node, 1);
+    }
+}
+
+/** Decrements the reference count of \a node unless it is equal to MAXREF */
+static inline void cdd_refdec(ddNode* node)
+{
+    if (node->ref != MAXREF && (node->ref != OVERREF || !cdd_overflow_update(node, -1))) {
+        node->ref--;
+    }
+}
+#endif
+
 /**
  * Extra terminal node containing an ID.
  */
 struct xtermnode_
 {
-    ddNode* next;         ///< Pointer to next element in hash table
+    cdd_handle_t next;    ///< Next element in hash table
     uint32_t level : 20;  ///< Level of the node
     uint32_t ref : 10;    ///< Reference count
     uint32_t flag : 2;    ///< Flag used when marking nodes
@@ -266,40 +445,74 @@ struct xtermnode_
 
 /**
  * An element is a pair containing a reference to a DD node and a
- * bound.  It is used in the definition of a CDD node.
+ * bound.  The elements of a CDD node are collected on the reference
+ * stack as an array of elements and passed to \c cdd_make_cdd_node().
  */
 
 struct elem_
 {
-    ddNode* child;  ///< Pointer to a DD node
-    raw_t bnd;      ///< Upper bound
+    cdd_handle_t child;  ///< A DD node
+    raw_t bnd;           ///< Upper bound
 };
 
 /**
  * A CDD node. The first fields are identical to that of \c node_.
- * A CDD node has two or more children.
+ * A CDD node has two or more children. The upper bounds of the
+ * elements are stored contiguously and are followed by the children
+ * (see \c cdd_children()), so searching the bounds does not touch the
+ * children. The node may be allocated with room for more elements
+ * than it has, see \c cdd_classsize().
  */
 struct cddnode_
 {
-    ddNode* next;         ///< Pointer to next element in hash table
+    cdd_handle_t next;    ///< Next element in hash table
     uint32_t level : 20;  ///< Level of the node
     uint32_t ref : 10;    ///< Reference count
     uint32_t flag : 2;    ///< Flag used when marking nodes
-    Elem elem[];          ///< NULL terminated array of elements
+    uint32_t len;         ///< Number of elements
+    raw_t bnd[];          ///< Upper bounds of the elements, the last being INF
 };
 
+/** Number of bytes used by \a len bounds, padded to align the children. */
+#define cdd_boundsize(len) \
+    (((len) * sizeof(raw_t) + sizeof(cdd_handle_t) - 1) & ~(sizeof(cdd_handle_t) - 1))
+
+/** Number of bytes used by the bounds and children of \a len elements. */
+#define cdd_elemsize(len) (cdd_boundsize(len) + (len) * sizeof(cdd_handle_t))
+
+/** Returns the array of children of a CDD node \a node. */
+#define cdd_children(node) \
+    ((cdd_handle_t*)((char*)cdd_node(node)->bnd + cdd_boundsize(cdd_node(node)->len)))
+
+/**
+ * Number of elements of CDD nodes in size class \a c, which is at
+ * least 1. The classes grow by alternating factors of 3/2 and 4/3:
+ * 2, 3, 4, 6, 8, 12, 16, ...
+ */
+#define cdd_classsize(c) ((2 + (((c) + 1) & 1)) << (((c)-1) >> 1))
+
+/** Returns the smallest size class of CDD nodes with room for \a len elements. */
+static inline int32_t cdd_sizeclass(int32_t len)
+{
+    int32_t c = 1;
+    while (cdd_classsize(c) < len) {
+        c++;
+    }
+    return c;
+}
+
 /**
  * A BDD node. The first fields are identical to that of \c node_.
  * A BDD node has two children: a low node and a high node.
  */
 struct bddnode_
 {
-    ddNode* next;         ///< Pointer to next element in hash table
+    cdd_handle_t next;    ///< Next element in hash table
     uint32_t level : 20;  ///< Level of the node
     uint32_t ref : 10;    ///< Reference count
     uint32_t flag : 2;    ///< Flag used when marking nodes
-    ddNode* low;          ///< Low child node
-    ddNode* high;         ///< High child node
+    cdd_handle_t low;     ///< Low child node
+    cdd_handle_t high;    ///< High child node
 };
 
 /**
@@ -312,9 +525,62 @@ struct chunk_
 {
     Chunk* next;       ///< Pointer to next chunk
     NodeManager* man;  ///< Pointer to owning node manager
-    ddNode* nodes[];   ///< Array of nodes (64Kb - 8 byte)
+    int32_t freecnt;   ///< Number of free nodes, counted after garbage collection
+#ifdef CDD_COMPRESSED
+    uint32_t index;  ///< Index in \c cdd_chunktable
+#endif
+    ddNode* nodes[];  ///< Array of nodes (64Kb - 24 byte)
 };
 
+#if defined(__APPLE__) && defined(__MACH__)
+#define CHUNKSIZE 0x1000 /* Size of chunk in bytes */
+#else
+#define CHUNKSIZE 0x10000 /* Size of chunk in bytes */
+#endif
+
+/** Returns a chunk in which \a node is allocated. */
+#define cdd_node2chunk(node) ((Chunk*)((uintptr_t)(node) & ~(CHUNKSIZE - 1)))
+
+#ifdef CDD_COMPRESSED
+/** Number of low bits of a handle holding the offset and the complement bit. */
+#define CDD_HANDLE_SHIFT 15
+
+/** Maximum number of chunks, i.e. 8GB of nodes. */
+#define CDD_MAXCHUNKS (1 << (32 - CDD_HANDLE_SHIFT))
+
+/**
+ * Size of the block holding the nodes which are not allocated in a
+ * chunk, i.e. the terminal and the ends of the hash chains. It starts
+ * with the terminal and is entry 0 of \c cdd_chunktable.
+ */
+#define CDD_SPECIALSIZE 64
+
+/** Base addresses of the chunks, indexed by the chunk part of a handle. */
+extern char* cdd_chunktable[CDD_MAXCHUNKS];
+
+/** Returns the node referenced by the handle \a h. */
+static inline ddNode* cdd_ptr(cdd_handle_t h)
+{
+    return (ddNode*)(cdd_chunktable[h >> CDD_HANDLE_SHIFT] + ((h & ((1 << CDD_HANDLE_SHIFT) - 2)) << 1) + (h & 1));
+}
+
+/** Returns the handle of \a node. */
+static inline cdd_handle_t cdd_handle(ddNode* node)
+{
+    uintptr_t r = (uintptr_t)cdd_rglr(node);
+    uintptr_t offset = r - (uintptr_t)cddfalse;
+    uint32_t index = 0;
+    if (offset >= CDD_SPECIALSIZE) {
+        offset = r & (CHUNKSIZE - 1);
+        index = cdd_node2chunk(r)->index;
+    }
+    return (index << CDD_HANDLE_SHIFT) | (uint32_t)(offset >> 1) | (uint32_t)cdd_mask(node);
+}
+#else
+#define cdd_ptr(h)       (h)
+#define cdd_handle(node) (node)
+#endif
+
 /**
  * A subtable is basically a hash table with some statistical
  * information. A subtable is specific to a node manager and to a node
@@ -327,13 +593,16 @@ struct chunk_
  */
 struct subtable_
 {
-    int32_t level;    ///< The level
-    int32_t deadcnt;  ///< Number of dead nodes
-    int32_t keys;     ///< Number of nodes in this sub table
-    int32_t maxkeys;  ///< Max number of nodes before resizing occurs
-    int32_t shift;    ///< Shift for hash
-    int32_t buckets;  ///< Size of hash table
-    ddNode** hash;    ///< Hash table
+    int32_t level;       ///< The level
+    int32_t deadcnt;     ///< Number of dead nodes
+    int32_t keys;        ///< Number of nodes in this sub table
+    int32_t maxkeys;     ///< Max number of nodes before resizing occurs
+    int32_t shift;       ///< Shift for hash
+    int32_t buckets;     ///< Size of hash table
+    cdd_handle_t* hash;  ///< Hash table
+#ifdef CDD_CONCURRENT
+    cdd_lock_t lock[CDD_STRIPES];  ///< Locks protecting the buckets
+#endif
 };
 
 /**
@@ -359,11 +628,14 @@ struct nodemanager_
     int32_t gbccnt;    ///< Number of garbage collection runs on this manager
     int32_t gbcclock;  ///< Time used for garbage collection
     // int32_t gbcwatch;      ///< True if scheduled for garbage collection
-    ddNode* free;      ///< Free list
+    ddNode* free;      ///< Free list, ending with \c cddfalse
     Chunk* nodes;      ///< Chunk list
     ddNode* sentinel;  ///< "End of list" mark
     NodeHashFunc hashfunc;
     SubTable** subtables;
+#ifdef CDD_CONCURRENT
+    cdd_lock_t lock;  ///< Protects the free list and the chunk list
+#endif
 };
 
 /**
@@ -418,22 +690,145 @@ ddNode* cdd_make_cdd_node(int32_t level, Elem* children, int32_t len);
  */
 #define cdd_info(node) (cdd_levelinfo + cdd_rglr(node)->level)
 
-extern int32_t cdd_errorcond;
-extern int32_t* cdd_diff2level;
-extern Elem* cdd_refstack;
-extern Elem* cdd_refstacktop;  ///< Reference stack
-extern size_t cdd_refstacksize;
-extern int32_t bdd_start_level;  ///< BDD start level
-extern int32_t cdd_clocknum;     ///< Number of clocks
-extern int32_t cdd_varnum;       ///< Number of BDD variables
-extern int32_t cdd_levelcnt;     ///< Number of levels
-extern LevelInfo* cdd_levelinfo;
-
-#define cdd_push(node, bound)            \
-    do {                                 \
-        cdd_refstacktop->child = (node); \
-        cdd_refstacktop->bnd = (bound);  \
-        cdd_refstacktop++;               \
+///////////////////////////////////////////////////////////////////////////
+/// @defgroup context Engine context
+///
+/// All state of the library -- node managers, level information, the
+/// reference stack, statistics, hooks and operation caches -- is
+/// owned by a context. Each thread has a current context, which
+/// initially is the default context shared by all threads. The
+/// library always operates on the current context of the calling
+/// thread, so independent contexts can be used concurrently from
+/// different threads. Nodes must never be mixed between contexts.
+///
+/// The names which used to denote global variables of the library
+/// are macros referring to the fields of the current context.
+///
+/// @{
+///
+
+#if defined(_MSC_VER)
+#define CDD_THREAD_LOCAL __declspec(thread)
+#else
+#define CDD_THREAD_LOCAL __thread
+#endif
+
+/** Operation caches and state of the operators (see cddop.c). */
+typedef struct cddoperators_ CddOperators;
+
+/**
+ * The state of one instance of the library.
+ * @see cdd_context_create()
+ */
+struct cddcontext_
+{
+    int32_t running;                       ///< True if the context has been initialised
+    int32_t errorcond;                     ///< Last error code
+    NodeManager* bddman;                   ///< BDD node manager
+    NodeManager** cddman;                  ///< CDD node managers indexed by size class
+    SubTable** cddtables;                  ///< Subtables shared by the CDD node managers
+    int32_t maxcddsize;                    ///< Max. arity of a node
+    int32_t maxcddused;                    ///< Max. size class of any allocated node
+    int32_t chunkcnt;                      ///< Total number of chunks allocated
+    int32_t retention;                     ///< Number of empty chunks kept by a node manager
+    int32_t compaction;                    ///< Fragmentation in percent triggering compaction
+    int32_t levelcnt;                      ///< Number of levels
+    int32_t bddstartlevel;                 ///< Level of the first BDD variable
+    int32_t clocknum;                      ///< Number of clocks
+    int32_t varnum;                        ///< Number of BDD variables
+    LevelInfo* levelinfo;                  ///< Information about each level
+    int32_t* diff2level;                   ///< Maps clock differences to levels
+    Elem* refstack;                        ///< Base address of reference stack
+    Elem* refstacktop;                     ///< Top of reference stack
+    Elem* refstacklimit;                   ///< End of the committed part of the reference stack
+    size_t refstacksize;                   ///< Number of elements committed for the reference stack
+    size_t refstackreserve;                ///< Bytes of address space reserved for the reference stack
+    cddNode* key;                          ///< Scratch node holding the key of a node being made
+    int32_t gbcclock;                      ///< Acc. time used for garbage collection
+    int32_t gbccnt;                        ///< Number of garbage collections
+    int32_t rehashclock;                   ///< Acc. time used for rehashing
+    int32_t rehashcnt;                     ///< Number of rehashes
+    int32_t compactclock;                  ///< Acc. time used for compaction
+    int32_t compactcnt;                    ///< Number of compactions
+    ddNode*** roots;                       ///< Registered roots, or NULL if roots are not tracked
+    int32_t rootcnt;                       ///< Number of registered roots
+    int32_t rootsize;                      ///< Size of the root table (a power of 2)
+    RefOverflow* overflow;                 ///< Overflow table of reference counts, or NULL
+    int32_t overflowcnt;                   ///< Number of nodes in the overflow table
+    int32_t overflowsize;                  ///< Size of the overflow table (a power of 2)
+    void (*pregbc)(void);                  ///< Pre-gbc handler
+    void (*postgbc)(CddGbcStat*);          ///< Post-gbc handler
+    void (*prerehash)(void);               ///< Pre-rehash handler
+    void (*postrehash)(CddRehashStat*);    ///< Post-rehash handler
+    void (*postcompact)(CddCompactStat*);  ///< Post-compaction handler
+#ifdef MULTI_TERMINAL
+    ddNode** xterms;                       ///< Extra terminals
+    int32_t xtermcnt;                      ///< Number of extra terminals
+#ifdef CDD_COMPRESSED
+    Chunk* xtermchunks;                    ///< Chunks holding the extra terminals
+#endif
+#endif
+    CddOperators* operators;               ///< Operation caches
+#ifdef CDD_CONCURRENT
+    cdd_context* owner;   ///< Context owning the nodes, or NULL if this one does
+    cdd_context* shares;  ///< Contexts sharing the nodes of this context
+    cdd_context* next;    ///< Next context sharing the nodes of the owner
+    int32_t active;       ///< Number of shares which may be in use
+    ddNode** freenodes;   ///< Free nodes taken from the node managers, indexed by size class
+#endif
+};
+
+/** The current context of the calling thread. */
+extern CDD_THREAD_LOCAL cdd_context* cdd_current;
+
+#define cdd_errorcond     (cdd_current->errorcond)
+#define cdd_diff2level    (cdd_current->diff2level)
+#define cdd_refstack      (cdd_current->refstack)
+#define cdd_refstacktop   (cdd_current->refstacktop)    ///< Reference stack
+#define cdd_refstacklimit (cdd_current->refstacklimit)
+#define cdd_refstacksize  (cdd_current->refstacksize)
+#define bdd_start_level   (cdd_current->bddstartlevel)  ///< BDD start level
+#define cdd_clocknum      (cdd_current->clocknum)       ///< Number of clocks
+#define cdd_varnum        (cdd_current->varnum)         ///< Number of BDD variables
+#define cdd_levelcnt      (cdd_current->levelcnt)       ///< Number of levels
+#define cdd_levelinfo     (cdd_current->levelinfo)
+
+/** @} */
+
+/**
+ * Commits memory for the reference stack up to \a end, which must be
+ * above the base of the stack. The stack does not move.
+ * @return 1 if successful, 0 if the stack overflowed or memory is
+ * exhausted, in which case the error condition is set
+ */
+int32_t cdd_refstack_grow(const void* end);
+
+/**
+ * Pushes an element on the reference stack. On overflow the element
+ * is dropped and \c CDD_STACKOVERFLOW is set as the error condition.
+ */
+#define cdd_push(node, bound)                                                                    \
+    do {                                                                                         \
+        if (cdd_refstacktop == cdd_refstacklimit && !cdd_refstack_grow(cdd_refstacktop + 1)) { \
+            break;                                                                               \
+        }                                                                                        \
+        cdd_refstacktop->child = cdd_handle(node);                                               \
+        cdd_refstacktop->bnd = (bound);                                                          \
+        cdd_refstacktop++;                                                                       \
+    } while (0)
+
+/**
+ * Backs off from building a node on the reference stack after an
+ * error: releases the references held by the elements from \a first
+ * to the top of the stack and resets the top to \a top.
+ */
+#define cdd_unwind(first, top)                                                                     \
+    do {                                                                                           \
+        Elem* cdd_unwind_elem_;                                                                    \
+        for (cdd_unwind_elem_ = (first); cdd_unwind_elem_ < cdd_refstacktop; cdd_unwind_elem_++) { \
+            cdd_deref(cdd_ptr(cdd_unwind_elem_->child));                                           \
+        }                                                                                          \
+        cdd_refstacktop = (top);                                                                   \
     } while (0)
 
 /* From kernel.c */
@@ -445,6 +840,12 @@ extern LevelInfo* cdd_levelinfo;
  */
 int32_t cdd_error(int32_t error);
 
+/**
+ * Returns the number of nodes in use in the node managers of the
+ * current context.
+ */
+int32_t cdd_usednodes();
+
 extern ddNode* cdd_upper_from_level(int32_t, raw_t);
 extern ddNode* cdd_interval_from_level(int32_t, raw_t, raw_t);
 
@@ -480,21 +881,90 @@ typedef struct
 {
     raw_t low;
     uintptr_t neg;
-    Elem* p;
+    const raw_t* b;
+    cdd_handle_t* c;
 } cdd_iterator;
 
-#define cdd_it_init(it, node) (it).low = -INF, (it).neg = cdd_mask(node), (it).p = cdd_node(node)->elem
-#define cdd_it_lower(it)      ((it).low)
-#define cdd_it_child(it)      (cdd_neg_cond((it).p->child, (it).neg))
-#define cdd_it_upper(it)      ((it).p->bnd)
-#define cdd_it_atend(it)      ((it).low == INF)
-#define cdd_it_next(it)       (it).low = cdd_it_upper(it), (it).p++
+/** Bound of the single element of a node iterated by \c cdd_it_single(). */
+extern const raw_t cdd_infbound;
+
+#define cdd_it_init(it, node) \
+    (it).low = -INF, (it).neg = cdd_mask(node), (it).b = cdd_node(node)->bnd, (it).c = cdd_children(node)
+#define cdd_it_lower(it) ((it).low)
+#define cdd_it_child(it) (cdd_neg_cond(cdd_ptr(*(it).c), (it).neg))
+#define cdd_it_upper(it) (*(it).b)
+#define cdd_it_atend(it) ((it).low == INF)
+#define cdd_it_next(it)  (it).low = cdd_it_upper(it), (it).b++, (it).c++
+
+/**
+ * Iterates \a node as if it was the only child of a CDD node. The
+ * handle variable \a h holds the child while iterating.
+ */
+#define cdd_it_single(it, node, h) \
+    (h) = cdd_handle(cdd_rglr(node)), (it).low = -INF, (it).neg = cdd_mask(node), (it).b = &cdd_infbound, (it).c = &(h)
+
+/** Advances \a it past the current element if its upper bound is \a bound. */
+#define cdd_it_step(it, bound)             \
+    do {                                   \
+        if (cdd_it_upper(it) == (bound)) { \
+            cdd_it_next(it);               \
+        }                                  \
+    } while (0)
+
+/**
+ * Returns the index of the first of the \a len sorted bounds in \a
+ * bnd which is not smaller than \a x, or \a len if there is none.
+ */
+static inline int32_t cdd_bound_search(const raw_t* bnd, int32_t len, raw_t x)
+{
+    int32_t i = 0;
+#if defined(__AVX2__)
+    __m256i v8 = _mm256_set1_epi32(x);
+    for (; i + 8 <= len; i += 8) {
+        __m256i lt = _mm256_cmpgt_epi32(v8, _mm256_loadu_si256((const __m256i*)(bnd + i)));
+        uint32_t m = ~(uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(lt)) & 0xFF;
+        if (m) {
+            return i + __builtin_ctz(m);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i v4 = _mm_set1_epi32(x);
+    for (; i + 4 <= len; i += 4) {
+        __m128i lt = _mm_cmpgt_epi32(v4, _mm_loadu_si128((const __m128i*)(bnd + i)));
+        uint32_t m = ~(uint32_t)_mm_movemask_ps(_mm_castsi128_ps(lt)) & 0xF;
+        if (m) {
+            return i + __builtin_ctz(m);
+        }
+    }
+#endif
+    while (i < len && bnd[i] < x) {
+        i++;
+    }
+    return i;
+}
+
+/**
+ * Positions \a it at the first element of the CDD node \a node whose
+ * upper bound is not smaller than \a x. The lower bound of the
+ * iterator is that of the element.
+ */
+static inline void cdd_it_seek(cdd_iterator* it, ddNode* node, raw_t x)
+{
+    int32_t i = cdd_bound_search(cdd_node(node)->bnd, cdd_node(node)->len, x);
+    cdd_it_init(*it, node);
+    if (i > 0) {
+        it->low = it->b[i - 1];
+        it->b += i;
+        it->c += i;
+    }
+}
 
 /** Returns the low child of a BDD node \a node */
-#define bdd_low(node) (cdd_neg_cond(bdd_node(node)->low, cdd_mask(node)))
+#define bdd_low(node) (cdd_neg_cond(cdd_ptr(bdd_node(node)->low), cdd_mask(node)))
 
 /** Returns the high child of a BDD node \a node */
-#define bdd_high(node) (cdd_neg_cond(bdd_node(node)->high, cdd_mask(node)))
+#define bdd_high(node) (cdd_neg_cond(cdd_ptr(bdd_node(node)->high), cdd_mask(node)))
 
 /** @} */
 
@@ -13,39 +13,85 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-int CddCache_init(CddCache* cache, size_t size)
+/**
+ * Allocates an empty hash table with at least \a size elements for \a
+ * cache, without releasing the old one. The sets are stamped with
+ * epoch 0, which is never current.
+ */
+static int CddCache_alloc(CddCache* cache, size_t size)
 {
-    size_t n;
+    size_t sets = 2;
+    int32_t shift = 8 * sizeof(uintptr_t) - 1;
+    void* mem;
 
-    if ((cache->table = (CddCacheData*)malloc(sizeof(CddCacheData) * size)) == NULL) {
+    while (sets * cache->ways < size) {
+        sets *= 2;
+        shift--;
+    }
+    if ((mem = calloc(sets * CddCache_setsize(cache) + CDDCACHE_LINE - 1, 1)) == NULL) {
         return cdd_error(CDD_MEMORY);
     }
 
-    for (n = 0; n < size; n++) {
-        cache->table[n].a = NULL;
-        cache->table[n].b = NULL;
+    cache->mem = mem;
+    cache->table = (CddCacheSet*)(((uintptr_t)mem + CDDCACHE_LINE - 1) & ~(uintptr_t)(CDDCACHE_LINE - 1));
+    cache->tablesize = sets * cache->ways;
+    cache->shift = shift;
+    cache->probes = cache->found = 0;
+
+    return 0;
+}
+
+int CddCache_init(CddCache* cache, size_t size)
+{
+    cache->ways = CDDCACHE_WAYS;
+    cache->epoch = 1;
+#ifdef CDD_CACHESTATS
+    memset(&cache->stat, 0, sizeof(CddCacheStat));
+#endif
+    return CddCache_alloc(cache, size);
+}
+
+int CddCache_init3(CddCache* cache, size_t size)
+{
+    cache->ways = CDDCACHE_WAYS3;
+    cache->epoch = 1;
+#ifdef CDD_CACHESTATS
+    memset(&cache->stat, 0, sizeof(CddCacheStat));
+#endif
+    return CddCache_alloc(cache, size);
+}
+
+int CddCache_resize(CddCache* cache, size_t size)
+{
+    void* mem = cache->mem;
+
+    if (CddCache_alloc(cache, size) < 0) {
+        return CDD_MEMORY;
     }
-    cache->tablesize = size;
+    free(mem);
 
     return 0;
 }
 
 void CddCache_done(CddCache* cache)
 {
-    free(cache->table);
+    free(cache->mem);
+    cache->mem = NULL;
     cache->table = NULL;
     cache->tablesize = 0;
 }
 
-void CddCache_reset(CddCache* cache) { memset(cache->table, 0, cache->tablesize * sizeof(CddCacheData)); }
+void CddCache_reset(CddCache* cache)
+{
+    memset(cache->table, 0, cache->tablesize / cache->ways * CddCache_setsize(cache));
+}
 
 void CddCache_flush(CddCache* cache)
 {
-    register CddCacheData* n;
-    for (n = cache->table + cache->tablesize - 1; n >= cache->table; n--) {
-        if (n->a && (!cdd_rglr(n->a)->ref || !cdd_rglr(n->res)->ref || (n->b && !cdd_rglr(n->b)->ref))) {
-            n->a = n->b = NULL;
-        }
+    if (++cache->epoch == 0) {
+        CddCache_reset(cache);
+        cache->epoch = 1;
     }
 }
@@ -9,37 +9,125 @@
  * Private header file for the operation cache.
  */
 
+/** Number of entries in a set of a \c CddCache. */
+#define CDDCACHE_WAYS 2
+
+/** Size in bytes of a set of a \c CddCache, which is a cache line. */
+#define CDDCACHE_LINE 64
+
+/** Number of entries in a set of a \c CddCache with three-word keys. */
+#define CDDCACHE_WAYS3 3
+
 /**
  * An entry in a \c CddCache cache structure. It contains the
- * arguments and the result of a binary operation.
+ * arguments and the result of an operation. The second word of the
+ * key is either the second argument of a binary operation with the
+ * operation packed into it (see \c CddCache_key()), or the operation
+ * of a unary one.
  */
 typedef struct
 {
-    ddNode* res;   /**< The result of the operation */
-    ddNode *a, *b; /**< The arguments of the operation */
-    int c;         /**< The operation */
+    ddNode* res; /**< The result of the operation */
+    ddNode* a;   /**< The first argument of the operation */
+    uintptr_t b; /**< The second word of the key */
 } CddCacheData;
 
+/**
+ * The entries of a \c CddCache sharing a cache line. A key may be in
+ * either entry of the set its hash value selects. The entries of a
+ * set stamped with an epoch other than the one of the cache are void.
+ */
+typedef struct
+{
+    CddCacheData way[CDDCACHE_WAYS]; /**< The entries */
+    uint32_t mru;                    /**< The entry used most recently */
+    uint32_t epoch;                  /**< The epoch in which the entries were stored */
+    char pad[CDDCACHE_LINE - CDDCACHE_WAYS * sizeof(CddCacheData) - 2 * sizeof(uint32_t)];
+} CddCacheSet;
+
+/**
+ * An entry in a \c CddCache created with \c CddCache_init3(), for
+ * operations with three arguments.
+ */
+typedef struct
+{
+    ddNode* res; /**< The result of the operation */
+    ddNode* a;   /**< The first argument of the operation */
+    uintptr_t b; /**< The second word of the key */
+    uintptr_t c; /**< The third word of the key */
+} CddCacheData3;
+
+/**
+ * The entries of a \c CddCache with three-word keys sharing two cache
+ * lines, like \c CddCacheSet.
+ */
+typedef struct
+{
+    CddCacheData3 way[CDDCACHE_WAYS3]; /**< The entries */
+    uint32_t mru;                      /**< The entry used most recently */
+    uint32_t epoch;                    /**< The epoch in which the entries were stored */
+    char pad[2 * CDDCACHE_LINE - CDDCACHE_WAYS3 * sizeof(CddCacheData3) - 2 * sizeof(uint32_t)];
+} CddCacheSet3;
+
 /**
  * A cache structure. Used as an operation cache by the library. The
- * cache is a hash table without collision lists (it will overwrite
- * entries which hash to the same bucket).
+ * cache is a two-way set-associative hash table without collision
+ * lists (it will overwrite the least recently used entry of a set
+ * when a new one is stored). The number of sets is a power of 2.
+ * Flushing the cache starts a new epoch, which voids all entries
+ * without touching the table. Nodes have no room for a generation
+ * stamp telling whether the nodes of an entry survived, so entries of
+ * live nodes are voided too, see the \c stale statistics. The lookups
+ * and hits since the size of the table was last adapted are counted,
+ * such that the owner can resize it with \c CddCache_resize(). A
+ * cache created with \c CddCache_init3() has keys of three words and
+ * three-way sets of type \c CddCacheSet3 instead.
  */
 typedef struct
 {
-    CddCacheData* table; /**< The hash table */
-    size_t tablesize;    /**< The size of the hash table */
+    CddCacheSet* table; /**< The hash table, aligned to a cache line */
+    void* mem;          /**< The memory holding the hash table */
+    size_t tablesize;   /**< The number of entries in the hash table */
+    int32_t ways;       /**< The number of entries in a set */
+    int32_t shift;      /**< Shift of a mixed hash value to the index of a set */
+    uint32_t epoch;     /**< The current epoch, never 0 */
+    size_t probes;      /**< Lookups since the size was adapted */
+    size_t found;       /**< Hits since the size was adapted */
+#ifdef CDD_CACHESTATS
+    CddCacheStat stat; /**< Lookup statistics */
+#endif
 } CddCache;
 
 /**
- * Initialise a cache structure. A hash table with \a size elements
- * will be allocated.
+ * Initialise a cache structure. A hash table with at least \a size
+ * elements will be allocated; the size is rounded up to a power of 2.
  * @param cache An uninitialized cache structure
  * @param size The size of the hash table to allocate
  * @return An error code
  */
 extern int CddCache_init(CddCache* cache, size_t size);
 
+/**
+ * Initialise a cache structure with keys of three words, to be used
+ * with \c CddCache_lookup3() and \c CddCache_insert3(). The size is
+ * rounded up to a power of 2 sets.
+ * @param cache An uninitialized cache structure
+ * @param size The size of the hash table to allocate
+ * @return An error code
+ */
+extern int CddCache_init3(CddCache* cache, size_t size);
+
+/**
+ * Replaces the hash table of a cache by an empty one with at least \a
+ * size elements, rounded up to a power of 2. The cache is left
+ * unchanged if this fails. Entries previously returned by \c
+ * CddCache_lookup() are invalidated.
+ * @param cache A cache structure
+ * @param size The new size of the hash table
+ * @return An error code
+ */
+extern int CddCache_resize(CddCache* cache, size_t size);
+
 /**
  * Clears all entries in the cache.
  * @param cache A cache structure
@@ -54,23 +142,218 @@ extern void CddCache_reset(CddCache* cache);
 extern void CddCache_done(CddCache* cache);
 
 /**
- * Removes all entries with a dead decision tree. This function removes
- * all those entries from the cache where one or more of the argument or
- * the result decision trees has a reference counter with value zero.
- * This is used after a garbage collection run to avoid references to
- * garbage collected nodes.
+ * Voids all entries by starting a new epoch. This is used before a
+ * garbage collection run to avoid references to garbage collected
+ * nodes, whose memory may be reused for other nodes. Only when the
+ * epoch counter wraps around is the table cleared.
  * @param cache A cache structure
  */
 extern void CddCache_flush(CddCache* cache);
 
 /**
- * Returns the entry in the cache for the given hash value. A
- * reference to the entry is returned, so you can assign to it.
+ * Copies the statistics of a cache, which are zero unless the library
+ * is built with \c CDD_CACHESTATS.
  * @param cache A cache structure
- * @param hash A 32-bit hash value
- * @return The entry for this hash value
+ * @param out A statistics structure receiving the statistics
  */
-#define CddCache_lookup(cache, hash) (&(cache)->table[(hash) % (cache)->tablesize])
+#ifdef CDD_CACHESTATS
+#define CddCache_stat(cache, out) (*(out) = (cache)->stat)
+#else
+#define CddCache_stat(cache, out) memset((out), 0, sizeof(CddCacheStat))
+#endif
+
+/** Odd constant close to 2^n divided by the golden ratio. */
+#define CDDCACHE_MIX ((uintptr_t)(sizeof(uintptr_t) == 8 ? 0x9E3779B97F4A7C15ULL : 0x9E3779B9UL))
+
+/**
+ * Returns the set of the cache for the given hash value. The hash
+ * value is mixed, as the hash values of nodes have zero low bits.
+ * @param cache A cache structure
+ * @param hash A hash value
+ * @return The set for this hash value
+ */
+#define CddCache_set(cache, hash) (&(cache)->table[((uintptr_t)(hash)*CDDCACHE_MIX) >> (cache)->shift])
+
+/**
+ * Returns the set of a cache with three-word keys for the given hash
+ * value, see \c CddCache_set().
+ * @param cache A cache structure
+ * @param hash A hash value
+ * @return The set for this hash value
+ */
+#define CddCache_set3(cache, hash) (&((CddCacheSet3*)(cache)->table)[((uintptr_t)(hash)*CDDCACHE_MIX) >> (cache)->shift])
+
+/**
+ * Returns the second word of the key of a binary operation. Nodes
+ * are aligned to 4 bytes and the lowest bit is the negation bit, so
+ * the operation, which must be 0 or 1, is stored in bit 1.
+ * @param b The second argument
+ * @param op The operation
+ */
+#define CddCache_key(b, op) ((uintptr_t)(b) | ((uintptr_t)(op) << 1))
+
+/**
+ * Counts an event in the statistics of a cache. Does nothing unless
+ * the library is built with \c CDD_CACHESTATS.
+ * @param cache A cache structure
+ * @param event A field of \c CddCacheStat
+ */
+#ifdef CDD_CACHESTATS
+#define CddCache_count(cache, event) ((cache)->stat.event++)
+#else
+#define CddCache_count(cache, event) ((void)0)
+#endif
+
+/**
+ * Looks up the result of an operation in the cache.
+ * @param cache A cache structure
+ * @param hash A hash value of the key
+ * @param a The first word of the key
+ * @param b The second word of the key
+ * @return The entry with the key, or NULL if there is none
+ */
+static inline CddCacheData* CddCache_lookup(CddCache* cache, uintptr_t hash, ddNode* a, uintptr_t b)
+{
+    CddCacheSet* set = CddCache_set(cache, hash);
+    uint32_t i;
+
+    cache->probes++;
+    CddCache_count(cache, lookups);
+    if (set->epoch != cache->epoch) {
+#ifdef CDD_CACHESTATS
+        for (i = 0; i < CDDCACHE_WAYS; i++) {
+            if (set->way[i].a == a && set->way[i].b == b) {
+                CddCache_count(cache, stale);
+            }
+        }
+#endif
+        return NULL;
+    }
+    for (i = 0; i < CDDCACHE_WAYS; i++) {
+        if (set->way[i].a == a && set->way[i].b == b) {
+            set->mru = i;
+            cache->found++;
+            CddCache_count(cache, hits);
+            return &set->way[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Returns the entry in which to store the result of an operation
+ * after a miss, with the key filled in. This is an entry with the
+ * same key or an empty one if the set has any, and otherwise the
+ * least recently used entry, which is overwritten. A set of an
+ * earlier epoch is emptied first.
+ * @param cache A cache structure
+ * @param hash A hash value of the key
+ * @param a The first word of the key
+ * @param b The second word of the key
+ * @return The entry for the key
+ */
+static inline CddCacheData* CddCache_insert(CddCache* cache, uintptr_t hash, ddNode* a, uintptr_t b)
+{
+    CddCacheSet* set = CddCache_set(cache, hash);
+    uint32_t i;
+
+    if (set->epoch != cache->epoch) {
+        for (i = 0; i < CDDCACHE_WAYS; i++) {
+            set->way[i].a = NULL;
+        }
+        set->epoch = cache->epoch;
+    }
+    for (i = 0; i < CDDCACHE_WAYS; i++) {
+        if (set->way[i].a == NULL || (set->way[i].a == a && set->way[i].b == b)) {
+            break;
+        }
+    }
+    if (i == CDDCACHE_WAYS) {
+        CddCache_count(cache, overwrites);
+        i = (set->mru + 1) % CDDCACHE_WAYS;
+    }
+    set->mru = i;
+    set->way[i].a = a;
+    set->way[i].b = b;
+    return &set->way[i];
+}
+
+/**
+ * Looks up the result of an operation in a cache with three-word
+ * keys, see \c CddCache_lookup().
+ * @param cache A cache structure
+ * @param hash A hash value of the key
+ * @param a The first word of the key
+ * @param b The second word of the key
+ * @param c The third word of the key
+ * @return The entry with the key, or NULL if there is none
+ */
+static inline CddCacheData3* CddCache_lookup3(CddCache* cache, uintptr_t hash, ddNode* a, uintptr_t b, uintptr_t c)
+{
+    CddCacheSet3* set = CddCache_set3(cache, hash);
+    uint32_t i;
+
+    cache->probes++;
+    CddCache_count(cache, lookups);
+    if (set->epoch != cache->epoch) {
+#ifdef CDD_CACHESTATS
+        for (i = 0; i < CDDCACHE_WAYS3; i++) {
+            if (set->way[i].a == a && set->way[i].b == b && set->way[i].c == c) {
+                CddCache_count(cache, stale);
+            }
+        }
+#endif
+        return NULL;
+    }
+    for (i = 0; i < CDDCACHE_WAYS3; i++) {
+        if (set->way[i].a == a && set->way[i].b == b && set->way[i].c == c) {
+            set->mru = i;
+            cache->found++;
+            CddCache_count(cache, hits);
+            return &set->way[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Returns the entry in which to store the result of an operation in a
+ * cache with three-word keys, see \c CddCache_insert(). When no entry
+ * is free, the one stored after the most recently used one is
+ * overwritten.
+ * @param cache A cache structure
+ * @param hash A hash value of the key
+ * @param a The first word of the key
+ * @param b The second word of the key
+ * @param c The third word of the key
+ * @return The entry for the key
+ */
+static inline CddCacheData3* CddCache_insert3(CddCache* cache, uintptr_t hash, ddNode* a, uintptr_t b, uintptr_t c)
+{
+    CddCacheSet3* set = CddCache_set3(cache, hash);
+    uint32_t i;
+
+    if (set->epoch != cache->epoch) {
+        for (i = 0; i < CDDCACHE_WAYS3; i++) {
+            set->way[i].a = NULL;
+        }
+        set->epoch = cache->epoch;
+    }
+    for (i = 0; i < CDDCACHE_WAYS3; i++) {
+        if (set->way[i].a == NULL || (set->way[i].a == a && set->way[i].b == b && set->way[i].c == c)) {
+            break;
+        }
+    }
+    if (i == CDDCACHE_WAYS3) {
+        CddCache_count(cache, overwrites);
+        i = (set->mru + 1) % CDDCACHE_WAYS3;
+    }
+    set->mru = i;
+    set->way[i].a = a;
+    set->way[i].b = b;
+    set->way[i].c = c;
+    return &set->way[i];
+}
 
 /**
  * Returns the size of the hash table of a cache.
@@ -79,4 +362,11 @@ extern void CddCache_flush(CddCache* cache);
  */
 #define CddCache_size(cache) ((cache)->tablesize)
 
+/**
+ * Returns the size in bytes of a set of a cache.
+ * @param cache A cache structure
+ * @return The size of a set
+ */
+#define CddCache_setsize(cache) ((cache)->ways == CDDCACHE_WAYS ? sizeof(CddCacheSet) : sizeof(CddCacheSet3))
+
 #endif /* _CACHE_H */
@@ -24,6 +24,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef CDD_CONCURRENT
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 #define RELAXCACHE
 
 #ifdef RELAXCACHE
@@ -35,11 +40,40 @@
 #define P1 12582917
 #define P2 4256249
 
+#define PARALLEL_CUTOFF 8    /* Default depth up to which cdd_apply_parallel() forks */
+#define DEQUESIZE       1024 /* Max. number of pending tasks of a worker */
+
+#define CACHE_COUNT   5                  /* Number of adaptive operation caches sharing the ceiling */
+#define CACHE_MINSIZE 1024               /* Smallest size of an adaptive operation cache */
+#define CACHE_MINHIT  30                 /* Hit rate in percent for which an operation cache may grow */
+#define CACHE_LIMIT   ((size_t)64 << 20) /* Default memory ceiling of the operation caches of a context */
+
 #define COMPLHASH(r, op) (cdd_pair((uintptr_t)(r), (op)))
 //#define APPLYHASH(l,r,op)    (cdd_triple((unsigned int)(l), (unsigned int)(r),(op)))
 #define APPLYHASH(l, r, op) ((((uintptr_t)(op) + (uintptr_t)(l)) * P1 + (uintptr_t)(r)) * P2)
 #define EXISTHASH(l)        ((uintptr_t)(l))
 #define REPLACEHASH(r)      ((uintptr_t)r)
+#define ITEHASH(f, g, h)    ((((uintptr_t)(f)*P1 + (uintptr_t)(g)) * P2 + (uintptr_t)(h)) >> 2)
+#define REDUCEHASH(r)       ((uintptr_t)(r))
+
+/* Third word of the key of cdd_and_exist() in the ite cache. Bit 1 is
+ * never set in a node, so it cannot match a key of cdd_ite(). */
+#define ANDEXISTKEY(op) (((uintptr_t)(uint32_t)(op) << 2) | 2)
+
+/* Second word of the key of cdd_reduce() in the apply cache. Keys of
+ * binary operations are nodes with bit 1 holding the operation, so
+ * they never have all bits set. */
+#define REDUCEKEY (~(uintptr_t)0)
+
+/* Second words of the keys of cdd_up() and cdd_down() in the apply
+ * cache, see REDUCEKEY. */
+#define UPKEY       (~(uintptr_t)1)
+#define DOWNKEY     (~(uintptr_t)2)
+#define TIMEHASH(r, op) ((uintptr_t)(r) + (op))
+
+/* Operation of cdd_time_relax() in the relax cache. Operation ids of
+ * cdd_exist() are never 0. */
+#define TIMEOP 0
 
 #ifdef RELAXCACHE
 #define RELAXHASH(n, l, c1, c2, u) (cdd_triple((uintptr_t)(node), cdd_pair((l), (c1)), cdd_pair((c2), (u))))
@@ -48,7 +82,35 @@
 // #define cdd_and(l,r) cdd_apply_reduce((l), (r), cddop_and)
 #define cdd_and(l, r) cdd_apply((l), (r), cddop_and)
 #define cdd_xor(l, r) cdd_apply((l), (r), cddop_xor)
-#define cdd_or(l, r)  cdd_neg(cdd_and(cdd_neg(l), cdd_neg(r)))
+#define cdd_or(l, r)  cdd_neg_result(cdd_and(cdd_neg(l), cdd_neg(r)))
+
+/* The recursions combining the results of other operations take and
+ * release references with the following. After an error, the NULL
+ * result of an operation is passed on to the next ones, which back
+ * off right away, and the recursion returns NULL without leaking
+ * references. */
+static inline ddNode* cdd_neg_result(ddNode* node) { return node == NULL ? NULL : cdd_neg(node); }
+
+static inline void cdd_ref_result(ddNode* node)
+{
+    if (node != NULL) {
+        cdd_ref(node);
+    }
+}
+
+static inline void cdd_deref_result(ddNode* node)
+{
+    if (node != NULL) {
+        cdd_deref(node);
+    }
+}
+
+static inline void cdd_rec_deref_result(ddNode* node)
+{
+    if (node != NULL) {
+        cdd_rec_deref(node);
+    }
+}
 
 inline static int32_t maximum(int32_t a, int32_t b) __attribute__((const));
 inline static int32_t minimum(int32_t a, int32_t b) __attribute__((const));
@@ -66,14 +128,66 @@ inline static int32_t minimum(int32_t a, int32_t b) { return a < b ? a : b; }
 #endif
 
 /*=== INTERNAL VARIABLES ===============================================*/
-static CddCache applycache; /* Cache for apply results */
-static CddCache quantcache;
-static CddCache replacecache;
+#ifdef CDD_CONCURRENT
+typedef struct cddpool_ CddPool;
+#endif
+
+/* Kinds of registered variable maps */
+#define MAP_REPLACE 0 /* Registered with cdd_register_replace_map() */
+#define MAP_EXIST   1 /* Registered with cdd_register_exist_set() */
+
+/* A variable map registered with cdd_register_replace_map() or
+ * cdd_register_exist_set() */
+typedef struct
+{
+    int32_t* levels;    /* Levels of the map or set, or NULL */
+    int32_t* clocks;    /* Clocks of the map or set, or NULL */
+    int32_t num_bools;  /* Number of levels of an exist set */
+    int32_t num_clocks; /* Number of clocks of an exist set */
+    int32_t kind;       /* MAP_REPLACE or MAP_EXIST */
+    int32_t levelcnt;   /* cdd_levelcnt when the map was registered */
+    int32_t clocknum;   /* cdd_clocknum when the map was registered */
+} CddVarMap;
+
+/* Operator state owned by a context */
+struct cddoperators_
+{
+    CddCache apply_cache; /* Cache for apply results */
+    CddCache quant_cache;
+    CddCache replace_cache;
+    CddCache test_cache; /* Cache for the results of predicates */
+    CddCache ite_cache;   /* Cache with three-word keys for cdd_ite() and cdd_and_exist() */
 #ifdef RELAXCACHE
-static CddRelaxCache relaxcache;
+    CddRelaxCache relax_cache;
 #endif
-static int32_t applyop;
-static int32_t opid;
+    int32_t apply_op;
+    int32_t op_id;    /* Key of the current operation in the quant, replace and relax caches */
+    int32_t op_count; /* Number of keys handed out to unregistered operations */
+    CddVarMap* maps;  /* Registered variable maps, indexed by handle */
+    int32_t mapcnt;   /* Number of registered variable maps */
+    int32_t mapsize;  /* Size of the table of variable maps */
+    int32_t parallel_cutoff;
+    size_t cache_limit; /* Memory ceiling of the adaptive caches, or 0 */
+#ifdef CDD_CONCURRENT
+    CddPool* pool; /* Workers of cdd_apply_parallel() */
+#endif
+};
+
+#define applycache   (cdd_current->operators->apply_cache)
+#define quantcache   (cdd_current->operators->quant_cache)
+#define replacecache (cdd_current->operators->replace_cache)
+#define testcache    (cdd_current->operators->test_cache)
+#define itecache     (cdd_current->operators->ite_cache)
+#ifdef RELAXCACHE
+#define relaxcache (cdd_current->operators->relax_cache)
+#endif
+#define applyop (cdd_current->operators->apply_op)
+#define opid    (cdd_current->operators->op_id)
+#define opcount (cdd_current->operators->op_count)
+
+/* Registered operations are keyed by negative ids, such that they
+ * never collide with the positive ones of unregistered operations. */
+#define MAPID(handle) (-1 - (handle))
 
 /*=== TEMP EXTERNAL PROTOTYPE ==========================================*/
 void cdd2Dot(char* fname, ddNode* node, char* name);
@@ -81,8 +195,13 @@ void cdd2Dot(char* fname, ddNode* node, char* name);
 /*=== INTERNAL PROTOTYPES ==============================================*/
 static int32_t cdd_contains_rec(ddNode*, raw_t*, uint32_t dim);
 static ddNode* cdd_apply_rec(ddNode*, ddNode*);
+#ifdef CDD_CONCURRENT
+static ddNode* cdd_apply_par(CddPool*, int32_t, ddNode*, ddNode*, int32_t);
+static void cdd_pool_destroy(CddPool*);
+#endif
 #ifdef EX
 static ddNode* cdd_exist_rec(ddNode* node, int32_t*, int32_t*, int32_t, int32_t, raw_t*);
+static ddNode* cdd_and_exist_rec(ddNode*, ddNode*, int32_t*, int32_t*, int32_t, int32_t, raw_t*);
 #else
 static ddNode* cdd_exist_rec(ddNode*, int32_t*, ddNode*);
 #endif
@@ -90,6 +209,11 @@ static ddNode* cdd_replace_rec(ddNode*, int32_t*, int32_t*);
 
 int32_t cdd_operator_init(size_t cachesize)
 {
+    if ((cdd_current->operators = (CddOperators*)calloc(1, sizeof(CddOperators))) == NULL) {
+        return cdd_error(CDD_MEMORY);
+    }
+    cdd_current->operators->parallel_cutoff = PARALLEL_CUTOFF;
+    cdd_current->operators->cache_limit = CACHE_LIMIT;
     if (CddCache_init(&applycache, cachesize) < 0) {
         return cdd_error(CDD_MEMORY);
     }
@@ -99,6 +223,12 @@ int32_t cdd_operator_init(size_t cachesize)
     if (CddCache_init(&replacecache, cachesize) < 0) {
         return cdd_error(CDD_MEMORY);
     }
+    if (CddCache_init(&testcache, cachesize) < 0) {
+        return cdd_error(CDD_MEMORY);
+    }
+    if (CddCache_init3(&itecache, cachesize) < 0) {
+        return cdd_error(CDD_MEMORY);
+    }
 #ifdef RELAXCACHE
     if (CddRelaxCache_init(&relaxcache, cachesize) < 0) {
         return cdd_error(CDD_MEMORY);
@@ -110,12 +240,31 @@ int32_t cdd_operator_init(size_t cachesize)
 
 void cdd_operator_done()
 {
+    int32_t i;
+
+    if (cdd_current->operators == NULL) {
+        return;
+    }
+#ifdef CDD_CONCURRENT
+    if (cdd_current->operators->pool) {
+        cdd_pool_destroy(cdd_current->operators->pool);
+    }
+#endif
     CddCache_done(&applycache);
     CddCache_done(&quantcache);
     CddCache_done(&replacecache);
+    CddCache_done(&testcache);
+    CddCache_done(&itecache);
 #ifdef RELAXCACHE
     CddRelaxCache_done(&relaxcache);
 #endif
+    for (i = 0; i < cdd_current->operators->mapcnt; i++) {
+        free(cdd_current->operators->maps[i].levels);
+        free(cdd_current->operators->maps[i].clocks);
+    }
+    free(cdd_current->operators->maps);
+    free(cdd_current->operators);
+    cdd_current->operators = NULL;
 }
 
 void cdd_operator_reset()
@@ -123,21 +272,132 @@ void cdd_operator_reset()
     CddCache_reset(&applycache);
     CddCache_reset(&quantcache);
     CddCache_reset(&replacecache);
+    CddCache_reset(&testcache);
+    CddCache_reset(&itecache);
 #ifdef RELAXCACHE
     CddRelaxCache_reset(&relaxcache);
 #endif
 }
 
+void cdd_cache_stats(CddCacheStats* stats)
+{
+    CddCache_stat(&applycache, &stats->apply);
+    CddCache_stat(&quantcache, &stats->quant);
+    CddCache_stat(&replacecache, &stats->replace);
+    CddCache_stat(&testcache, &stats->test);
+    CddCache_stat(&itecache, &stats->ite);
+#ifdef RELAXCACHE
+    CddCache_stat(&relaxcache, &stats->relax);
+#else
+    memset(&stats->relax, 0, sizeof(CddCacheStat));
+#endif
+}
+
+/* Returns the largest size of \a cache under its share of the memory
+ * ceiling, a power of 2 sets, or 0 if the sizes are fixed. */
+static size_t cdd_cache_maxsize(CddCache* cache)
+{
+    size_t sets = cdd_current->operators->cache_limit / (CACHE_COUNT * CddCache_setsize(cache)), max;
+
+    while (sets & (sets - 1)) {
+        sets &= sets - 1;
+    }
+    max = sets * cache->ways;
+    return cdd_current->operators->cache_limit == 0 ? 0 : max < CACHE_MINSIZE ? CACHE_MINSIZE : max;
+}
+
+void cdd_cache_limit(size_t bytes)
+{
+    CddCache* caches[CACHE_COUNT] = {&applycache, &quantcache, &replacecache, &testcache, &itecache};
+    size_t i, max;
+
+    cdd_current->operators->cache_limit = bytes;
+    for (i = 0; i < CACHE_COUNT; i++) {
+        if ((max = cdd_cache_maxsize(caches[i])) > 0 && CddCache_size(caches[i]) > max) {
+            CddCache_resize(caches[i], max);
+        }
+    }
+}
+
+/* Adapts the size of \a cache at the end of a window of lookups. The
+ * cache doubles if at least CACHE_MINHIT percent of the lookups hit
+ * and there are more nodes in use than entries, as results are then
+ * likely to be evicted before they are reused. It halves if there are
+ * more than four times as many entries as nodes in use. The ceiling
+ * takes precedence, and the cache is left as it is if it cannot be
+ * resized. */
+static void cdd_cache_adapt(CddCache* cache)
+{
+    size_t size = CddCache_size(cache), max = cdd_cache_maxsize(cache), nodes;
+
+    if (max > 0) {
+        nodes = (size_t)cdd_usednodes();
+        if (size > max) {
+            size = max;
+        } else if (100 * cache->found >= CACHE_MINHIT * cache->probes && size < nodes && 2 * size <= max) {
+            size *= 2;
+        } else if (size / 2 >= CACHE_MINSIZE && size > 4 * nodes) {
+            size /= 2;
+        }
+        if (size != CddCache_size(cache) && CddCache_resize(cache, size) == 0) {
+            return;
+        }
+    }
+    cache->probes = cache->found = 0;
+}
+
+/* Returns the entry of \a cache for the key \a a, \a b with hash
+ * value \a hash in which to store a result computed after a miss. The
+ * cache is adapted here once per window of lookups as long as the
+ * cache itself, as no entry is held on to across operations. */
+static inline CddCacheData* cdd_cache_store(CddCache* cache, uintptr_t hash, ddNode* a, uintptr_t b)
+{
+    if (cache->probes >= CddCache_size(cache)) {
+        cdd_cache_adapt(cache);
+    }
+    return CddCache_insert(cache, hash, a, b);
+}
+
+/* Returns the entry of \a cache with three-word keys for the key \a a,
+ * \a b, \a c, see cdd_cache_store(). */
+static inline CddCacheData3* cdd_cache_store3(CddCache* cache, uintptr_t hash, ddNode* a, uintptr_t b, uintptr_t c)
+{
+    if (cache->probes >= CddCache_size(cache)) {
+        cdd_cache_adapt(cache);
+    }
+    return CddCache_insert3(cache, hash, a, b, c);
+}
+
 void cdd_operator_flush()
 {
     CddCache_flush(&applycache);
     CddCache_flush(&quantcache);
     CddCache_flush(&replacecache);
+    CddCache_flush(&testcache);
+    CddCache_flush(&itecache);
 #ifdef RELAXCACHE
-    CddRelaxCache_reset(&relaxcache);
+    CddRelaxCache_flush(&relaxcache);
 #endif
 }
 
+/* Returns a fresh key for an unregistered operation. Keys stay
+ * positive, apart from the negative ones of registered operations and
+ * TIMEOP. When they run out, numbering starts over after flushing the
+ * caches keyed by them, such that no stale entry can match. */
+static int32_t cdd_next_opid()
+{
+    if (opcount == INT32_MAX) {
+        CddCache_flush(&quantcache);
+        CddCache_flush(&replacecache);
+        CddCache_flush(&itecache);
+#ifdef RELAXCACHE
+        CddRelaxCache_flush(&relaxcache);
+#endif
+        opcount = 0;
+    }
+    return ++opcount;
+}
+
 ddNode* cdd_apply(ddNode* l, ddNode* h, int32_t op)
 {
     ddNode* res;
@@ -150,6 +410,18 @@ ddNode* cdd_apply(ddNode* l, ddNode* h, int32_t op)
     return res;
 }
 
+/* Iterates the children of \a node if it is at \a level, and
+ * otherwise \a node itself as the only child of a fake intermediate
+ * node. The handle \a h holds the child in the latter case. */
+static inline void cdd_it_operand(cdd_iterator* it, ddNode* node, int32_t level, cdd_handle_t* h)
+{
+    if (cdd_rglr(node)->level == level) {
+        cdd_it_init(*it, node);
+    } else {
+        cdd_it_single(*it, node, *h);
+    }
+}
+
 static ddNode* cdd_apply_rec(ddNode* l, ddNode* r)
 {
     CddCacheData* entry;
@@ -157,15 +429,16 @@ static ddNode* cdd_apply_rec(ddNode* l, ddNode* r)
     int32_t rmask;
     int32_t mask;
     Elem* top;
-    Elem* lp;
-    Elem* rp;
     Elem* first;
+    cdd_iterator li, ri;
+    cdd_handle_t lc, rc;
     ddNode* ll;
     ddNode* lh;
     ddNode* rl;
     ddNode* rh;
     ddNode* n;
     ddNode* prev;
+    ddNode* res;
     raw_t bnd;
 
     /* Back off in case of error */
@@ -231,9 +504,10 @@ static ddNode* cdd_apply_rec(ddNode* l, ddNode* r)
 
     /* Do cache lookup */
     //    fprintf(stderr, "%u\n", APPLYHASH(l, r, applyop) % 10000);
-    entry = CddCache_lookup(&applycache, APPLYHASH(l, r, applyop));
-    if (entry->a == l && entry->b == r && entry->c == applyop) {
+    entry = CddCache_lookup(&applycache, APPLYHASH(l, r, applyop), l, CddCache_key(r, applyop));
+    if (entry != NULL) {
         if (cdd_rglr(entry->res)->ref == 0) {
+            CddCache_count(&applycache, reclaims);
             cdd_reclaim(entry->res);
         }
         return entry->res;
@@ -248,89 +522,557 @@ static ddNode* cdd_apply_rec(ddNode* l, ddNode* r)
     switch (cdd_levelinfo[minimum(l->level, r->level)].type) {
     case TYPE_CDD:
         /* Prepare for recursion */
-        top = cdd_refstacktop;
-        if (l->level <= r->level) {
-            lp = cdd_node(l)->elem;
-        } else {
-            lp = cdd_refstacktop;
-            cdd_push(l, INF);
-        }
-
-        if (l->level >= r->level) {
-            rp = cdd_node(r)->elem;
-        } else {
-            rp = cdd_refstacktop;
-            cdd_push(r, INF);
-        }
+        cdd_it_operand(&li, cdd_neg_cond(l, lmask), minimum(l->level, r->level), &lc);
+        cdd_it_operand(&ri, cdd_neg_cond(r, rmask), minimum(l->level, r->level), &rc);
 
         /*
          * Do recursion
          */
 
-        first = cdd_refstacktop;
+        top = first = cdd_refstacktop;
 
         /* Do first recursion - check whether first edge is negated */
-        prev = cdd_apply_rec(cdd_neg_cond(lp->child, lmask), cdd_neg_cond(rp->child, rmask));
+        prev = cdd_apply_rec(cdd_it_child(li), cdd_it_child(ri));
+        if (prev == NULL) {
+            return 0;
+        }
         cdd_ref(prev);
         mask = cdd_mask(prev);
-        bnd = minimum(lp->bnd, rp->bnd);
+        bnd = minimum(cdd_it_upper(li), cdd_it_upper(ri));
 
         /* Continue */
         while (bnd < INF) {
-            lp += (lp->bnd == bnd);
-            rp += (rp->bnd == bnd);
-            n = cdd_apply_rec(cdd_neg_cond(lp->child, lmask), cdd_neg_cond(rp->child, rmask));
+            cdd_it_step(li, bnd);
+            cdd_it_step(ri, bnd);
+            n = cdd_apply_rec(cdd_it_child(li), cdd_it_child(ri));
+            if (n == NULL) {
+                break;
+            }
             if (n != prev) {
                 cdd_push(cdd_neg_cond(prev, mask), bnd);
+                if (cdd_errorcond) {
+                    break;
+                }
                 prev = n;
                 cdd_ref(prev);
             }
-            bnd = minimum(lp->bnd, rp->bnd);
+            bnd = minimum(cdd_it_upper(li), cdd_it_upper(ri));
+        }
+        if (!cdd_errorcond) {
+            cdd_push(cdd_neg_cond(prev, mask), INF);
+        }
+
+        /* Back off in case of error; prev is not on the stack */
+        if (cdd_errorcond) {
+            cdd_deref(prev);
+            cdd_unwind(first, top);
+            return 0;
         }
-        cdd_push(cdd_neg_cond(prev, mask), INF);
 
         /* Create node */
-        entry->res = cdd_neg_cond(cdd_make_cdd_node(minimum(l->level, r->level), first, cdd_refstacktop - first), mask);
+        res = cdd_make_cdd_node(minimum(l->level, r->level), first, cdd_refstacktop - first);
 
         /* Remove references */
         for (; first < cdd_refstacktop; first++) {
-            cdd_deref(first->child);
+            cdd_deref(cdd_ptr(first->child));
         }
 
         /* Restore stacktop */
         cdd_refstacktop = top;
 
+        if (res == NULL) {
+            return 0;
+        }
+        res = cdd_neg_cond(res, mask);
         break;
     case TYPE_BDD:
         if (l->level <= r->level) {
-            ll = bdd_node(l)->low;
-            lh = bdd_node(l)->high;
+            ll = cdd_ptr(bdd_node(l)->low);
+            lh = cdd_ptr(bdd_node(l)->high);
         } else {
             ll = lh = l;
         }
 
         if (l->level >= r->level) {
-            rl = bdd_node(r)->low;
-            rh = bdd_node(r)->high;
+            rl = cdd_ptr(bdd_node(r)->low);
+            rh = cdd_ptr(bdd_node(r)->high);
         } else {
             rl = rh = r;
         }
 
         n = cdd_apply_rec(cdd_neg_cond(ll, lmask), cdd_neg_cond(rl, rmask));
+        if (n == NULL) {
+            return 0;
+        }
         cdd_ref(n);
-        entry->res = cdd_make_bdd_node(minimum(l->level, r->level), n,
-                                       cdd_apply_rec(cdd_neg_cond(lh, lmask), cdd_neg_cond(rh, rmask)));
+        prev = cdd_apply_rec(cdd_neg_cond(lh, lmask), cdd_neg_cond(rh, rmask));
+        res = prev == NULL ? NULL : cdd_make_bdd_node(minimum(l->level, r->level), n, prev);
         cdd_deref(n);
+        if (res == NULL) {
+            return 0;
+        }
     }
 
     /* Update cache entry */
-    entry->a = cdd_neg_cond(l, lmask);
-    entry->b = cdd_neg_cond(r, rmask);
-    entry->c = applyop;
+    l = cdd_neg_cond(l, lmask);
+    r = cdd_neg_cond(r, rmask);
+    entry = cdd_cache_store(&applycache, APPLYHASH(l, r, applyop), l, CddCache_key(r, applyop));
+    entry->res = res;
+
+    return res;
+}
+
+#ifdef CDD_CONCURRENT
+/*=== PARALLEL APPLY ===================================================*/
+
+/* An apply on two nodes which may be run by any worker */
+typedef struct
+{
+    ddNode* left;
+    ddNode* right;
+    int32_t depth;
+    raw_t bnd;    /* Upper bound of the interval of the pair */
+    ddNode* res;  /* Referenced result */
+    int32_t done; /* Set when res is available */
+} CddTask;
+
+/* Pending tasks of a worker. The worker pushes and pops at the
+ * bottom, while other workers steal from the top. */
+typedef struct
+{
+    pthread_mutex_t mutex;
+    int32_t top;
+    int32_t bottom;
+    CddTask* task[DEQUESIZE];
+} CddDeque;
+
+typedef struct
+{
+    CddPool* pool;
+    int32_t id;
+} CddWorker;
+
+/* A pool of threads working on the nodes of the context which
+ * created it. Worker 0 is the calling thread. */
+struct cddpool_
+{
+    int32_t size;      /* Number of workers */
+    int32_t requested; /* Number of workers asked for */
+    int32_t levels;    /* Number of levels when the workers were created */
+    int32_t cutoff;    /* Depth up to which applies are forked */
+    int32_t op;        /* Operation of the current job */
+    int32_t job;       /* Incremented for each job */
+    int32_t busy;      /* Number of workers in the current job */
+    int32_t finished;  /* Set when the current job is completed */
+    int32_t stop;      /* Set when the pool is destroyed */
+    pthread_mutex_t mutex;
+    pthread_cond_t wake; /* Signalled when a job is started or the pool stopped */
+    pthread_cond_t idle; /* Signalled when the last worker leaves a job */
+    pthread_t* threads;
+    cdd_context** contexts;
+    CddDeque* deques;
+    CddWorker* workers;
+};
+
+static int32_t cdd_deque_push(CddDeque* deque, CddTask* task)
+{
+    int32_t ok;
+    pthread_mutex_lock(&deque->mutex);
+    if ((ok = deque->bottom < DEQUESIZE)) {
+        deque->task[deque->bottom++] = task;
+    }
+    pthread_mutex_unlock(&deque->mutex);
+    return ok;
+}
+
+static CddTask* cdd_deque_take(CddDeque* deque, int32_t steal)
+{
+    CddTask* task = NULL;
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->top < deque->bottom) {
+        task = steal ? deque->task[deque->top++] : deque->task[--deque->bottom];
+        if (deque->top == deque->bottom) {
+            deque->top = deque->bottom = 0;
+        }
+    }
+    pthread_mutex_unlock(&deque->mutex);
+    return task;
+}
+
+static void cdd_task_run(CddPool* pool, int32_t id, CddTask* task)
+{
+    ddNode* res = cdd_apply_par(pool, id, task->left, task->right, task->depth);
+    if (res != NULL) {
+        cdd_ref(res);
+    }
+    task->res = res;
+    __atomic_store_n(&task->done, 1, __ATOMIC_RELEASE);
+}
+
+/* Runs a task stolen from another worker. Returns 0 if there was none. */
+static int32_t cdd_task_steal(CddPool* pool, int32_t id)
+{
+    int32_t i;
+    CddTask* task;
+    for (i = 1; i < pool->size; i++) {
+        if ((task = cdd_deque_take(&pool->deques[(id + i) % pool->size], 1)) != NULL) {
+            cdd_task_run(pool, id, task);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Waits for a task forked by worker \a id. Since tasks are joined in
+ * the reverse order of forking, the task is either at the bottom of
+ * the deque of the worker or has been stolen. */
+static void cdd_task_join(CddPool* pool, int32_t id, CddTask* task)
+{
+    if (cdd_deque_take(&pool->deques[id], 0) == task) {
+        cdd_task_run(pool, id, task);
+        return;
+    }
+    while (!__atomic_load_n(&task->done, __ATOMIC_ACQUIRE)) {
+        if (!cdd_task_steal(pool, id)) {
+            sched_yield();
+        }
+    }
+}
+
+/* Same as cdd_apply_rec(), except that the recursive applies on the
+ * children are forked as tasks until \a depth reaches the cutoff. */
+static ddNode* cdd_apply_par(CddPool* pool, int32_t id, ddNode* l, ddNode* r, int32_t depth)
+{
+    CddCacheData* entry;
+    CddTask* tasks;
+    cdd_iterator li, ri;
+    cdd_handle_t lc, rc;
+    Elem* first;
+    ddNode* prev;
+    ddNode* res;
+    int32_t lmask, rmask, mask, level, cnt, forked, i;
+    raw_t bnd;
+
+    if (depth >= pool->cutoff || cdd_isterminal(l) || cdd_isterminal(r) || cdd_rglr(l) == cdd_rglr(r)) {
+        return cdd_apply_rec(l, r);
+    }
+
+    /* The operation is symmetric; normalise for better cache performance */
+    if (l > r) {
+        prev = l;
+        l = r;
+        r = prev;
+    }
+
+    /* Do cache lookup before forking */
+    entry = CddCache_lookup(&applycache, APPLYHASH(l, r, applyop), l, CddCache_key(r, applyop));
+    if (entry != NULL) {
+        if (cdd_rglr(entry->res)->ref == 0) {
+            CddCache_count(&applycache, reclaims);
+            cdd_reclaim(entry->res);
+        }
+        return entry->res;
+    }
+
+    lmask = cdd_mask(l);
+    rmask = cdd_mask(r);
+    l = cdd_rglr(l);
+    r = cdd_rglr(r);
+    level = minimum(l->level, r->level);
+
+    /* Collect the pairs of children to combine */
+    switch (cdd_levelinfo[level].type) {
+    case TYPE_CDD:
+        cdd_it_operand(&li, cdd_neg_cond(l, lmask), level, &lc);
+        cdd_it_operand(&ri, cdd_neg_cond(r, rmask), level, &rc);
+        for (cnt = 1, bnd = minimum(cdd_it_upper(li), cdd_it_upper(ri)); bnd < INF; cnt++) {
+            cdd_it_step(li, bnd);
+            cdd_it_step(ri, bnd);
+            bnd = minimum(cdd_it_upper(li), cdd_it_upper(ri));
+        }
+        cdd_it_operand(&li, cdd_neg_cond(l, lmask), level, &lc);
+        cdd_it_operand(&ri, cdd_neg_cond(r, rmask), level, &rc);
+        tasks = (CddTask*)malloc(cnt * sizeof(CddTask));
+        if (tasks == NULL) {
+            cdd_errorcond = CDD_MEMORY;
+            return NULL;
+        }
+        for (i = 0; i < cnt; i++) {
+            if (i > 0) {
+                cdd_it_step(li, bnd);
+                cdd_it_step(ri, bnd);
+            }
+            bnd = minimum(cdd_it_upper(li), cdd_it_upper(ri));
+            tasks[i].left = cdd_it_child(li);
+            tasks[i].right = cdd_it_child(ri);
+            tasks[i].bnd = bnd;
+        }
+        break;
+    case TYPE_BDD:
+        cnt = 2;
+        tasks = (CddTask*)malloc(cnt * sizeof(CddTask));
+        if (tasks == NULL) {
+            cdd_errorcond = CDD_MEMORY;
+            return NULL;
+        }
+        tasks[0].left = cdd_neg_cond(l->level == level ? cdd_ptr(bdd_node(l)->low) : l, lmask);
+        tasks[0].right = cdd_neg_cond(r->level == level ? cdd_ptr(bdd_node(r)->low) : r, rmask);
+        tasks[1].left = cdd_neg_cond(l->level == level ? cdd_ptr(bdd_node(l)->high) : l, lmask);
+        tasks[1].right = cdd_neg_cond(r->level == level ? cdd_ptr(bdd_node(r)->high) : r, rmask);
+        break;
+    default: return cdd_apply_rec(cdd_neg_cond(l, lmask), cdd_neg_cond(r, rmask));
+    }
+    for (i = 0; i < cnt; i++) {
+        tasks[i].depth = depth + 1;
+        tasks[i].done = 0;
+    }
+
+    /* Fork all but the first pair, then join them in reverse order */
+    for (forked = 1; forked < cnt && cdd_deque_push(&pool->deques[id], &tasks[forked]); forked++)
+        ;
+    cdd_task_run(pool, id, &tasks[0]);
+    for (i = forked; i < cnt; i++) {
+        cdd_task_run(pool, id, &tasks[i]);
+    }
+    for (i = forked - 1; i > 0; i--) {
+        cdd_task_join(pool, id, &tasks[i]);
+    }
+
+    /* Create node */
+    res = NULL;
+    for (i = 0; i < cnt && tasks[i].res != NULL; i++)
+        ;
+    if (i == cnt) {
+        if (cdd_levelinfo[level].type == TYPE_BDD) {
+            res = cdd_make_bdd_node(level, tasks[0].res, tasks[1].res);
+        } else {
+            first = cdd_refstacktop;
+            prev = tasks[0].res;
+            mask = cdd_mask(prev);
+            for (i = 1; i < cnt && !cdd_errorcond; i++) {
+                if (tasks[i].res != prev) {
+                    cdd_push(cdd_neg_cond(prev, mask), tasks[i - 1].bnd);
+                    prev = tasks[i].res;
+                }
+            }
+            if (!cdd_errorcond) {
+                cdd_push(cdd_neg_cond(prev, mask), INF);
+            }
+            /* The elements hold no references of their own */
+            if (!cdd_errorcond) {
+                res = cdd_make_cdd_node(level, first, cdd_refstacktop - first);
+            }
+            if (res != NULL) {
+                res = cdd_neg_cond(res, mask);
+            }
+            cdd_refstacktop = first;
+        }
+    }
+
+    /* Remove references */
+    for (i = 0; i < cnt; i++) {
+        if (tasks[i].res != NULL) {
+            cdd_deref(tasks[i].res);
+        }
+    }
+    free(tasks);
+
+    /* Update cache entry after joining */
+    if (res != NULL) {
+        l = cdd_neg_cond(l, lmask);
+        r = cdd_neg_cond(r, rmask);
+        entry = cdd_cache_store(&applycache, APPLYHASH(l, r, applyop), l, CddCache_key(r, applyop));
+        entry->res = res;
+    }
+
+    return res;
+}
+
+static void* cdd_pool_worker(void* arg)
+{
+    CddWorker* worker = (CddWorker*)arg;
+    CddPool* pool = worker->pool;
+    int32_t job = 0;
+
+    cdd_context_set(pool->contexts[worker->id]);
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (!pool->stop && pool->job == job) {
+            pthread_cond_wait(&pool->wake, &pool->mutex);
+        }
+        if (pool->stop) {
+            break;
+        }
+        job = pool->job;
+        applyop = pool->op;
+        pthread_mutex_unlock(&pool->mutex);
+
+        while (!__atomic_load_n(&pool->finished, __ATOMIC_ACQUIRE)) {
+            if (!cdd_task_steal(pool, worker->id)) {
+                sched_yield();
+            }
+        }
 
-    return entry->res;
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->busy == 0) {
+            pthread_cond_signal(&pool->idle);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
 }
 
+/* Creates a pool of \a size workers, each with a context sharing the
+ * nodes of the current one. Fewer workers are created if contexts or
+ * threads cannot be allocated. Idle workers do not count as users of
+ * the nodes, such that garbage can still be collected between jobs. */
+static CddPool* cdd_pool_create(int32_t size)
+{
+    cdd_context* owner = cdd_current->owner ? cdd_current->owner : cdd_current;
+    CddPool* pool;
+    int32_t i;
+
+    if ((pool = (CddPool*)calloc(1, sizeof(CddPool))) == NULL) {
+        return NULL;
+    }
+    pool->requested = size;
+    pool->levels = cdd_levelcnt;
+    pool->threads = (pthread_t*)calloc(size, sizeof(pthread_t));
+    pool->contexts = (cdd_context**)calloc(size, sizeof(cdd_context*));
+    pool->deques = (CddDeque*)calloc(size, sizeof(CddDeque));
+    pool->workers = (CddWorker*)calloc(size, sizeof(CddWorker));
+    if (pool->threads == NULL || pool->contexts == NULL || pool->deques == NULL || pool->workers == NULL) {
+        free(pool->threads);
+        free(pool->contexts);
+        free(pool->deques);
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    for (i = 0; i < size; i++) {
+        pthread_mutex_init(&pool->deques[i].mutex, NULL);
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+    }
+
+    pool->contexts[0] = cdd_current;
+    for (pool->size = 1; pool->size < size; pool->size++) {
+        i = pool->size;
+        if ((pool->contexts[i] = cdd_context_create()) == NULL) {
+            break;
+        }
+        if (cdd_context_share(pool->contexts[i], applycache.tablesize, cdd_refstacksize) < 0) {
+            cdd_context_destroy(pool->contexts[i]);
+            break;
+        }
+        if (pthread_create(&pool->threads[i], NULL, cdd_pool_worker, &pool->workers[i]) != 0) {
+            cdd_context_destroy(pool->contexts[i]);
+            break;
+        }
+        __atomic_sub_fetch(&owner->active, 1, __ATOMIC_ACQ_REL);
+    }
+
+    return pool;
+}
+
+static void cdd_pool_destroy(CddPool* pool)
+{
+    cdd_context* owner = cdd_current->owner ? cdd_current->owner : cdd_current;
+    int32_t i;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 1; i < pool->size; i++) {
+        pthread_join(pool->threads[i], NULL);
+        __atomic_add_fetch(&owner->active, 1, __ATOMIC_ACQ_REL);
+        cdd_context_destroy(pool->contexts[i]);
+    }
+    for (i = 0; i < pool->requested; i++) {
+        pthread_mutex_destroy(&pool->deques[i].mutex);
+    }
+    pthread_cond_destroy(&pool->idle);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->threads);
+    free(pool->contexts);
+    free(pool->deques);
+    free(pool->workers);
+    free(pool);
+}
+#endif /* CDD_CONCURRENT */
+
+ddNode* cdd_apply_parallel(ddNode* l, ddNode* r, int32_t op, int32_t nthreads)
+{
+#ifdef CDD_CONCURRENT
+    cdd_context* owner = cdd_current->owner ? cdd_current->owner : cdd_current;
+    CddPool* pool = cdd_current->operators->pool;
+    ddNode* res;
+    int32_t i;
+
+    if (nthreads <= 1) {
+        return cdd_apply(l, r, op);
+    }
+
+    /* Worker contexts hold copies of the level information */
+    if (pool != NULL && (pool->requested != nthreads || pool->levels != cdd_levelcnt)) {
+        cdd_pool_destroy(pool);
+        pool = NULL;
+    }
+    if (pool == NULL) {
+        pool = cdd_current->operators->pool = cdd_pool_create(nthreads);
+    }
+    if (pool == NULL || pool->size == 1) {
+        return cdd_apply(l, r, op);
+    }
+
+    /* Start the workers */
+    __atomic_add_fetch(&owner->active, pool->size - 1, __ATOMIC_ACQ_REL);
+    pthread_mutex_lock(&pool->mutex);
+    pool->op = op;
+    pool->cutoff = cdd_current->operators->parallel_cutoff;
+    pool->finished = 0;
+    pool->busy = pool->size - 1;
+    pool->job++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->mutex);
+
+    applyop = op;
+    res = cdd_apply_par(pool, 0, l, r, 0);
+
+    /* Wait for the workers to become idle */
+    __atomic_store_n(&pool->finished, 1, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->busy > 0) {
+        pthread_cond_wait(&pool->idle, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    __atomic_sub_fetch(&owner->active, pool->size - 1, __ATOMIC_ACQ_REL);
+
+    for (i = 1; i < pool->size; i++) {
+        if (pool->contexts[i]->errorcond) {
+            cdd_errorcond = pool->contexts[i]->errorcond;
+            pool->contexts[i]->errorcond = 0;
+        }
+    }
+    if (cdd_errorcond) {
+        cdd_error(cdd_errorcond);
+        return NULL;
+    }
+    return res;
+#else
+    (void)nthreads;
+    return cdd_apply(l, r, op);
+#endif
+}
+
+void cdd_parallel_cutoff(int32_t depth) { cdd_current->operators->parallel_cutoff = depth; }
+
 ///////////////////////////////////////////////////////////////////////////
 
 static bool cdd_constrain2(raw_t* dbm, uint32_t dim, uint32_t i, uint32_t j, raw_t lower, raw_t upper)
@@ -341,18 +1083,191 @@ static bool cdd_constrain2(raw_t* dbm, uint32_t dim, uint32_t i, uint32_t j, raw
 
 ///////////////////////////////////////////////////////////////////////////
 
+/* Applies \a op within cdd_ite_rec() */
+static inline ddNode* cdd_ite_apply(ddNode* l, ddNode* r, int32_t op)
+{
+    applyop = op;
+    return cdd_apply_rec(l, r);
+}
+
+static ddNode* cdd_ite_rec(ddNode* f, ddNode* g, ddNode* h)
+{
+    CddCacheData3* entry;
+    int32_t level;
+    int32_t mask;
+    int32_t neg;
+    Elem* top;
+    Elem* first;
+    cdd_iterator fi, gi, hi;
+    cdd_handle_t fc, gc, hc;
+    ddNode* n;
+    ddNode* prev;
+    ddNode* res;
+    raw_t bnd;
+
+    /* Back off in case of error */
+    if (cdd_errorcond) {
+        return 0;
+    }
+
+    /* Termination conditions */
+    if (IS_TRUE(f) || g == h) {
+        return g;
+    }
+    if (IS_FALSE(f)) {
+        return h;
+    }
+
+    /* Replace operands equal to the condition by constants */
+    if (g == f) {
+        g = cddtrue;
+    } else if (g == cdd_neg(f)) {
+        g = cddfalse;
+    }
+    if (h == f) {
+        h = cddfalse;
+    } else if (h == cdd_neg(f)) {
+        h = cddtrue;
+    }
+
+    /* With a constant operand the operation is a binary one */
+    if (g == cddtrue) {
+        return h == cddfalse ? f : cdd_neg_result(cdd_ite_apply(cdd_neg(f), cdd_neg(h), cddop_and));
+    }
+    if (g == cddfalse) {
+        return h == cddtrue ? cdd_neg(f) : cdd_ite_apply(cdd_neg(f), h, cddop_and);
+    }
+    if (h == cddfalse) {
+        return cdd_ite_apply(f, g, cddop_and);
+    }
+    if (h == cddtrue) {
+        return cdd_neg_result(cdd_ite_apply(f, cdd_neg(g), cddop_and));
+    }
+
+    /* Normalise such that the condition and the then-operand are
+     * regular, for better cache performance.
+     */
+    if (cdd_mask(f)) {
+        f = cdd_rglr(f);
+        n = g;
+        g = h;
+        h = n;
+    }
+    neg = cdd_mask(g);
+    g = cdd_neg_cond(g, neg);
+    h = cdd_neg_cond(h, neg);
+
+    /* Do cache lookup */
+    entry = CddCache_lookup3(&itecache, ITEHASH(f, g, h), f, (uintptr_t)g, (uintptr_t)h);
+    if (entry != NULL) {
+        if (cdd_rglr(entry->res)->ref == 0) {
+            CddCache_count(&itecache, reclaims);
+            cdd_reclaim(entry->res);
+        }
+        return cdd_neg_cond(entry->res, neg);
+    }
+
+    level = minimum(minimum(f->level, cdd_rglr(g)->level), cdd_rglr(h)->level);
+    switch (cdd_levelinfo[level].type) {
+    case TYPE_CDD:
+        cdd_it_operand(&fi, f, level, &fc);
+        cdd_it_operand(&gi, g, level, &gc);
+        cdd_it_operand(&hi, h, level, &hc);
+
+        top = first = cdd_refstacktop;
+
+        /* Do first recursion - check whether first edge is negated */
+        prev = cdd_ite_rec(cdd_it_child(fi), cdd_it_child(gi), cdd_it_child(hi));
+        if (prev == NULL) {
+            return 0;
+        }
+        cdd_ref(prev);
+        mask = cdd_mask(prev);
+        bnd = minimum(minimum(cdd_it_upper(fi), cdd_it_upper(gi)), cdd_it_upper(hi));
+
+        /* Continue */
+        while (bnd < INF) {
+            cdd_it_step(fi, bnd);
+            cdd_it_step(gi, bnd);
+            cdd_it_step(hi, bnd);
+            n = cdd_ite_rec(cdd_it_child(fi), cdd_it_child(gi), cdd_it_child(hi));
+            if (n == NULL) {
+                break;
+            }
+            if (n != prev) {
+                cdd_push(cdd_neg_cond(prev, mask), bnd);
+                if (cdd_errorcond) {
+                    break;
+                }
+                prev = n;
+                cdd_ref(prev);
+            }
+            bnd = minimum(minimum(cdd_it_upper(fi), cdd_it_upper(gi)), cdd_it_upper(hi));
+        }
+        if (!cdd_errorcond) {
+            cdd_push(cdd_neg_cond(prev, mask), INF);
+        }
+
+        /* Back off in case of error; prev is not on the stack */
+        if (cdd_errorcond) {
+            cdd_deref(prev);
+            cdd_unwind(first, top);
+            return 0;
+        }
+
+        /* Create node */
+        res = cdd_make_cdd_node(level, first, cdd_refstacktop - first);
+
+        /* Remove references */
+        for (; first < cdd_refstacktop; first++) {
+            cdd_deref(cdd_ptr(first->child));
+        }
+
+        /* Restore stacktop */
+        cdd_refstacktop = top;
+
+        if (res == NULL) {
+            return 0;
+        }
+        res = cdd_neg_cond(res, mask);
+        break;
+    case TYPE_BDD:
+        n = cdd_ite_rec(f->level == level ? bdd_low(f) : f, cdd_rglr(g)->level == level ? bdd_low(g) : g,
+                        cdd_rglr(h)->level == level ? bdd_low(h) : h);
+        if (n == NULL) {
+            return 0;
+        }
+        cdd_ref(n);
+        prev = cdd_ite_rec(f->level == level ? bdd_high(f) : f, cdd_rglr(g)->level == level ? bdd_high(g) : g,
+                           cdd_rglr(h)->level == level ? bdd_high(h) : h);
+        res = prev == NULL ? NULL : cdd_make_bdd_node(level, n, prev);
+        cdd_deref(n);
+        if (res == NULL) {
+            return 0;
+        }
+        break;
+    default: res = NULL;
+    }
+
+    /* Update cache entry */
+    entry = cdd_cache_store3(&itecache, ITEHASH(f, g, h), f, (uintptr_t)g, (uintptr_t)h);
+    entry->res = res;
+
+    return cdd_neg_cond(res, neg);
+}
+
 ddNode* cdd_ite(ddNode* f, ddNode* g, ddNode* h)
 {
-    g = cdd_and(f, g);
-    cdd_ref(g);
-    h = cdd_and(cdd_neg(f), h);
-    cdd_ref(h);
-    f = cdd_or(g, h);
-    cdd_ref(f);
-    cdd_rec_deref(g);
-    cdd_rec_deref(h);
-    cdd_deref(f);
-    return f;
+    ddNode* res;
+    int32_t op = applyop;
+
+    res = cdd_ite_rec(f, g, h);
+    applyop = op;
+    if (cdd_errorcond) {
+        cdd_error(cdd_errorcond);
+        return NULL;
+    }
+    return res;
 }
 
 int32_t cdd_contains(ddNode* node, raw_t* dbm, uint32_t dim)
@@ -364,6 +1279,7 @@ int32_t cdd_contains(ddNode* node, raw_t* dbm, uint32_t dim)
 static int32_t cdd_contains_rec(ddNode* node, raw_t* d, uint32_t dim)
 {
     raw_t* tmp;
+    raw_t lower, upper;
     cdd_iterator it;
     LevelInfo* info;
 
@@ -390,10 +1306,17 @@ static int32_t cdd_contains_rec(ddNode* node, raw_t* d, uint32_t dim)
             return 0;
         }
 
+        /* Only the children whose interval overlaps the bounds of the
+         * DBM on the difference of the level can fail: Seek past
+         * those below the lower bound and stop at the upper bound.
+         */
+        lower = bnd_u2l(d[info->clock2 * dim + info->clock1]);
+        upper = d[info->clock1 * dim + info->clock2];
+
         /* Allocate space for copy */
         tmp = malloc(dim * dim * sizeof(raw_t));
         /* Iterate over children */
-        for (cdd_it_init(it, node); !cdd_it_atend(it); cdd_it_next(it)) {
+        for (cdd_it_seek(&it, node, lower + 1); cdd_it_lower(it) < upper; cdd_it_next(it)) {
             if (!IS_TRUE(cdd_it_child(it))) {
                 dbm_copy(tmp, d, dim);
                 if (cdd_constrain2(tmp, dim, info->clock1, info->clock2, cdd_it_lower(it), cdd_it_upper(it)) &&
@@ -406,7 +1329,8 @@ static int32_t cdd_contains_rec(ddNode* node, raw_t* d, uint32_t dim)
         free(tmp);
         break;
     case TYPE_BDD:
-        if (cdd_contains_rec(bdd_node(node)->low, d, dim) | cdd_contains_rec(bdd_node(node)->high, d, dim))
+        if (cdd_contains_rec(cdd_ptr(bdd_node(node)->low), d, dim) |
+            cdd_contains_rec(cdd_ptr(bdd_node(node)->high), d, dim))
             return 1;
         else
             return 0;
@@ -417,23 +1341,88 @@ static int32_t cdd_contains_rec(ddNode* node, raw_t* d, uint32_t dim)
 
 int32_t cdd_edgecount(ddNode* node)
 {
-    int32_t num;
+    int32_t num;
+
+    if (node == NULL) {
+        return cdd_error(CDD_ILLCDD);
+    }
+    num = 0;
+    cdd_markedgecount(node, &num);
+    cdd_unmark(node);
+    return num;
+}
+
+/* Copies the first \a n elements of \a src into a new array \a dst
+ * of \a size elements padded with zeros, or sets \a dst to NULL if
+ * there are no elements. Returns -1 if out of memory. */
+static int32_t cdd_map_copy(int32_t** dst, const int32_t* src, int32_t n, int32_t size)
+{
+    *dst = NULL;
+    if (src == NULL || size == 0) {
+        return 0;
+    }
+    if ((*dst = (int32_t*)calloc(size, sizeof(int32_t))) == NULL) {
+        return -1;
+    }
+    memcpy(*dst, src, n * sizeof(int32_t));
+    return 0;
+}
+
+/* Registers \a map of the given kind, taking ownership of its arrays,
+ * and returns its handle or an error code. The arrays are released on
+ * failure. */
+static int32_t cdd_map_add(CddVarMap* map, int32_t kind, int32_t copied)
+{
+    CddOperators* ops = cdd_current->operators;
+    CddVarMap* maps = ops->maps;
+
+    map->kind = kind;
+    map->levelcnt = cdd_levelcnt;
+    map->clocknum = cdd_clocknum;
+    if (copied == 0 && ops->mapcnt == ops->mapsize) {
+        if ((maps = (CddVarMap*)realloc(ops->maps, 2 * (ops->mapsize + 4) * sizeof(CddVarMap))) != NULL) {
+            ops->maps = maps;
+            ops->mapsize = 2 * (ops->mapsize + 4);
+        }
+    }
+    if (copied < 0 || maps == NULL) {
+        free(map->levels);
+        free(map->clocks);
+        return cdd_error(CDD_MEMORY);
+    }
+    ops->maps[ops->mapcnt] = *map;
+    return ops->mapcnt++;
+}
+
+/* Returns the map registered as \a handle, or NULL after reporting
+ * CDD_RANGE if there is none of the given kind or if variables were
+ * added since it was registered, as its arrays would be too short. */
+static CddVarMap* cdd_map_get(int32_t handle, int32_t kind)
+{
+    CddOperators* ops = cdd_current->operators;
+    CddVarMap* map;
 
-    if (node == NULL) {
-        return cdd_error(CDD_ILLCDD);
+    if (handle < 0 || handle >= ops->mapcnt) {
+        cdd_error(CDD_RANGE);
+        return NULL;
     }
-    num = 0;
-    cdd_markedgecount(node, &num);
-    cdd_unmark(node);
-    return num;
+    map = ops->maps + handle;
+    if (map->kind != kind || map->levelcnt != cdd_levelcnt || map->clocknum != cdd_clocknum) {
+        cdd_error(CDD_RANGE);
+        return NULL;
+    }
+    return map;
 }
 
-/* Existentially quantify clocks in a CDD.
+/* Existentially quantify clocks in the conjunction of two CDDs,
+ * keying the caches on the current operation id.
  */
 #ifdef EX
-ddNode* cdd_exist(ddNode* node, int32_t* levels_bool, int32_t* clocks, int32_t num_bool_resets,
-                  int32_t num_clock_resets)
+static ddNode* cdd_exist_op(ddNode* l, ddNode* r, int32_t* levels_bool, int32_t* clocks, int32_t num_bool_resets,
+                            int32_t num_clock_resets)
 {
+    ddNode* res;
+
     int32_t i, j;
     raw_t removed_constraint[cdd_clocknum * cdd_clocknum];
     for (i = 0; i < cdd_clocknum; i++) {
@@ -441,13 +1430,56 @@ ddNode* cdd_exist(ddNode* node, int32_t* levels_bool, int32_t* clocks, int32_t n
             removed_constraint[i * cdd_clocknum + j] = INF;
         }
     }
-    opid++;
-    return cdd_exist_rec(node, levels_bool, clocks, num_bool_resets, num_clock_resets, removed_constraint);
+    res = cdd_and_exist_rec(l, r, levels_bool, clocks, num_bool_resets, num_clock_resets, removed_constraint);
+    if (cdd_errorcond) {
+        cdd_error(cdd_errorcond);
+        return NULL;
+    }
+    return res;
+}
+
+ddNode* cdd_exist(ddNode* node, int32_t* levels_bool, int32_t* clocks, int32_t num_bool_resets,
+                  int32_t num_clock_resets)
+{
+    opid = cdd_next_opid();
+    return cdd_exist_op(node, cddtrue, levels_bool, clocks, num_bool_resets, num_clock_resets);
+}
+
+ddNode* cdd_and_exist(ddNode* l, ddNode* r, int32_t* levels_bool, int32_t* clocks, int32_t num_bool_resets,
+                      int32_t num_clock_resets)
+{
+    opid = cdd_next_opid();
+    return cdd_exist_op(l, r, levels_bool, clocks, num_bool_resets, num_clock_resets);
+}
+
+int32_t cdd_register_exist_set(int32_t* levels_bool, int32_t* clocks, int32_t num_bool_resets,
+                               int32_t num_clock_resets)
+{
+    CddVarMap map = {NULL, NULL, num_bool_resets, num_clock_resets, 0, 0, 0};
+    int32_t copied = cdd_map_copy(&map.levels, levels_bool, num_bool_resets, num_bool_resets);
+
+    /* relax() looks the clocks up by clock number */
+    copied |= cdd_map_copy(&map.clocks, clocks, num_clock_resets, maximum(num_clock_resets, cdd_clocknum));
+    return cdd_map_add(&map, MAP_EXIST, copied);
+}
+
+ddNode* cdd_and_exist_set(ddNode* l, ddNode* r, int32_t handle)
+{
+    CddVarMap* map = cdd_map_get(handle, MAP_EXIST);
+
+    if (map == NULL) {
+        return NULL;
+    }
+    opid = MAPID(handle);
+    return cdd_exist_op(l, r, map->levels, map->clocks, map->num_bools, map->num_clocks);
 }
+
+ddNode* cdd_exist_set(ddNode* node, int32_t handle) { return cdd_and_exist_set(node, cddtrue, handle); }
 #else
 ddNode* cdd_exist(ddNode* node, int32_t* levels)
 {
-    opid++;
+    /* The key holds the constraint rather than the operation */
+    CddCache_reset(&quantcache);
     return cdd_exist_rec(node, levels, cddtrue);
 }
 #endif
@@ -472,16 +1504,16 @@ static void cdd_check(ddNode *node)
         }
         break;
     case TYPE_BDD:
-        if (cdd_rglr(bdd_node(node)->low)->ref == 0) {
+        if (cdd_rglr(cdd_ptr(bdd_node(node)->low))->ref == 0) {
             fprintf(stderr, "Invalid CDD\n");
             return;
         }
-        if (cdd_rglr(bdd_node(node)->high)->ref == 0) {
+        if (cdd_rglr(cdd_ptr(bdd_node(node)->high))->ref == 0) {
             fprintf(stderr, "Invalid CDD\n");
             return;
         }
-        cdd_check(bdd_node(node)->low);
-        cdd_check(bdd_node(node)->high);
+        cdd_check(cdd_ptr(bdd_node(node)->low));
+        cdd_check(cdd_ptr(bdd_node(node)->high));
     }
 }
 */
@@ -550,9 +1582,10 @@ static ddNode* cdd_exist_rec(ddNode* node, int32_t* levels, ddNode* c)
     }
 #endif
 
-    entry = CddCache_lookup(&quantcache, EXISTHASH(node, c, opid));
-    if (entry->a == node && entry->b == c && entry->c == opid) {
+    entry = CddCache_lookup(&quantcache, APPLYHASH(node, c, 0), node, (uintptr_t)c);
+    if (entry != NULL) {
         if (cdd_rglr(entry->res)->ref == 0) {
+            CddCache_count(&quantcache, reclaims);
             cdd_reclaim(entry->res);
         }
         return entry->res;
@@ -629,9 +1662,7 @@ static ddNode* cdd_exist_rec(ddNode* node, int32_t* levels, ddNode* c)
         }
     }
 
-    entry->a = node;
-    entry->b = c;
-    entry->c = opid;
+    entry = cdd_cache_store(&quantcache, APPLYHASH(node, c, 0), node, (uintptr_t)c);
     entry->res = res;
 
     return res;
@@ -655,18 +1686,31 @@ static ddNode* relax(ddNode* node, int32_t* clocks, raw_t lower, int32_t clock1,
     CddRelaxCacheData* entry;
 #endif
 
+    /* Back off in case of error */
+    if (cdd_errorcond) {
+        return 0;
+    }
+
     if (cdd_isterminal(node)) {
         return node;
     }
 
 #ifdef RELAXCACHE
-    entry = CddCache_lookup(&relaxcache, RELAXHASH(node, lower, clock1, clock2, upper));
+    entry = CddRelaxCache_lookup(&relaxcache, RELAXHASH(node, lower, clock1, clock2, upper));
     if (entry->node == node && entry->lower == lower && entry->upper == upper && entry->clock1 == clock1 &&
         entry->clock2 == clock2 && entry->op == opid) {
-        if (cdd_rglr(entry->res)->ref == 0) {
-            cdd_reclaim(entry->res);
+        if (entry->epoch == relaxcache.epoch) {
+            CddCache_count(&relaxcache, hits);
+            if (cdd_rglr(entry->res)->ref == 0) {
+                CddCache_count(&relaxcache, reclaims);
+                cdd_reclaim(entry->res);
+            }
+            return entry->res;
         }
-        return entry->res;
+        CddCache_count(&relaxcache, stale);
+    }
+    if (entry->node != NULL && entry->epoch == relaxcache.epoch) {
+        CddCache_count(&relaxcache, overwrites);
     }
 #endif
 
@@ -677,7 +1721,7 @@ static ddNode* relax(ddNode* node, int32_t* clocks, raw_t lower, int32_t clock1,
     case TYPE_CDD:
         res = cddfalse;
         cdd_it_init(it, node);
-        while (!cdd_it_atend(it)) {
+        while (!cdd_it_atend(it) && !cdd_errorcond) {
             // Detect consequences
             if (info->clock1 == clock1 && clocks[clock1]) {
                 pos = info->clock2;
@@ -706,20 +1750,20 @@ static ddNode* relax(ddNode* node, int32_t* clocks, raw_t lower, int32_t clock1,
             // Call relax recursively
 
             tmp2 = relax(cdd_it_child(it), clocks, lower, clock1, clock2, upper, rc);
-            cdd_ref(tmp2);
+            cdd_ref_result(tmp2);
 
             // Add consequence if tighter then those already removed
             if (pos > -1) {
                 if ((l > bnd_u2l(rc[neg * cdd_clocknum + pos])) || (u < rc[pos * cdd_clocknum + neg])) {
                     tmp3 = cdd_interval(pos, neg, maximum(l, bnd_u2l(rc[neg * cdd_clocknum + pos])),
                                         minimum(u, rc[pos * cdd_clocknum + neg]));
-                    cdd_ref(tmp3);
+                    cdd_ref_result(tmp3);
 
                     tmp4 = cdd_and(tmp2, tmp3);
-                    cdd_ref(tmp4);
+                    cdd_ref_result(tmp4);
 
-                    cdd_rec_deref(tmp2);
-                    cdd_rec_deref(tmp3);
+                    cdd_rec_deref_result(tmp2);
+                    cdd_rec_deref_result(tmp3);
 
                     tmp2 = tmp4;
                 }
@@ -727,18 +1771,18 @@ static ddNode* relax(ddNode* node, int32_t* clocks, raw_t lower, int32_t clock1,
 
             // Rebuild CDD by adding constraints from node
             tmp3 = cdd_interval_from_level(cdd_rglr(node)->level, cdd_it_lower(it), cdd_it_upper(it));
-            cdd_ref(tmp3);
+            cdd_ref_result(tmp3);
 
             tmp4 = cdd_and(tmp2, tmp3);
-            cdd_ref(tmp4);
+            cdd_ref_result(tmp4);
 
             tmp5 = cdd_or(res, tmp4);
-            cdd_ref(tmp5);
+            cdd_ref_result(tmp5);
 
-            cdd_rec_deref(tmp2);
-            cdd_rec_deref(tmp3);
-            cdd_rec_deref(tmp4);
-            cdd_rec_deref(res);
+            cdd_rec_deref_result(tmp2);
+            cdd_rec_deref_result(tmp3);
+            cdd_rec_deref_result(tmp4);
+            cdd_rec_deref_result(res);
 
             res = tmp5;
             cdd_it_next(it);
@@ -746,20 +1790,23 @@ static ddNode* relax(ddNode* node, int32_t* clocks, raw_t lower, int32_t clock1,
         break;
     case TYPE_BDD:
         tmp1 = relax(bdd_low(node), clocks, lower, clock1, clock2, upper, rc);
-        cdd_ref(tmp1);
+        cdd_ref_result(tmp1);
 
         tmp2 = relax(bdd_high(node), clocks, lower, clock1, clock2, upper, rc);
-        cdd_ref(tmp2);
+        cdd_ref_result(tmp2);
 
         tmp3 = cdd_bddvar(cdd_rglr(node)->level);
-        cdd_ref(tmp3);
+        cdd_ref_result(tmp3);
 
         res = cdd_ite(tmp3, tmp2, tmp1);
-        cdd_ref(res);
-        cdd_rec_deref(tmp1);
-        cdd_rec_deref(tmp2);
-        cdd_rec_deref(tmp3);
-        cdd_deref(res);
+        cdd_ref_result(res);
+        cdd_rec_deref_result(tmp1);
+        cdd_rec_deref_result(tmp2);
+        cdd_rec_deref_result(tmp3);
+        cdd_deref_result(res);
+    }
+    if (cdd_errorcond) {
+        return 0;
     }
 
 #ifdef RELAXCACHE
@@ -769,6 +1816,7 @@ static ddNode* relax(ddNode* node, int32_t* clocks, raw_t lower, int32_t clock1,
     entry->clock1 = clock1;
     entry->clock2 = clock2;
     entry->op = opid;
+    entry->epoch = relaxcache.epoch;
     entry->res = res;
 #endif
 
@@ -788,15 +1836,22 @@ static ddNode* cdd_exist_rec(ddNode* node, int32_t* levels_bool, int32_t* clocks
     ddNode* tmp4;
     raw_t old_lower, old_upper;
 
+    /* Back off in case of error */
+    if (cdd_errorcond) {
+        return 0;
+    }
+
     if (cdd_isterminal(node)) {
         return node;
     }
 
     //    cdd2Dot("debug.dot", node, "InEx");
-    entry = CddCache_lookup(&quantcache, EXISTHASH(node));
-    if (entry->a == node && entry->c == opid) {
-        if (cdd_rglr(entry->res)->ref == 0)
+    entry = CddCache_lookup(&quantcache, EXISTHASH(node), node, opid);
+    if (entry != NULL) {
+        if (cdd_rglr(entry->res)->ref == 0) {
+            CddCache_count(&quantcache, reclaims);
             cdd_reclaim(entry->res);
+        }
         return entry->res;
     }
 
@@ -813,7 +1868,7 @@ static ddNode* cdd_exist_rec(ddNode* node, int32_t* levels_bool, int32_t* clocks
                 break;
         }
         if (level_affected_by_reset) {
-            while (!cdd_it_atend(it)) {
+            while (!cdd_it_atend(it) && !cdd_errorcond) {
                 // Here we add the constraint32_t to rc - we save the old
                 // constraints so they can be restored.
                 old_lower = rc[info->clock2 * cdd_clocknum + info->clock1];
@@ -825,17 +1880,17 @@ static ddNode* cdd_exist_rec(ddNode* node, int32_t* levels_bool, int32_t* clocks
                 tmp1 =
                     relax(cdd_it_child(it), clocks, cdd_it_lower(it), info->clock1, info->clock2, cdd_it_upper(it), rc);
 
-                cdd_ref(tmp1);
+                cdd_ref_result(tmp1);
 
                 tmp2 = cdd_exist_rec(tmp1, levels_bool, clocks, num_bool_resets, num_clock_resets, rc);
-                cdd_ref(tmp2);
+                cdd_ref_result(tmp2);
 
                 tmp3 = cdd_or(res, tmp2);
-                cdd_ref(tmp3);
+                cdd_ref_result(tmp3);
 
-                cdd_rec_deref(res);
-                cdd_rec_deref(tmp1);
-                cdd_rec_deref(tmp2);
+                cdd_rec_deref_result(res);
+                cdd_rec_deref_result(tmp1);
+                cdd_rec_deref_result(tmp2);
                 res = tmp3;
 
                 // Here we restore the constraint
@@ -845,35 +1900,35 @@ static ddNode* cdd_exist_rec(ddNode* node, int32_t* levels_bool, int32_t* clocks
                 cdd_it_next(it);
             }
         } else {
-            while (!cdd_it_atend(it)) {
+            while (!cdd_it_atend(it) && !cdd_errorcond) {
                 tmp1 = cdd_interval_from_level(cdd_rglr(node)->level, cdd_it_lower(it), cdd_it_upper(it));
-                cdd_ref(tmp1);
+                cdd_ref_result(tmp1);
 
                 tmp2 = cdd_exist_rec(cdd_it_child(it), levels_bool, clocks, num_bool_resets, num_clock_resets, rc);
-                cdd_ref(tmp2);
+                cdd_ref_result(tmp2);
 
                 tmp3 = cdd_and(tmp1, tmp2);
-                cdd_ref(tmp3);
+                cdd_ref_result(tmp3);
 
                 tmp4 = cdd_or(res, tmp3);
-                cdd_ref(tmp4);
+                cdd_ref_result(tmp4);
 
-                cdd_rec_deref(res);
-                cdd_rec_deref(tmp1);
-                cdd_rec_deref(tmp2);
-                cdd_rec_deref(tmp3);
+                cdd_rec_deref_result(res);
+                cdd_rec_deref_result(tmp1);
+                cdd_rec_deref_result(tmp2);
+                cdd_rec_deref_result(tmp3);
                 res = tmp4;
                 cdd_it_next(it);
             }
         }
-        cdd_deref(res);
+        cdd_deref_result(res);
         break;
     case TYPE_BDD:
         tmp1 = cdd_exist_rec(bdd_low(node), levels_bool, clocks, num_bool_resets, num_clock_resets, rc);
-        cdd_ref(tmp1);
+        cdd_ref_result(tmp1);
 
         tmp2 = cdd_exist_rec(bdd_high(node), levels_bool, clocks, num_bool_resets, num_clock_resets, rc);
-        cdd_ref(tmp2);
+        cdd_ref_result(tmp2);
         // check if the bool
         level_affected_by_reset = false;
         for (int32_t i = 0; i < num_bool_resets; i++) {
@@ -885,34 +1940,417 @@ static ddNode* cdd_exist_rec(ddNode* node, int32_t* levels_bool, int32_t* clocks
         if (level_affected_by_reset) {  // TODO: check if the regularize here really was ment to be removed
                                         // if (levels[cdd_rglr(node)->level]) {
             res = cdd_or(tmp1, tmp2);
-            cdd_ref(res);
+            cdd_ref_result(res);
         } else {
             tmp3 = cdd_bddvar(cdd_rglr(node)->level);  // TODO: test if we can remove regularization
-            cdd_ref(tmp3);
+            cdd_ref_result(tmp3);
             res = cdd_ite(tmp3, tmp2, tmp1);
-            cdd_ref(res);
-            cdd_rec_deref(tmp3);
+            cdd_ref_result(res);
+            cdd_rec_deref_result(tmp3);
+        }
+
+        cdd_rec_deref_result(tmp1);
+        cdd_rec_deref_result(tmp2);
+        cdd_deref_result(res);
+    }
+    if (cdd_errorcond) {
+        return 0;
+    }
+
+    entry = cdd_cache_store(&quantcache, EXISTHASH(node), node, opid);
+    entry->res = res;
+
+    return res;
+}
+
+/* Returns true if quantifying \a clocks affects the constraints of \a info */
+static int32_t cdd_exist_affects(LevelInfo* info, int32_t* clocks, int32_t num_clock_resets)
+{
+    int32_t i;
+
+    for (i = 0; i < num_clock_resets; i++) {
+        if (clocks[i] == info->clock1 || clocks[i] == info->clock2) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Quantifies the conjunction of \a l and \a r, which is only made
+ * from the first level whose constraints are relaxed down, as relax()
+ * works on a single CDD. Above that level the conjunction is walked
+ * like by cdd_apply(), and boolean levels are quantified on the fly.
+ */
+static ddNode* cdd_and_exist_rec(ddNode* l, ddNode* r, int32_t* levels_bool, int32_t* clocks, int32_t num_bool_resets,
+                                 int32_t num_clock_resets, raw_t* rc)
+{
+    CddCacheData3* entry;
+    LevelInfo* info;
+    cdd_iterator li, ri;
+    cdd_handle_t lhandle, rhandle;
+    int32_t level;
+    int32_t i;
+    bool quantified;
+    ddNode* res;
+    ddNode* tmp1;
+    ddNode* tmp2;
+    ddNode* tmp3;
+    raw_t lower;
+    raw_t bnd;
+
+    /* Back off in case of error */
+    if (cdd_errorcond) {
+        return 0;
+    }
+
+    /* Termination conditions */
+    if (l == cddfalse || r == cddfalse || l == cdd_neg(r)) {
+        return cddfalse;
+    }
+    if (l == r || r == cddtrue) {
+        return cdd_exist_rec(l, levels_bool, clocks, num_bool_resets, num_clock_resets, rc);
+    }
+    if (l == cddtrue) {
+        return cdd_exist_rec(r, levels_bool, clocks, num_bool_resets, num_clock_resets, rc);
+    }
+
+    /* The conjunction is symmetric; normalise for better cache performance */
+    if (l > r) {
+        res = l;
+        l = r;
+        r = res;
+    }
+
+    /* Do cache lookup */
+    entry = CddCache_lookup3(&itecache, ITEHASH(l, r, opid), l, (uintptr_t)r, ANDEXISTKEY(opid));
+    if (entry != NULL) {
+        if (cdd_rglr(entry->res)->ref == 0) {
+            CddCache_count(&itecache, reclaims);
+            cdd_reclaim(entry->res);
+        }
+        return entry->res;
+    }
+
+    level = minimum(cdd_rglr(l)->level, cdd_rglr(r)->level);
+    info = cdd_levelinfo + level;
+    if (cdd_isterminal(l) || cdd_isterminal(r) ||
+        (info->type == TYPE_CDD && cdd_exist_affects(info, clocks, num_clock_resets))) {
+        /* Make the conjunction and quantify it */
+        tmp1 = cdd_and(l, r);
+        cdd_ref_result(tmp1);
+        res = cdd_exist_rec(tmp1, levels_bool, clocks, num_bool_resets, num_clock_resets, rc);
+        cdd_ref_result(res);
+        cdd_rec_deref_result(tmp1);
+        cdd_deref_result(res);
+    } else if (info->type == TYPE_CDD) {
+        res = cddfalse;
+        cdd_it_operand(&li, l, level, &lhandle);
+        cdd_it_operand(&ri, r, level, &rhandle);
+        for (lower = -INF; lower < INF && !cdd_errorcond; lower = bnd) {
+            bnd = minimum(cdd_it_upper(li), cdd_it_upper(ri));
+            tmp1 = cdd_interval_from_level(level, lower, bnd);
+            cdd_ref_result(tmp1);
+
+            tmp2 = cdd_and_exist_rec(cdd_it_child(li), cdd_it_child(ri), levels_bool, clocks, num_bool_resets,
+                                     num_clock_resets, rc);
+            cdd_ref_result(tmp2);
+
+            tmp3 = cdd_and(tmp1, tmp2);
+            cdd_ref_result(tmp3);
+            cdd_rec_deref_result(tmp1);
+            cdd_rec_deref_result(tmp2);
+
+            tmp1 = cdd_or(res, tmp3);
+            cdd_ref_result(tmp1);
+            cdd_rec_deref_result(res);
+            cdd_rec_deref_result(tmp3);
+            res = tmp1;
+
+            cdd_it_step(li, bnd);
+            cdd_it_step(ri, bnd);
+        }
+        cdd_deref_result(res);
+    } else {
+        quantified = false;
+        for (i = 0; i < num_bool_resets && !quantified; i++) {
+            quantified = levels_bool[i] == level;
+        }
+
+        tmp1 = cdd_and_exist_rec(cdd_rglr(l)->level == level ? bdd_low(l) : l,
+                                 cdd_rglr(r)->level == level ? bdd_low(r) : r, levels_bool, clocks, num_bool_resets,
+                                 num_clock_resets, rc);
+        if (quantified && tmp1 == cddtrue) {
+            /* The high branch cannot add anything */
+            res = cddtrue;
+        } else {
+            cdd_ref_result(tmp1);
+            tmp2 = cdd_and_exist_rec(cdd_rglr(l)->level == level ? bdd_high(l) : l,
+                                     cdd_rglr(r)->level == level ? bdd_high(r) : r, levels_bool, clocks,
+                                     num_bool_resets, num_clock_resets, rc);
+            cdd_ref_result(tmp2);
+            res = cdd_errorcond ? NULL : quantified ? cdd_or(tmp1, tmp2) : cdd_make_bdd_node(level, tmp1, tmp2);
+            cdd_ref_result(res);
+            cdd_rec_deref_result(tmp1);
+            cdd_rec_deref_result(tmp2);
+            cdd_deref_result(res);
+        }
+    }
+
+    if (cdd_errorcond) {
+        return 0;
+    }
+
+    /* Update cache entry */
+    entry = cdd_cache_store3(&itecache, ITEHASH(l, r, opid), l, (uintptr_t)r, ANDEXISTKEY(opid));
+    entry->res = res;
+
+    return res;
+}
+#endif
+
+/* Letting time pass, forwards or backwards, changes the bounds of the
+ * clocks by the same delay and keeps their differences. Eliminating
+ * the delay from the bounds of two clocks i and j on a path gives the
+ * constraints x_i - x_j <= u_i - l_j and x_j - x_i <= u_j - l_i. This
+ * adds those constraints between \a clock, whose bounds on the path
+ * above are \a lower and \a upper, and the clocks bounded in \a node,
+ * like relax() does for the clocks of cdd_exist(). */
+static ddNode* cdd_time_relax(ddNode* node, int32_t clock, raw_t lower, raw_t upper)
+{
+    LevelInfo* info;
+    cdd_iterator it;
+    ddNode* res;
+    ddNode* tmp1;
+    ddNode* tmp2;
+    ddNode* tmp3;
+    raw_t l;
+    raw_t u;
+#ifdef RELAXCACHE
+    CddRelaxCacheData* entry;
+#endif
+
+    /* Back off in case of error */
+    if (cdd_errorcond) {
+        return 0;
+    }
+
+    if (cdd_isterminal(node) || (lower == -INF && upper == INF)) {
+        return node;
+    }
+
+#ifdef RELAXCACHE
+    entry = CddRelaxCache_lookup(&relaxcache, RELAXHASH(node, lower, clock, 0, upper));
+    if (entry->node == node && entry->lower == lower && entry->upper == upper && entry->clock1 == clock &&
+        entry->clock2 == 0 && entry->op == TIMEOP) {
+        if (entry->epoch == relaxcache.epoch) {
+            CddCache_count(&relaxcache, hits);
+            if (cdd_rglr(entry->res)->ref == 0) {
+                CddCache_count(&relaxcache, reclaims);
+                cdd_reclaim(entry->res);
+            }
+            return entry->res;
+        }
+        CddCache_count(&relaxcache, stale);
+    }
+    if (entry->node != NULL && entry->epoch == relaxcache.epoch) {
+        CddCache_count(&relaxcache, overwrites);
+    }
+#endif
+
+    info = cdd_info(node);
+    res = cddfalse;
+    switch (info->type) {
+    case TYPE_CDD:
+        for (cdd_it_init(it, node); !cdd_it_atend(it) && !cdd_errorcond; cdd_it_next(it)) {
+            if (IS_FALSE(cdd_it_child(it))) {
+                continue;
+            }
+            tmp1 = cdd_time_relax(cdd_it_child(it), clock, lower, upper);
+            cdd_ref_result(tmp1);
+
+            // Add the consequences for a bound of another clock
+            if (info->clock2 == 0 && info->clock1 != clock) {
+                l = bnd_u2l(bnd_add(cdd_it_upper(it), bnd_l2u(lower)));
+                u = bnd_add(upper, bnd_l2u(cdd_it_lower(it)));
+                if (l != -INF || u != INF) {
+                    tmp2 = cdd_interval(clock, info->clock1, l, u);
+                    cdd_ref_result(tmp2);
+                    tmp3 = cdd_and(tmp1, tmp2);
+                    cdd_ref_result(tmp3);
+                    cdd_rec_deref_result(tmp1);
+                    cdd_rec_deref_result(tmp2);
+                    tmp1 = tmp3;
+                }
+            }
+
+            // Rebuild CDD by adding constraints from node
+            tmp2 = cdd_interval_from_level(cdd_rglr(node)->level, cdd_it_lower(it), cdd_it_upper(it));
+            cdd_ref_result(tmp2);
+            tmp3 = cdd_and(tmp1, tmp2);
+            cdd_ref_result(tmp3);
+            cdd_rec_deref_result(tmp1);
+            cdd_rec_deref_result(tmp2);
+            tmp1 = cdd_or(res, tmp3);
+            cdd_ref_result(tmp1);
+            cdd_rec_deref_result(res);
+            cdd_rec_deref_result(tmp3);
+            res = tmp1;
+        }
+        cdd_deref_result(res);
+        break;
+    case TYPE_BDD:
+        tmp1 = cdd_time_relax(bdd_low(node), clock, lower, upper);
+        cdd_ref_result(tmp1);
+        tmp2 = cdd_time_relax(bdd_high(node), clock, lower, upper);
+        cdd_ref_result(tmp2);
+        tmp3 = cdd_bddvar(cdd_rglr(node)->level);
+        cdd_ref_result(tmp3);
+        res = cdd_ite(tmp3, tmp2, tmp1);
+        cdd_ref_result(res);
+        cdd_rec_deref_result(tmp1);
+        cdd_rec_deref_result(tmp2);
+        cdd_rec_deref_result(tmp3);
+        cdd_deref_result(res);
+    }
+    if (cdd_errorcond) {
+        return 0;
+    }
+
+#ifdef RELAXCACHE
+    entry->node = node;
+    entry->lower = lower;
+    entry->upper = upper;
+    entry->clock1 = clock;
+    entry->clock2 = 0;
+    entry->op = TIMEOP;
+    entry->epoch = relaxcache.epoch;
+    entry->res = res;
+#endif
+
+    return res;
+}
+
+/* Lets time pass in \a node, forwards if \a op is UPKEY and backwards
+ * if it is DOWNKEY. The upper respectively lower bounds of the clocks
+ * are dropped after cdd_time_relax() has added their consequences,
+ * and all other constraints are kept. The result only depends on \a
+ * node, so it is memoized per node. */
+static ddNode* cdd_time_rec(ddNode* node, uintptr_t op)
+{
+    LevelInfo* info;
+    CddCacheData* entry;
+    cdd_iterator it;
+    ddNode* res;
+    ddNode* tmp1;
+    ddNode* tmp2;
+    ddNode* tmp3;
+
+    /* Back off in case of error */
+    if (cdd_errorcond) {
+        return 0;
+    }
+
+    if (cdd_isterminal(node)) {
+        return node;
+    }
+
+    entry = CddCache_lookup(&applycache, TIMEHASH(node, op), node, op);
+    if (entry != NULL) {
+        if (cdd_rglr(entry->res)->ref == 0) {
+            CddCache_count(&applycache, reclaims);
+            cdd_reclaim(entry->res);
         }
+        return entry->res;
+    }
 
-        cdd_rec_deref(tmp1);
-        cdd_rec_deref(tmp2);
-        cdd_deref(res);
+    info = cdd_info(node);
+    res = cddfalse;
+    switch (info->type) {
+    case TYPE_CDD:
+        for (cdd_it_init(it, node); !cdd_it_atend(it) && !cdd_errorcond; cdd_it_next(it)) {
+            if (IS_FALSE(cdd_it_child(it))) {
+                continue;
+            }
+            if (info->clock2 == 0) {
+                tmp1 = cdd_time_relax(cdd_it_child(it), info->clock1, cdd_it_lower(it), cdd_it_upper(it));
+                cdd_ref_result(tmp1);
+                tmp2 = cdd_time_rec(tmp1, op);
+                cdd_ref_result(tmp2);
+                cdd_rec_deref_result(tmp1);
+                tmp1 = op == UPKEY ? cdd_interval_from_level(cdd_rglr(node)->level, cdd_it_lower(it), INF)
+                                   : cdd_interval_from_level(cdd_rglr(node)->level, -INF, cdd_it_upper(it));
+            } else {
+                tmp2 = cdd_time_rec(cdd_it_child(it), op);
+                cdd_ref_result(tmp2);
+                tmp1 = cdd_interval_from_level(cdd_rglr(node)->level, cdd_it_lower(it), cdd_it_upper(it));
+            }
+            cdd_ref_result(tmp1);
+            tmp3 = cdd_and(tmp1, tmp2);
+            cdd_ref_result(tmp3);
+            cdd_rec_deref_result(tmp1);
+            cdd_rec_deref_result(tmp2);
+            tmp1 = cdd_or(res, tmp3);
+            cdd_ref_result(tmp1);
+            cdd_rec_deref_result(res);
+            cdd_rec_deref_result(tmp3);
+            res = tmp1;
+        }
+        cdd_deref_result(res);
+        break;
+    case TYPE_BDD:
+        tmp1 = cdd_time_rec(bdd_low(node), op);
+        cdd_ref_result(tmp1);
+        tmp2 = cdd_time_rec(bdd_high(node), op);
+        cdd_ref_result(tmp2);
+        tmp3 = cdd_bddvar(cdd_rglr(node)->level);
+        cdd_ref_result(tmp3);
+        res = cdd_ite(tmp3, tmp2, tmp1);
+        cdd_ref_result(res);
+        cdd_rec_deref_result(tmp1);
+        cdd_rec_deref_result(tmp2);
+        cdd_rec_deref_result(tmp3);
+        cdd_deref_result(res);
+    }
+    if (cdd_errorcond) {
+        return 0;
     }
 
-    entry->a = node;
-    entry->c = opid;
+    entry = cdd_cache_store(&applycache, TIMEHASH(node, op), node, op);
     entry->res = res;
 
     return res;
 }
-#endif
+
+ddNode* cdd_up(ddNode* node) { return cdd_time_rec(node, UPKEY); }
+
+ddNode* cdd_down(ddNode* node) { return cdd_time_rec(node, DOWNKEY); }
 
 ddNode* cdd_replace(ddNode* node, int32_t* levels, int32_t* clocks)
 {
-    opid++;
+    opid = cdd_next_opid();
     return cdd_replace_rec(node, levels, clocks);
 }
 
+int32_t cdd_register_replace_map(int32_t* levels, int32_t* clocks)
+{
+    CddVarMap map = {NULL, NULL, 0, 0, 0, 0, 0};
+    int32_t copied = cdd_map_copy(&map.levels, levels, cdd_levelcnt, cdd_levelcnt);
+
+    copied |= cdd_map_copy(&map.clocks, clocks, cdd_clocknum, cdd_clocknum);
+    return cdd_map_add(&map, MAP_REPLACE, copied);
+}
+
+ddNode* cdd_replace_map(ddNode* node, int32_t handle)
+{
+    CddVarMap* map = cdd_map_get(handle, MAP_REPLACE);
+
+    if (map == NULL) {
+        return NULL;
+    }
+    opid = MAPID(handle);
+    return cdd_replace_rec(node, map->levels, map->clocks);
+}
+
 static ddNode* cdd_replace_rec(ddNode* node, int32_t* levels, int32_t* clocks)
 {
     CddCacheData* entry;
@@ -923,14 +2361,21 @@ static ddNode* cdd_replace_rec(ddNode* node, int32_t* levels, int32_t* clocks)
     cdd_iterator it;
     LevelInfo* info;
 
+    /* Back off in case of error */
+    if (cdd_errorcond) {
+        return 0;
+    }
+
     if (cdd_isterminal(node)) {
         return node;
     }
 
-    entry = CddCache_lookup(&replacecache, REPLACEHASH(node));
-    if (entry->a == node && entry->c == opid) {
-        if (cdd_rglr(entry->res)->ref == 0)
+    entry = CddCache_lookup(&replacecache, REPLACEHASH(node), node, opid);
+    if (entry != NULL) {
+        if (cdd_rglr(entry->res)->ref == 0) {
+            CddCache_count(&replacecache, reclaims);
             cdd_reclaim(entry->res);
+        }
         return entry->res;
     }
 
@@ -939,40 +2384,42 @@ static ddNode* cdd_replace_rec(ddNode* node, int32_t* levels, int32_t* clocks)
     switch (info->type) {
     case TYPE_BDD:
         tmp1 = cdd_bddvar(levels[cdd_rglr(node)->level]);
-        cdd_ref(tmp1);
+        cdd_ref_result(tmp1);
         tmp2 = cdd_replace_rec(bdd_low(node), levels, clocks);
-        cdd_ref(tmp2);
+        cdd_ref_result(tmp2);
         tmp3 = cdd_replace_rec(bdd_high(node), levels, clocks);
-        cdd_ref(tmp3);
+        cdd_ref_result(tmp3);
         res = cdd_ite(tmp1, tmp3, tmp2);
-        cdd_ref(res);
-        cdd_rec_deref(tmp1);
-        cdd_rec_deref(tmp2);
-        cdd_rec_deref(tmp3);
-        cdd_deref(res);
+        cdd_ref_result(res);
+        cdd_rec_deref_result(tmp1);
+        cdd_rec_deref_result(tmp2);
+        cdd_rec_deref_result(tmp3);
+        cdd_deref_result(res);
         break;
     case TYPE_CDD:
         res = cddfalse;
-        for (cdd_it_init(it, node); !cdd_it_atend(it); cdd_it_next(it)) {
+        for (cdd_it_init(it, node); !cdd_it_atend(it) && !cdd_errorcond; cdd_it_next(it)) {
             tmp1 = cdd_interval(clocks[info->clock1], clocks[info->clock2], cdd_it_lower(it), cdd_it_upper(it));
-            cdd_ref(tmp1);
+            cdd_ref_result(tmp1);
             tmp2 = cdd_replace_rec(cdd_it_child(it), levels, clocks);
-            cdd_ref(tmp2);
+            cdd_ref_result(tmp2);
             tmp3 = cdd_and(tmp1, tmp2);
-            cdd_ref(tmp3);
-            cdd_rec_deref(tmp1);
-            cdd_rec_deref(tmp2);
+            cdd_ref_result(tmp3);
+            cdd_rec_deref_result(tmp1);
+            cdd_rec_deref_result(tmp2);
             tmp1 = cdd_or(res, tmp3);
-            cdd_ref(tmp1);
-            cdd_rec_deref(res);
-            cdd_rec_deref(tmp3);
+            cdd_ref_result(tmp1);
+            cdd_rec_deref_result(res);
+            cdd_rec_deref_result(tmp3);
             res = tmp1;
         }
-        cdd_deref(res);
+        cdd_deref_result(res);
+    }
+    if (cdd_errorcond) {
+        return 0;
     }
 
-    entry->a = node;
-    entry->c = opid;
+    entry = cdd_cache_store(&replacecache, REPLACEHASH(node), node, opid);
     entry->res = res;
 
     return res;
@@ -1000,6 +2447,7 @@ ddNode* cdd_from_dbm(const raw_t* dbm, uint32_t dim)
      * lower bound on the node.
      */
     c = cddtrue;
+    top = cdd_refstacktop;
     for (k = cdd_levelcnt - 1; k >= 0; k--) {
         info = cdd_levelinfo + k;
         if (info->type != TYPE_CDD) {
@@ -1034,12 +2482,25 @@ ddNode* cdd_from_dbm(const raw_t* dbm, uint32_t dim)
                 } else {
                     cdd_push(c, INF);
                 }
+                if (cdd_errorcond) {
+                    break;
+                }
 
                 c = cdd_make_cdd_node(k, top, cdd_refstacktop - top);
             } else {
                 cdd_push(cdd_rglr(c), dbm[i * dim + j]);
                 cdd_push(cdd_neg_cond(cddfalse, cdd_mask(c)), INF);
-                c = cdd_neg_cond(cdd_make_cdd_node(k, top, cdd_refstacktop - top), cdd_mask(c));
+                if (cdd_errorcond) {
+                    break;
+                }
+                c = cdd_make_cdd_node(k, top, cdd_refstacktop - top);
+                if (c != NULL) {
+                    c = cdd_neg_cond(c, cdd_mask(tmp));
+                }
+            }
+            if (c == NULL) {
+                c = tmp;
+                break;
             }
             cdd_ref(c);
             cdd_deref(tmp);
@@ -1047,6 +2508,13 @@ ddNode* cdd_from_dbm(const raw_t* dbm, uint32_t dim)
         }
     }
 
+    /* Back off in case of error; the elements hold no references */
+    if (cdd_errorcond) {
+        cdd_refstacktop = top;
+        cdd_deref(c);
+        return NULL;
+    }
+
     cdd_deref(c);
     return c;
 }
@@ -1059,6 +2527,7 @@ ddNode* cdd_from_dbm(const raw_t* dbm, int32_t size)
     int32_t lo, hi;
     Elem* top;
     ddNode* c;
+    ddNode* tmp;
     LevelInfo* info;
 
     /* Create CDD
@@ -1069,6 +2538,7 @@ ddNode* cdd_from_dbm(const raw_t* dbm, int32_t size)
      * lower bound on the node.
      */
     c = cddtrue;
+    top = cdd_refstacktop;
     for (k = cdd_levelcnt - 1; k >= 0; k--) {
         info = cdd_levelinfo + k;
         if (info->type != TYPE_CDD) {
@@ -1099,17 +2569,33 @@ ddNode* cdd_from_dbm(const raw_t* dbm, int32_t size)
                 } else {
                     cdd_push(c, INF);
                 }
+                if (cdd_errorcond) {
+                    break;
+                }
 
                 c = cdd_make_cdd_node(k, top, cdd_refstacktop - top);
             } else {
                 cdd_push(cdd_rglr(c), dbm[i * size + j]);
                 cdd_push(cdd_neg_cond(cddfalse, cdd_mask(c)), INF);
-                c = cdd_neg_cond(cdd_make_cdd_node(k, top, cdd_refstacktop - top), cdd_mask(c));
+                if (cdd_errorcond) {
+                    break;
+                }
+                tmp = cdd_make_cdd_node(k, top, cdd_refstacktop - top);
+                c = tmp == NULL ? NULL : cdd_neg_cond(tmp, cdd_mask(c));
             }
             cdd_refstacktop = top;
+            if (c == NULL) {
+                return NULL;
+            }
         }
     }
 
+    /* Back off in case of error */
+    if (cdd_errorcond) {
+        cdd_refstacktop = top;
+        return NULL;
+    }
+
     return c;
 }
 #endif
@@ -1204,6 +2690,154 @@ ddNode* cdd_extract_bdd(ddNode* cdd, uint32_t dim)
     return cddtrue;
 }
 
+/* A CDD node on the path of a cdd_dbm_iterator */
+typedef struct
+{
+    cdd_iterator it; /* The child of the node on the path */
+    LevelInfo* info; /* The level of the node */
+    raw_t upper;     /* Upper bound of the DBM on the difference of the level */
+} CddDbmFrame;
+
+struct cdd_dbm_iterator_
+{
+    uint32_t dim;        /* Dimension of the DBMs */
+    int32_t depth;       /* Number of CDD nodes on the path, or -1 at the end */
+    int32_t started;     /* Whether a path has been yielded */
+    ddNode** path;       /* Nodes on the path, each referenced, ending in its BDD part */
+    CddDbmFrame* frames; /* State of the CDD nodes on the path */
+    raw_t* dbms;         /* DBM of each prefix of the path, closed */
+};
+
+/* Positions frame \a k of \a iter at the first child from its current
+ * one which is not false and whose interval is consistent with the
+ * DBM of the path above it. The DBM of the path including the child
+ * is then stored after that DBM. Returns 0 if there is none. */
+static int32_t cdd_dbm_iterator_find(cdd_dbm_iterator* iter, int32_t k)
+{
+    CddDbmFrame* f = iter->frames + k;
+    uint32_t dim = iter->dim;
+    raw_t* src = iter->dbms + k * dim * dim;
+    raw_t* dst = src + dim * dim;
+
+    for (; cdd_it_lower(f->it) < f->upper; cdd_it_next(f->it)) {
+        if (!IS_FALSE(cdd_it_child(f->it))) {
+            dbm_copy(dst, src, dim);
+            if (cdd_constrain2(dst, dim, f->info->clock1, f->info->clock2, cdd_it_lower(f->it),
+                               cdd_it_upper(f->it))) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+cdd_dbm_iterator* cdd_dbm_iterator_create(ddNode* cdd, uint32_t dim)
+{
+    cdd_dbm_iterator* iter;
+    int32_t maxdepth = cdd_levelcnt - cdd_varnum; /* Number of CDD levels */
+
+    iter = (cdd_dbm_iterator*)calloc(1, sizeof(cdd_dbm_iterator));
+    if (iter == NULL) {
+        cdd_error(CDD_MEMORY);
+        return NULL;
+    }
+    iter->path = (ddNode**)malloc((maxdepth + 1) * sizeof(ddNode*));
+    iter->frames = (CddDbmFrame*)malloc((maxdepth + 1) * sizeof(CddDbmFrame));
+    iter->dbms = (raw_t*)malloc((maxdepth + 1) * dim * dim * sizeof(raw_t));
+    if (iter->path == NULL || iter->frames == NULL || iter->dbms == NULL) {
+        free(iter->path);
+        free(iter->frames);
+        free(iter->dbms);
+        free(iter);
+        cdd_error(CDD_MEMORY);
+        return NULL;
+    }
+    iter->dim = dim;
+    iter->path[0] = cdd;
+    cdd_ref(cdd);
+    dbm_init(iter->dbms, dim);
+    return iter;
+}
+
+int32_t cdd_dbm_iterator_next(cdd_dbm_iterator* iter, raw_t* dbm, ddNode** bdd_part)
+{
+    uint32_t dim = iter->dim;
+    int32_t d = iter->depth;
+    CddDbmFrame* f;
+    ddNode* node;
+    raw_t* d0;
+
+    if (d < 0) {
+        return 0;
+    }
+
+    /* Nodes are referenced while on the path, which pins them during
+     * a compaction triggered between two calls. */
+    if (iter->started) {
+        goto backtrack;
+    }
+    iter->started = 1;
+
+    for (;;) {
+        /* Descend along the first consistent children */
+        node = iter->path[d];
+        while (!cdd_isterminal(node) && cdd_info(node)->type == TYPE_CDD) {
+            f = iter->frames + d;
+            f->info = cdd_info(node);
+            assert(f->info->clock1 < dim);
+            assert(f->info->clock2 < dim);
+            d0 = iter->dbms + d * dim * dim;
+            f->upper = d0[f->info->clock1 * dim + f->info->clock2];
+            cdd_it_seek(&f->it, node, bnd_u2l(d0[f->info->clock2 * dim + f->info->clock1]) + 1);
+            if (!cdd_dbm_iterator_find(iter, d)) {
+                goto backtrack;
+            }
+            node = iter->path[++d] = cdd_it_child(f->it);
+            cdd_ref(node);
+        }
+        if (!IS_FALSE(node)) {
+            iter->depth = d;
+            dbm_copy(dbm, iter->dbms + d * dim * dim, dim);
+            *bdd_part = node;
+            return 1;
+        }
+
+    backtrack:
+        /* Move to the next consistent child of the deepest node that has one */
+        for (;;) {
+            if (d == 0) {
+                iter->depth = -1;
+                return 0;
+            }
+            cdd_deref(iter->path[d]);
+            f = iter->frames + --d;
+            cdd_it_next(f->it);
+            if (cdd_dbm_iterator_find(iter, d)) {
+                iter->path[++d] = cdd_it_child(f->it);
+                cdd_ref(iter->path[d]);
+                break;
+            }
+        }
+    }
+}
+
+void cdd_dbm_iterator_destroy(cdd_dbm_iterator* iter)
+{
+    int32_t d;
+
+    if (iter == NULL) {
+        return;
+    }
+    for (d = iter->depth; d > 0; d--) {
+        cdd_deref(iter->path[d]);
+    }
+    cdd_rec_deref(iter->path[0]);
+    free(iter->path);
+    free(iter->frames);
+    free(iter->dbms);
+    free(iter);
+}
+
 void cdd_mark_clock(int32_t* vec, int32_t c)
 {
     int32_t n;
@@ -1243,22 +2877,135 @@ static ddNode* add_bound(ddNode* c, int32_t level, raw_t low, raw_t up)
     return tmp2;
 }
 
-int32_t cdd_equiv(ddNode* c, ddNode* d)
+/* Predicates of cdd_test_rec(), packed into the keys of the test cache */
+#define TEST_EQUIV  0 /* The operands reach the same terminal */
+#define TEST_SUBSET 1 /* The right operand is true where the left one is */
+
+/* Returns 1 if predicate \a op holds for \a l and \a r on all paths
+ * consistent with \a graph, which must be consistent. The product of
+ * the two diagrams is walked like by cdd_apply_reduce(), but no nodes
+ * are made and the walk stops at the first path violating \a op.
+ * Every node has a consistent path, as the children of a CDD node
+ * cover all values. Results are cached only if \a unconstrained is
+ * true, i.e. if the graph has no edges. */
+static int32_t cdd_test_rec(ddNode* l, ddNode* r, int32_t op, struct tarjan* graph, int32_t unconstrained)
 {
-    ddNode* tmp1;
-    ddNode* tmp2;
+    CddCacheData* entry;
+    cdd_iterator li, ri;
+    cdd_handle_t lc, rc;
+    LevelInfo* info;
+    ddNode* n;
+    int32_t level;
+    int32_t res;
+    raw_t lower;
+    raw_t bnd;
 
-    tmp1 = cdd_xor(c, d);
-    cdd_ref(tmp1);
+    /* Termination conditions */
+    if (l == r) {
+        return 1;
+    }
+    switch (op) {
+    case TEST_EQUIV:
+        if (l == cdd_neg(r) || (cdd_isterminal(l) && cdd_isterminal(r))) {
+            return 0;
+        }
 
-    tmp2 = cdd_reduce(tmp1);
-    cdd_ref(tmp2);
+        /* The predicate is symmetric; normalise for better cache performance */
+        if (l > r) {
+            n = l;
+            l = r;
+            r = n;
+        }
+        break;
+    case TEST_SUBSET:
+        if (IS_FALSE(l) || IS_TRUE(r)) {
+            return 1;
+        }
+        if (cdd_isterminal(l) && cdd_isterminal(r)) {
+            return 0;
+        }
+        break;
+    }
 
-    cdd_rec_deref(tmp1);
-    cdd_rec_deref(tmp2);
-    return tmp2 == cddfalse;
+    if (unconstrained) {
+        entry = CddCache_lookup(&testcache, APPLYHASH(l, r, op), l, CddCache_key(r, op));
+        if (entry != NULL) {
+            return entry->res == cddtrue;
+        }
+    }
+
+    level = minimum(cdd_rglr(l)->level, cdd_rglr(r)->level);
+    info = cdd_levelinfo + level;
+    res = 1;
+    switch (info->type) {
+    case TYPE_CDD:
+        cdd_it_operand(&li, l, level, &lc);
+        cdd_it_operand(&ri, r, level, &rc);
+
+        /* Walk the intervals of the common refinement of the two
+         * nodes. Once a lower bound is inconsistent, so are the
+         * remaining intervals.
+         */
+        for (lower = -INF; res && lower < INF; lower = bnd) {
+            bnd = minimum(cdd_it_upper(li), cdd_it_upper(ri));
+            if (lower > -INF) {
+                cdd_tarjan_push(graph, info->clock2, info->clock1, bnd_l2u(lower));
+                if (!cdd_tarjan_consistent(graph)) {
+                    cdd_tarjan_pop(graph, info->clock2);
+                    break;
+                }
+            }
+            if (bnd < INF) {
+                cdd_tarjan_push(graph, info->clock1, info->clock2, bnd);
+                if (cdd_tarjan_consistent(graph)) {
+                    res = cdd_test_rec(cdd_it_child(li), cdd_it_child(ri), op, graph, 0);
+                }
+                cdd_tarjan_pop(graph, info->clock1);
+            } else {
+                res = cdd_test_rec(cdd_it_child(li), cdd_it_child(ri), op, graph, 0);
+            }
+            if (lower > -INF) {
+                cdd_tarjan_pop(graph, info->clock2);
+            }
+            cdd_it_step(li, bnd);
+            cdd_it_step(ri, bnd);
+        }
+        break;
+    case TYPE_BDD:
+        res = cdd_test_rec(cdd_rglr(l)->level == level ? bdd_low(l) : l,
+                           cdd_rglr(r)->level == level ? bdd_low(r) : r, op, graph, unconstrained) &&
+              cdd_test_rec(cdd_rglr(l)->level == level ? bdd_high(l) : l,
+                           cdd_rglr(r)->level == level ? bdd_high(r) : r, op, graph, unconstrained);
+        break;
+    }
+
+    if (unconstrained) {
+        entry = cdd_cache_store(&testcache, APPLYHASH(l, r, op), l, CddCache_key(r, op));
+        entry->res = res ? cddtrue : cddfalse;
+    }
+    return res;
+}
+
+/* Tests predicate \a op for \a l and \a r on all consistent paths */
+static int32_t cdd_test(ddNode* l, ddNode* r, int32_t op)
+{
+    struct tarjan graph;
+    struct distance dist[cdd_clocknum];
+    uint32_t count[cdd_clocknum];
+    struct edge edges[cdd_clocknum * cdd_clocknum - cdd_clocknum];
+    struct node fifo[cdd_clocknum + 1];
+    uint32_t queued[bits2intsize(cdd_clocknum)];
+
+    cdd_tarjan_init(&graph, cdd_clocknum, dist, count, edges, fifo, queued);
+    return cdd_test_rec(l, r, op, &graph, 1);
 }
 
+int32_t cdd_equiv(ddNode* c, ddNode* d) { return cdd_test(c, d, TEST_EQUIV); }
+
+int32_t cdd_is_empty(ddNode* c) { return cdd_test(c, cddfalse, TEST_EQUIV); }
+
+int32_t cdd_subset(ddNode* c, ddNode* d) { return cdd_test(c, d, TEST_SUBSET); }
+
 static ddNode* cdd_reduce2_rec(ddNode* node)
 {
     ddNode* res = cddfalse;
@@ -1372,8 +3119,15 @@ ddNode* cdd_reduce2(ddNode* node) { return cdd_reduce2_rec(node); }
 
 ///////////////////////////////////////////////////////////////////////////
 
-static ddNode* cdd_tarjan_reduce_rec(ddNode* node, struct tarjan* graph)
+/* Reduces \a node under the constraints in \a graph. Reduction is
+ * idempotent, and it only depends on the node if \a unconstrained is true,
+ * i.e. if the graph has no edges. In that case the result is looked
+ * up in and stored in the apply cache, both for \a node and for the
+ * result itself, such that reducing a reduced CDD again is answered
+ * right away until the next garbage collection. */
+static ddNode* cdd_tarjan_reduce_rec(ddNode* node, struct tarjan* graph, int32_t unconstrained)
 {
+    CddCacheData* entry;
     raw_t bnd;
     int32_t mask;
     int32_t modified;
@@ -1383,17 +3137,36 @@ static ddNode* cdd_tarjan_reduce_rec(ddNode* node, struct tarjan* graph)
     ddNode* n;
     LevelInfo* info;
 
+    /* Back off in case of error */
+    if (cdd_errorcond) {
+        return 0;
+    }
+
     /* Termination conditions */
     if (cdd_isterminal(node))
         return node;
 
+    if (unconstrained) {
+        entry = CddCache_lookup(&applycache, REDUCEHASH(node), node, REDUCEKEY);
+        if (entry != NULL) {
+            if (cdd_rglr(entry->res)->ref == 0) {
+                CddCache_count(&applycache, reclaims);
+                cdd_reclaim(entry->res);
+            }
+            return entry->res;
+        }
+    }
+
     info = cdd_info(node);
     switch (info->type) {
     case TYPE_BDD:
-        n = cdd_tarjan_reduce_rec(cdd_neg_cond(bdd_node(node)->low, cdd_mask(node)), graph);
+        n = cdd_tarjan_reduce_rec(bdd_low(node), graph, unconstrained);
+        if (n == NULL) {
+            return 0;
+        }
         cdd_ref(n);
-        m = cdd_make_bdd_node(cdd_rglr(node)->level, n,
-                              cdd_tarjan_reduce_rec(cdd_neg_cond(bdd_node(node)->high, cdd_mask(node)), graph));
+        m = cdd_tarjan_reduce_rec(bdd_high(node), graph, unconstrained);
+        m = m == NULL ? NULL : cdd_make_bdd_node(cdd_rglr(node)->level, n, m);
         cdd_deref(n);
         break;
 
@@ -1404,7 +3177,8 @@ static ddNode* cdd_tarjan_reduce_rec(ddNode* node, struct tarjan* graph)
          */
         modified = 0;
         cdd_it_init(it, node);
-        cdd_tarjan_push(graph, info->clock1, info->clock2, cdd_it_upper(it));
+        bnd = cdd_it_upper(it);
+        cdd_tarjan_push(graph, info->clock1, info->clock2, bnd);
         while (!cdd_tarjan_consistent(graph)) {
             modified = 1;
             cdd_tarjan_pop(graph, info->clock1);
@@ -1416,17 +3190,24 @@ static ddNode* cdd_tarjan_reduce_rec(ddNode* node, struct tarjan* graph)
                  * has no effect at all. Reduce the last child and
                  * return it directly.
                  */
-                return cdd_tarjan_reduce_rec(cdd_it_child(it), graph);
+                m = cdd_tarjan_reduce_rec(cdd_it_child(it), graph, unconstrained);
+                break;
             }
             cdd_tarjan_push(graph, info->clock1, info->clock2, bnd);
         }
+        if (bnd == dbm_LS_INFINITY) {
+            break;
+        }
 
         /* Do recursion for the first consistent child we found above.
          */
-        m = cdd_tarjan_reduce_rec(cdd_it_child(it), graph);
+        m = cdd_tarjan_reduce_rec(cdd_it_child(it), graph, 0);
+        cdd_tarjan_pop(graph, info->clock1);
+        if (m == NULL) {
+            return 0;
+        }
         mask = cdd_mask(m);
         cdd_ref(m);
-        cdd_tarjan_pop(graph, info->clock1);
         modified |= (m != cdd_it_child(it));
 
         /* Repeat until next inconsistent bound or the last bound.
@@ -1443,25 +3224,44 @@ static ddNode* cdd_tarjan_reduce_rec(ddNode* node, struct tarjan* graph)
             bnd = cdd_it_upper(it);
             if (bnd < dbm_LS_INFINITY) {
                 cdd_tarjan_push(graph, info->clock1, info->clock2, bnd);
-                n = cdd_tarjan_reduce_rec(cdd_it_child(it), graph);
+                n = cdd_tarjan_reduce_rec(cdd_it_child(it), graph, 0);
                 cdd_tarjan_pop(graph, info->clock1);
             } else {
-                n = cdd_tarjan_reduce_rec(cdd_it_child(it), graph);
+                n = cdd_tarjan_reduce_rec(cdd_it_child(it), graph, 0);
+            }
+
+            cdd_tarjan_pop(graph, info->clock2);
+            if (n == NULL) {
+                break;
             }
 
             modified |= (n != cdd_it_child(it));
             if (m != n) {
                 cdd_push(cdd_neg_cond(m, mask), cdd_it_lower(it));
+                if (cdd_errorcond) {
+                    break;
+                }
                 m = n;
                 cdd_ref(m);
             }
-            cdd_tarjan_pop(graph, info->clock2);
         }
-        cdd_push(cdd_neg_cond(m, mask), INF);
+        if (!cdd_errorcond) {
+            cdd_push(cdd_neg_cond(m, mask), INF);
+        }
+
+        /* Back off in case of error; m is not on the stack */
+        if (cdd_errorcond) {
+            cdd_deref(m);
+            cdd_unwind(top, top);
+            return 0;
+        }
 
         /* Create node */
         if (modified) {
-            m = cdd_neg_cond(cdd_make_cdd_node(cdd_rglr(node)->level, top, cdd_refstacktop - top), mask);
+            m = cdd_make_cdd_node(cdd_rglr(node)->level, top, cdd_refstacktop - top);
+            if (m != NULL) {
+                m = cdd_neg_cond(m, mask);
+            }
         } else {
             m = node;
         }
@@ -1469,11 +3269,20 @@ static ddNode* cdd_tarjan_reduce_rec(ddNode* node, struct tarjan* graph)
         /* Remove references */
         while (cdd_refstacktop > top) {
             cdd_refstacktop--;
-            cdd_deref(cdd_refstacktop->child);
+            cdd_deref(cdd_ptr(cdd_refstacktop->child));
         }
         break;
     default: m = NULL;
     }
+
+    if (unconstrained && m != NULL) {
+        entry = cdd_cache_store(&applycache, REDUCEHASH(node), node, REDUCEKEY);
+        entry->res = m;
+        if (m != node && !cdd_isterminal(m)) {
+            entry = cdd_cache_store(&applycache, REDUCEHASH(m), m, REDUCEKEY);
+            entry->res = m;
+        }
+    }
     return m;
 }
 
@@ -1487,7 +3296,7 @@ ddNode* cdd_reduce(ddNode* node)
     uint32_t queued[bits2intsize(cdd_clocknum)];
 
     cdd_tarjan_init(&graph, cdd_clocknum, dist, count, edges, fifo, queued);
-    return cdd_tarjan_reduce_rec(node, &graph);
+    return cdd_tarjan_reduce_rec(node, &graph, 1);
 }
 
 ///////////////////////////////////////////////////////////////////////////
@@ -1500,10 +3309,9 @@ static ddNode* cdd_apply_reduce_rec(ddNode* l, ddNode* r, struct tarjan* graph)
     int32_t lmask;
     int32_t rmask;
     int32_t mask;
-    Elem* top;
-    Elem* lp;
-    Elem* rp;
     Elem* first;
+    cdd_iterator li, ri;
+    cdd_handle_t lc, rc;
     ddNode* ll;
     ddNode* lh;
     ddNode* rl;
@@ -1526,20 +3334,20 @@ static ddNode* cdd_apply_reduce_rec(ddNode* l, ddNode* r, struct tarjan* graph)
     switch (applyop) {
     case cddop_and:
         if (l == r || r == cddtrue) {
-            return cdd_tarjan_reduce_rec(l, graph);
+            return cdd_tarjan_reduce_rec(l, graph, 0);
         }
         if (l == cddfalse || r == cddfalse || l == cdd_neg(r)) {
             return cddfalse;
         }
         if (l == cddtrue) {
-            return cdd_tarjan_reduce_rec(r, graph);
+            return cdd_tarjan_reduce_rec(r, graph, 0);
         }
 #ifdef MULTI_TERMINAL
         if (cdd_is_extra_terminal(l)) {
-            return cdd_mask(l) ? l : cdd_tarjan_reduce_rec(r, graph);
+            return cdd_mask(l) ? l : cdd_tarjan_reduce_rec(r, graph, 0);
         }
         if (cdd_is_extra_terminal(r)) {
-            return cdd_mask(r) ? r : cdd_tarjan_reduce_rec(l, graph);
+            return cdd_mask(r) ? r : cdd_tarjan_reduce_rec(l, graph, 0);
         }
 #endif
         break;
@@ -1551,24 +3359,24 @@ static ddNode* cdd_apply_reduce_rec(ddNode* l, ddNode* r, struct tarjan* graph)
             return cddtrue;
         }
         if (l == cddfalse) {
-            return cdd_tarjan_reduce_rec(r, graph);
+            return cdd_tarjan_reduce_rec(r, graph, 0);
         }
         if (r == cddfalse) {
-            return cdd_tarjan_reduce_rec(l, graph);
+            return cdd_tarjan_reduce_rec(l, graph, 0);
         }
         if (l == cddtrue) {
-            return cdd_tarjan_reduce_rec(cdd_neg(r), graph);
+            return cdd_tarjan_reduce_rec(cdd_neg(r), graph, 0);
         }
         if (r == cddtrue) {
-            return cdd_tarjan_reduce_rec(cdd_neg(l), graph);
+            return cdd_tarjan_reduce_rec(cdd_neg(l), graph, 0);
         }
         break;
 #ifdef MULTI_TERMINAL
         if (cdd_is_extra_terminal(l)) {
-            return cdd_mask(l) ? cdd_tarjan_reduce_rec(r, graph) : cdd_tarjan_reduce_rec(cdd_neg(r), graph);
+            return cdd_mask(l) ? cdd_tarjan_reduce_rec(r, graph, 0) : cdd_tarjan_reduce_rec(cdd_neg(r), graph, 0);
         }
         if (cdd_is_extra_terminal(r)) {
-            return cdd_mask(r) ? cdd_tarjan_reduce_rec(l, graph) : cdd_tarjan_reduce_rec(cdd_neg(l), graph);
+            return cdd_mask(r) ? cdd_tarjan_reduce_rec(l, graph, 0) : cdd_tarjan_reduce_rec(cdd_neg(l), graph, 0);
         }
 #endif
     }
@@ -1583,14 +3391,16 @@ static ddNode* cdd_apply_reduce_rec(ddNode* l, ddNode* r, struct tarjan* graph)
 
     /* Do cache lookup.
      */
-    entry = CddCache_lookup(&applycache, APPLYHASH(l, r, applyop));
-    if (entry->a == l && entry->b == r && entry->c == applyop) {
+    entry = CddCache_lookup(&applycache, APPLYHASH(l, r, applyop), l, CddCache_key(r, applyop));
+    if (entry != NULL) {
         if (cdd_rglr(entry->res)->ref == 0) {
+            CddCache_count(&applycache, reclaims);
             cdd_reclaim(entry->res);
         }
-        cdd_ref(entry->res);
-        res = cdd_tarjan_reduce_rec(entry->res, graph);
-        cdd_rec_deref(entry->res);
+        n = entry->res;
+        cdd_ref(n);
+        res = cdd_tarjan_reduce_rec(n, graph, 0);
+        cdd_rec_deref(n);
         return res;
     }
 
@@ -1605,22 +3415,10 @@ static ddNode* cdd_apply_reduce_rec(ddNode* l, ddNode* r, struct tarjan* graph)
     switch (info->type) {
     case TYPE_CDD:
         /* Prepare for recursion: In case the two nodes do not have
-         * the same level we create a fake intermediate node.
+         * the same level we iterate a fake intermediate node.
          */
-        top = cdd_refstacktop;
-        if (l->level <= r->level) {
-            lp = cdd_node(l)->elem;
-        } else {
-            lp = cdd_refstacktop;
-            cdd_push(l, INF);
-        }
-
-        if (l->level >= r->level) {
-            rp = cdd_node(r)->elem;
-        } else {
-            rp = cdd_refstacktop;
-            cdd_push(r, INF);
-        }
+        cdd_it_operand(&li, cdd_neg_cond(l, lmask), minimum(l->level, r->level), &lc);
+        cdd_it_operand(&ri, cdd_neg_cond(r, rmask), minimum(l->level, r->level), &rc);
 
         /*
          * Do recursion
@@ -1632,26 +3430,28 @@ static ddNode* cdd_apply_reduce_rec(ddNode* l, ddNode* r, struct tarjan* graph)
          * upper bound since we know that all children to the left of
          * the current child are on inconsistent paths.
          */
-        bnd = minimum(lp->bnd, rp->bnd);
+        bnd = minimum(cdd_it_upper(li), cdd_it_upper(ri));
         cdd_tarjan_push(graph, info->clock1, info->clock2, bnd);
         while (!cdd_tarjan_consistent(graph)) {
             cdd_tarjan_pop(graph, info->clock1);
-            lp += (lp->bnd == bnd);
-            rp += (rp->bnd == bnd);
-            bnd = minimum(lp->bnd, rp->bnd);
+            cdd_it_step(li, bnd);
+            cdd_it_step(ri, bnd);
+            bnd = minimum(cdd_it_upper(li), cdd_it_upper(ri));
             if (bnd == dbm_LS_INFINITY) {
-                cdd_refstacktop = top;
-                return cdd_apply_reduce_rec(cdd_neg_cond(lp->child, lmask), cdd_neg_cond(rp->child, rmask), graph);
+                return cdd_apply_reduce_rec(cdd_it_child(li), cdd_it_child(ri), graph);
             }
             cdd_tarjan_push(graph, info->clock1, info->clock2, bnd);
         }
 
         /* Do first recursion - check whether first edge is negated.
          */
-        prev = cdd_apply_reduce_rec(cdd_neg_cond(lp->child, lmask), cdd_neg_cond(rp->child, rmask), graph);
+        prev = cdd_apply_reduce_rec(cdd_it_child(li), cdd_it_child(ri), graph);
+        cdd_tarjan_pop(graph, info->clock1);
+        if (prev == NULL) {
+            return 0;
+        }
         cdd_ref(prev);
         mask = cdd_mask(prev);
-        cdd_tarjan_pop(graph, info->clock1);
 
         /* Perform intermediate recursions: For each we need to apply
          * both the lower and upper bound. We are done when either we
@@ -1659,27 +3459,29 @@ static ddNode* cdd_apply_reduce_rec(ddNode* l, ddNode* r, struct tarjan* graph)
          * inconsistent (in which case all reamining children are
          * inconsistent as well).
          */
-        lp += (lp->bnd == bnd);
-        rp += (rp->bnd == bnd);
+        cdd_it_step(li, bnd);
+        cdd_it_step(ri, bnd);
         lower = bnd;
-        bnd = minimum(lp->bnd, rp->bnd);
+        bnd = minimum(cdd_it_upper(li), cdd_it_upper(ri));
         cdd_tarjan_push(graph, info->clock2, info->clock1, bnd_l2u(lower));
-        while (bnd < INF && cdd_tarjan_consistent(graph)) {
+        while (bnd < INF && cdd_tarjan_consistent(graph) && !cdd_errorcond) {
             cdd_tarjan_push(graph, info->clock1, info->clock2, bnd);
-            n = cdd_apply_reduce_rec(cdd_neg_cond(lp->child, lmask), cdd_neg_cond(rp->child, rmask), graph);
+            n = cdd_apply_reduce_rec(cdd_it_child(li), cdd_it_child(ri), graph);
             cdd_tarjan_pop(graph, info->clock1);
             cdd_tarjan_pop(graph, info->clock2);
 
-            if (n != prev) {
+            if (!cdd_errorcond && n != prev) {
                 cdd_push(cdd_neg_cond(prev, mask), lower);
-                prev = n;
-                cdd_ref(prev);
+                if (!cdd_errorcond) {
+                    prev = n;
+                    cdd_ref(prev);
+                }
             }
 
-            lp += (lp->bnd == bnd);
-            rp += (rp->bnd == bnd);
+            cdd_it_step(li, bnd);
+            cdd_it_step(ri, bnd);
             lower = bnd;
-            bnd = minimum(lp->bnd, rp->bnd);
+            bnd = minimum(cdd_it_upper(li), cdd_it_upper(ri));
 
             cdd_tarjan_push(graph, info->clock2, info->clock1, bnd_l2u(lower));
         }
@@ -1687,54 +3489,68 @@ static ddNode* cdd_apply_reduce_rec(ddNode* l, ddNode* r, struct tarjan* graph)
         /* We still need to do the recursion for the last child, but
          * only if the path is consistent.
          */
-        if (bnd == INF && cdd_tarjan_consistent(graph)) {
-            n = cdd_apply_reduce_rec(cdd_neg_cond(lp->child, lmask), cdd_neg_cond(rp->child, rmask), graph);
-            if (n != prev) {
+        if (bnd == INF && cdd_tarjan_consistent(graph) && !cdd_errorcond) {
+            n = cdd_apply_reduce_rec(cdd_it_child(li), cdd_it_child(ri), graph);
+            if (!cdd_errorcond && n != prev) {
                 cdd_push(cdd_neg_cond(prev, mask), lower);
-                prev = n;
-                cdd_ref(prev);
+                if (!cdd_errorcond) {
+                    prev = n;
+                    cdd_ref(prev);
+                }
             }
         }
 
         /* Push the final new child to the stack.
          */
         cdd_tarjan_pop(graph, info->clock2);
-        cdd_push(cdd_neg_cond(prev, mask), INF);
+        if (!cdd_errorcond) {
+            cdd_push(cdd_neg_cond(prev, mask), INF);
+        }
+
+        /* Back off in case of error; prev is not on the stack.
+         */
+        if (cdd_errorcond) {
+            cdd_deref(prev);
+            cdd_unwind(first, first);
+            return 0;
+        }
 
         /* Create node.
          */
-        res = cdd_neg_cond(cdd_make_cdd_node(minimum(l->level, r->level), first, cdd_refstacktop - first), mask);
+        res = cdd_make_cdd_node(minimum(l->level, r->level), first, cdd_refstacktop - first);
+        if (res != NULL) {
+            res = cdd_neg_cond(res, mask);
+        }
 
         /* Remove references.
          */
         do {
             cdd_refstacktop--;
-            cdd_deref(cdd_refstacktop->child);
+            cdd_deref(cdd_ptr(cdd_refstacktop->child));
         } while (cdd_refstacktop > first);
-
-        /* Restore stacktop.
-         */
-        cdd_refstacktop = top;
         break;
     case TYPE_BDD:
         if (l->level <= r->level) {
-            ll = bdd_node(l)->low;
-            lh = bdd_node(l)->high;
+            ll = cdd_ptr(bdd_node(l)->low);
+            lh = cdd_ptr(bdd_node(l)->high);
         } else {
             ll = lh = l;
         }
 
         if (l->level >= r->level) {
-            rl = bdd_node(r)->low;
-            rh = bdd_node(r)->high;
+            rl = cdd_ptr(bdd_node(r)->low);
+            rh = cdd_ptr(bdd_node(r)->high);
         } else {
             rl = rh = r;
         }
 
         n = cdd_apply_reduce_rec(cdd_neg_cond(ll, lmask), cdd_neg_cond(rl, rmask), graph);
+        if (n == NULL) {
+            return 0;
+        }
         cdd_ref(n);
-        res = cdd_make_bdd_node(minimum(l->level, r->level), n,
-                                cdd_apply_reduce_rec(cdd_neg_cond(lh, lmask), cdd_neg_cond(rh, rmask), graph));
+        prev = cdd_apply_reduce_rec(cdd_neg_cond(lh, lmask), cdd_neg_cond(rh, rmask), graph);
+        res = prev == NULL ? NULL : cdd_make_bdd_node(minimum(l->level, r->level), n, prev);
         cdd_deref(n);
     }
 
@@ -1 +1,4 @@
 #cmakedefine MULTI_TERMINAL @MULTI_TERMINAL@
+#cmakedefine CDD_CONCURRENT @CDD_CONCURRENT@
+#cmakedefine CDD_COMPRESSED @CDD_COMPRESSED@
+#cmakedefine CDD_CACHESTATS @CDD_CACHESTATS@
@@ -14,34 +14,76 @@
 #include <dbm/fed.h>
 #include <dbm/print.h>
 
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #define ADBM(NAME, DIM) raw_t* NAME = allocDBM(DIM)
 
 /* Allocate a DBM. */
 static raw_t* allocDBM(uint32_t dim) { return (raw_t*)malloc(dim * dim * sizeof(raw_t)); }
 
+/* Start a walk over the zones of a CDD. Throws std::bad_alloc if the iterator cannot be allocated. */
+static cdd_dbm_iterator* createIterator(const cdd& state)
+{
+    cdd_dbm_iterator* it = cdd_dbm_iterator_create(state.handle(), cdd_clocknum);
+    if (it == nullptr) {
+        throw std::bad_alloc();
+    }
+    return it;
+}
+
+/* Throws the error for which an operation returned \a r if it is NULL, clearing the error condition. */
+static void checkResult(ddNode* r)
+{
+    int32_t err;
+
+    if (cdd_rglr(r) != nullptr) {
+        return;
+    }
+    err = cdd_get_error();
+    cdd_clear_error();
+    if (err == CDD_MEMORY) {
+        throw std::bad_alloc();
+    }
+    throw std::runtime_error("CDD error " + std::to_string(err));
+}
+
 cdd::cdd(const cdd& r)
 {
     assert(cdd_isrunning());
     root = r.root;
     if (root)
         cdd_ref(root);
+    cdd_register_root(&root);
 }
 
 cdd::cdd(const raw_t* dbm, uint32_t dim)
 {
     assert(cdd_isrunning());
     root = cdd_from_dbm(dbm, dim);
+    checkResult(root);
     cdd_ref(root);
+    cdd_register_root(&root);
 }
 
 cdd::cdd(ddNode* r)
 {
-    assert(cdd_isrunning() && r);
+    assert(cdd_isrunning());
+    checkResult(r);
     root = r;
     cdd_ref(r);
+    cdd_register_root(&root);
 }
 
-cdd::~cdd() { cdd_rec_deref(root); }
+cdd::~cdd()
+{
+    cdd_unregister_root(&root);
+    cdd_rec_deref(root);
+}
 
 cdd& cdd::operator=(const cdd& r)
 {
@@ -55,6 +97,7 @@ cdd& cdd::operator=(const cdd& r)
 
 cdd cdd::operator=(ddNode* node)
 {
+    checkResult(node);
     if (root != node) {
         cdd_rec_deref(root);
         root = node;
@@ -82,13 +125,36 @@ extraction_result cdd_extract_bdd_and_dbm(const cdd& state)
     return res;
 }
 
+/**
+ * Applies \a op to the zone of every path of \a state, as yielded by a
+ * \c cdd_dbm_iterator, and joins the results with their BDD parts.
+ * @param state a cdd
+ * @param op a function modifying a DBM of dimension \c cdd_clocknum
+ * @return the union of the modified zones
+ * @throws std::bad_alloc if the iterator cannot be allocated
+ */
+template <typename Op>
+static cdd cdd_map_zones(const cdd& state, Op op)
+{
+    cdd res = cdd_false();
+    cdd_dbm_iterator* it = createIterator(state);
+    ADBM(dbm, cdd_clocknum);
+    ddNode* bottom;
+    while (cdd_dbm_iterator_next(it, dbm, &bottom)) {
+        op(dbm);
+        res |= (cdd(dbm, cdd_clocknum) & cdd(bottom));
+    }
+    free(dbm);
+    cdd_dbm_iterator_destroy(it);
+    return res;
+}
+
 /**
  * Perform the delay operation on a CDD.
  *
- * <p>The delay is performed by extracting all DBMs (and their
- * corresponding BDD part), delaying the DBMs individually,
- * and then compose the delayed DBMs back together with their
- * BDD parts.</p>
+ * <p>The delay is performed on the non-negative part of the CDD
+ * by \c cdd_up(), which keeps the structure of the CDD rather
+ * than splitting it into DBMs.</p>
  *
  * @param cdd a CDD
  * @return the delayed CDD.
@@ -101,21 +167,7 @@ cdd cdd_delay(const cdd& state)
     if (cdd_info(state.handle())->type == TYPE_BDD)
         return state;
 
-    cdd copy = state;
-    cdd res = cdd_false();
-    ADBM(dbm, cdd_clocknum);
-    while (!cdd_isterminal(copy.handle()) && cdd_info(copy.handle())->type != TYPE_BDD) {
-        copy = cdd_reduce(copy);
-        cdd bottom = cdd_extract_bdd(copy, cdd_clocknum);
-        copy = cdd_extract_dbm(copy, dbm, cdd_clocknum);
-        copy = cdd_reduce(cdd_remove_negative(copy));
-        dbm_up(dbm, cdd_clocknum);
-        cdd fixed_cdd = cdd(dbm, cdd_clocknum);
-        fixed_cdd &= bottom;
-        res |= fixed_cdd;
-    }
-    free(dbm);
-    return res;
+    return cdd_up(cdd_remove_negative(state));
 }
 
 /**
@@ -133,6 +185,139 @@ cdd cdd_from_fed(const dbm::fed_t& fed)
     return res;
 }
 
+/**
+ * Convert a CDD into a federation, the inverse of \c cdd_from_fed().
+ *
+ * <p>The zones are collected in one walk over the CDD with a \c
+ * cdd_dbm_iterator. The BDD parts are ignored, so the result covers the
+ * clock valuations of all boolean valuations, and only non-negative
+ * clock values are covered.</p>
+ * @param state a cdd
+ * @return a federation of the clock valuations of \a state
+ */
+dbm::fed_t cdd_to_fed(const cdd& state)
+{
+    auto fed = dbm::fed_t{(uint32_t)cdd_clocknum};
+    cdd_dbm_iterator* it = createIterator(state);
+    ADBM(dbm, cdd_clocknum);
+    ddNode* bdd_part;
+    while (cdd_dbm_iterator_next(it, dbm, &bdd_part)) {
+        fed.add(dbm, cdd_clocknum);
+    }
+    cdd_dbm_iterator_destroy(it);
+    free(dbm);
+    return fed;
+}
+
+/** Federations of a CDD, each with the BDD part its zones are joined with. */
+using cdd_fed_parts = std::vector<std::pair<cdd, dbm::fed_t>>;
+
+/**
+ * Convert a CDD into federations, one per distinct BDD part.
+ *
+ * <p>The zones are collected in one walk over the CDD with a \c
+ * cdd_dbm_iterator, which shares the DBM of a path prefix between all
+ * paths below it, and grouped by the BDD part they are joined with.
+ * Only non-negative clock values are covered.</p>
+ * @param state a cdd
+ * @return pairs of a BDD part of \a state and the zones joined with it
+ */
+std::vector<std::pair<cdd, dbm::fed_t>> cdd_to_fed_partitioned(const cdd& state)
+{
+    cdd_fed_parts parts;
+    std::unordered_map<ddNode*, size_t> index;
+    cdd_dbm_iterator* it = createIterator(state);
+    ADBM(dbm, cdd_clocknum);
+    ddNode* bdd_part;
+    while (cdd_dbm_iterator_next(it, dbm, &bdd_part)) {
+        auto found = index.emplace(bdd_part, parts.size());
+        if (found.second) {
+            parts.emplace_back(cdd(bdd_part), dbm::fed_t{(uint32_t)cdd_clocknum});
+        }
+        parts[found.first->second].second.add(dbm, cdd_clocknum);
+    }
+    cdd_dbm_iterator_destroy(it);
+    free(dbm);
+    return parts;
+}
+
+/**
+ * Splits the boolean valuations in \a context by the BDD parts of \a bad
+ * and then of \a good, starting at the \a k-th of both lists, and adds the
+ * timed predecessor of the bad federation for each satisfiable combination
+ * to \a result.
+ *
+ * <p>Only the combinations that some valuation satisfies are visited, so
+ * the cost depends on the number of distinct boolean contexts rather than
+ * on the number of boolean variables.</p>
+ * @param context a BDD of boolean valuations
+ * @param bad the zones of the target, grouped by their BDD part
+ * @param good the zones of the safe part, grouped by their BDD part
+ * @param k the index of the next BDD part to split by
+ * @param bad_fed the zones of the target parts so far satisfied by \a context
+ * @param good_fed the zones of the safe parts so far satisfied by \a context
+ * @param result the cdd receiving the predecessors
+ */
+static void cdd_predt_split(const cdd& context, const cdd_fed_parts& bad, const cdd_fed_parts& good, size_t k,
+                            const dbm::fed_t& bad_fed, const dbm::fed_t& good_fed, cdd& result)
+{
+    if (context == cdd_false()) {
+        return;
+    }
+    if (k == bad.size() && bad_fed.isEmpty()) {
+        return;
+    }
+    if (k == bad.size() + good.size()) {
+        dbm::fed_t pred = bad_fed;
+        if (good_fed.isEmpty()) {
+            // For the boolean valuations we did not reach with our safe CDD, we take the past
+            // of the target.
+            result |= cdd_from_fed(pred.down()) & context;
+        } else {
+            result |= cdd_from_fed(pred.predt(good_fed)) & context;
+        }
+        return;
+    }
+    const auto& part = k < bad.size() ? bad[k] : good[k - bad.size()];
+    cdd_predt_split(context & !part.first, bad, good, k + 1, bad_fed, good_fed, result);
+
+    // Only the branch satisfying the part copies a federation to extend it
+    cdd inside = context & part.first;
+    if (inside == cdd_false()) {
+        return;
+    }
+    if (k < bad.size()) {
+        dbm::fed_t extended = bad_fed;
+        extended.add(part.second);
+        cdd_predt_split(inside, bad, good, k + 1, extended, good_fed, result);
+    } else {
+        dbm::fed_t extended = good_fed;
+        extended.add(part.second);
+        cdd_predt_split(inside, bad, good, k + 1, bad_fed, extended, result);
+    }
+}
+
+/**
+ * Computes the timed predecessor of federations per boolean context.
+ * @param bad the zones of the target, grouped by their BDD part
+ * @param safe the safe cdd
+ * @return a cdd containing states that can delay into \a bad without reaching \a safe.
+ */
+static cdd cdd_predt_parts(const cdd_fed_parts& bad, const cdd& safe)
+{
+    // Only the part of safe sharing boolean valuations with the target matters.
+    cdd bools = cdd_false();
+    for (auto& part : bad) {
+        bools |= part.first;
+    }
+    cdd_fed_parts good = cdd_to_fed_partitioned(safe & bools);
+
+    cdd result = cdd_false();
+    auto empty = dbm::fed_t{(uint32_t)cdd_clocknum};
+    cdd_predt_split(bools, bad, good, 0, empty, empty, result);
+    return result;
+}
+
 /**
  * Get the timed predecessor of the given (bad) target dbm and target bdd that cannot be
  * saved (i.e. reached) by delaying into \a safe.
@@ -146,79 +331,9 @@ cdd cdd_from_fed(const dbm::fed_t& fed)
  */
 cdd cdd_predt_dbm(raw_t* dbm_target, cdd bdd_target, const cdd& safe)
 {
-    cdd result = cdd_false();
-
-    // Check whether the safe has an overlapping BDD part with the target.
-    cdd good_part_with_fitting_bools = bdd_target & safe;
-    if (good_part_with_fitting_bools != cdd_false()) {
-        // For each possible combination of boolean valuations,
-        // compute the part of safe that overlaps with it.
-        for (auto i = 0u; i < (1u << cdd_varnum); ++i) {
-            cdd all_booleans = cdd_true();
-            for (auto j = 0u; j < cdd_varnum; ++j) {
-                bool current = (i & 1 << j) != 0;
-                if (current) {
-                    all_booleans &= cdd_bddvarpp(bdd_start_level + j);
-                } else {
-                    all_booleans &= cdd_bddnvarpp(bdd_start_level + j);
-                }
-            }
-
-            // No need to test combinations that don't satisfy the bad part.
-            if (cdd_equiv(all_booleans & bdd_target, cdd_false())) {
-                continue;
-            }
-
-            // Paranoia check.
-            assert(!cdd_eval_false(all_booleans & bdd_target));
-
-            auto bad_fed = dbm::fed_t{dbm_target, (uint32_t)cdd_clocknum};
-            ADBM(dbm_good, cdd_clocknum);
-            cdd good_copy = good_part_with_fitting_bools & all_booleans;
-
-            if (!cdd_eval_false(good_copy)) {
-                auto good_fed = dbm::fed_t{(uint32_t)cdd_clocknum};
-                while (!cdd_isterminal(good_copy.handle()) && cdd_info(good_copy.handle())->type != TYPE_BDD) {
-                    extraction_result res_good = cdd_extract_bdd_and_dbm(good_copy);
-                    good_copy = cdd_reduce(cdd_remove_negative(res_good.CDD_part));
-                    free(dbm_good);
-                    dbm_good = res_good.dbm;
-                    cdd bdd_good = res_good.BDD_part;
-                    good_fed.add(dbm_good, cdd_clocknum);
-                }
-
-                // If good_fed is empty, good_copy did not contain any DBM. This has the interpretation
-                // of an unbounded DBM.
-                if (good_fed.isEmpty()) {
-                    dbm_init(dbm_good, cdd_clocknum);
-                    good_fed.add(dbm_good, cdd_clocknum);
-                }
-
-                auto pred_fed = bad_fed.predt(good_fed);
-                result |= cdd_from_fed(pred_fed) & all_booleans;
-
-            } else {
-                // For all boolean valuations we did not reach with our safe CDD, we take the past of the
-                // current target DBM.
-                ADBM(local, cdd_clocknum);
-                dbm_copy(local, dbm_target, cdd_clocknum);
-                dbm_down(local, cdd_clocknum);
-                cdd past = cdd(local, cdd_clocknum) & all_booleans;
-                result |= past;
-                free(local);
-            }
-            free(dbm_good);
-        }
-
-    } else {
-        // Safe does not have an overlapping part with the target BDD.
-        // So the complete past of this DBM is bad.
-        dbm_down(dbm_target, cdd_clocknum);
-        cdd past = cdd(dbm_target, cdd_clocknum) & bdd_target;
-        result |= past;
-    }
-
-    return result;
+    cdd_fed_parts bad;
+    bad.emplace_back(bdd_target, dbm::fed_t{dbm_target, (uint32_t)cdd_clocknum});
+    return cdd_predt_parts(bad, safe);
 }
 
 /**
@@ -239,29 +354,8 @@ cdd cdd_predt(const cdd& target, const cdd& safe)
     if (safe == cdd_true())
         return cdd_false();
 
-    cdd allThatKillsUs = cdd_false();
-    cdd copy = target;
-    ADBM(dbm_target, cdd_clocknum);
-
-    if (cdd_isterminal(target.handle()) || cdd_info(target.handle())->type == TYPE_BDD) {
-        dbm_init(dbm_target, cdd_clocknum);
-        cdd result = cdd_predt_dbm(dbm_target, target, safe);
-        free(dbm_target);
-        return result;
-    }
-
-    // Split target into DBMs.
-    while (!cdd_isterminal(copy.handle()) && cdd_info(copy.handle())->type != TYPE_BDD) {
-        extraction_result res = cdd_extract_bdd_and_dbm(copy);
-        copy = cdd_reduce(cdd_remove_negative(res.CDD_part));
-        free(dbm_target);
-        dbm_target = res.dbm;
-        cdd bdd_target = res.BDD_part;
-
-        allThatKillsUs |= cdd_predt_dbm(dbm_target, bdd_target, safe);
-    }
-    free(dbm_target);
-    return allThatKillsUs;
+    // Split target into federations, one per BDD part.
+    return cdd_predt_parts(cdd_to_fed_partitioned(target), safe);
 }
 
 /**
@@ -282,10 +376,9 @@ cdd cdd_delay_invariant(const cdd& state, const cdd& invar)
 /**
  * Perform the inverse delay operation on a CDD.
  *
- * <p>The inverse delay is performed by extracting all DBMs (and their
- * corresponding BDD part), delaying the DBMs individually,
- * and then compose the delayed DBMs back together with their
- * BDD parts.</p>
+ * <p>The inverse delay is performed by \c cdd_down(), which keeps
+ * the structure of the CDD rather than splitting it into DBMs,
+ * and is restricted to non-negative clock values.</p>
  *
  * @param cdd a CDD
  * @return the delayed CDD.
@@ -298,19 +391,7 @@ cdd cdd_past(const cdd& state)
     if (cdd_info(state.handle())->type == TYPE_BDD)
         return state;
 
-    cdd copy = state;
-    cdd res = cdd_false();
-    ADBM(dbm, cdd_clocknum);
-    while (!cdd_isterminal(copy.handle()) && cdd_info(copy.handle())->type != TYPE_BDD) {
-        copy = cdd_reduce(copy);
-        cdd bottom = cdd_extract_bdd(copy, cdd_clocknum);
-        copy = cdd_extract_dbm(copy, dbm, cdd_clocknum);
-        copy = cdd_reduce(cdd_remove_negative(copy));
-        dbm_down(dbm, cdd_clocknum);
-        res |= (cdd(dbm, cdd_clocknum) & bottom);
-    }
-    free(dbm);
-    return res;
+    return cdd_remove_negative(cdd_down(state));
 }
 /**
  * Checks if a CDD is a BDD.
@@ -446,17 +527,19 @@ void cdd_bdd_to_matrix_rec(ddNode* r, dynamic_two_dim_matrix& varsMatrix, dynami
     assert(!cdd_isterminal(r));
     if (cdd_info(r)->type == TYPE_BDD) {
         bddNode* node = bdd_node(r);
+        ddNode* low = cdd_ptr(node->low);
+        ddNode* high = cdd_ptr(node->high);
 
         // First follow the true child of the BDD node.
         varsMatrix.add_value_to_row(node->level);
         valuesMatrix.add_value_to_row(1);
-        cdd_bdd_to_matrix_rec(node->high, varsMatrix, valuesMatrix, current_step + 1, negated ^ cdd_is_negated(r));
+        cdd_bdd_to_matrix_rec(high, varsMatrix, valuesMatrix, current_step + 1, negated ^ cdd_is_negated(r));
 
         // Now follow the false child of the BDD node.
         varsMatrix.next_row(current_step);
         valuesMatrix.next_row(current_step - 1);
         valuesMatrix.add_value_to_row(0);
-        cdd_bdd_to_matrix_rec(node->low, varsMatrix, valuesMatrix, current_step + 1, negated ^ cdd_is_negated(r));
+        cdd_bdd_to_matrix_rec(low, varsMatrix, valuesMatrix, current_step + 1, negated ^ cdd_is_negated(r));
     } else {
         printf("not called with a BDD node");
     }
@@ -539,19 +622,11 @@ cdd cdd_apply_reset(const cdd& state, int32_t* clock_resets, int32_t* clock_valu
         return copy;
 
     // Apply the clock resets.
-    cdd res = cdd_false();
-    while (!cdd_isterminal(copy.handle()) && cdd_info(copy.handle())->type != TYPE_BDD) {
-        copy = cdd_reduce(copy);
-        extraction_result exres = cdd_extract_bdd_and_dbm(copy);
-        cdd bottom = exres.BDD_part;
-        copy = cdd_reduce(cdd_remove_negative(exres.CDD_part));
+    return cdd_map_zones(copy, [&](raw_t* dbm) {
         for (int i = 0; i < num_clock_resets; i++) {
-            dbm_updateValue(exres.dbm, cdd_clocknum, clock_resets[i], clock_values[i]);
+            dbm_updateValue(dbm, cdd_clocknum, clock_resets[i], clock_values[i]);
         }
-        res |= (cdd(exres.dbm, cdd_clocknum) & bottom);
-        free(exres.dbm);
-    }
-    return res;
+    });
 }
 
 /**
@@ -599,18 +674,16 @@ cdd cdd_transition(const cdd& state, const cdd& guard, int32_t* clock_resets, in
 cdd cdd_transition_back(const cdd& state, const cdd& guard, const cdd& update, int32_t* clock_resets,
                         int32_t num_clock_resets, int32_t* bool_resets, int32_t num_bool_resets)
 {
-    cdd copy = state;
     // TODO: sanity check: implement cdd_is_update();
     // assert(ccd_is_update(update));
-    copy &= update;
+
+    // Apply the update and the bool resets in one go.
+    cdd copy = num_bool_resets > 0 ? cdd_and_exist(state, update, bool_resets, nullptr, num_bool_resets, 0)
+                                   : state & update;
     if (copy == cdd_false()) {
         return copy;
     }
 
-    // Apply bool resets.
-    if (num_bool_resets > 0)
-        copy = cdd_exist(copy, bool_resets, nullptr, num_bool_resets, 0);
-
     // Special cases when we are already done.
     if (num_clock_resets == 0)
         return copy & guard;
@@ -618,19 +691,11 @@ cdd cdd_transition_back(const cdd& state, const cdd& guard, const cdd& update, i
         return copy & guard;
 
     // Apply the clock resets.
-    cdd res = cdd_false();
-    copy = cdd_remove_negative(copy);
-    while (!cdd_isterminal(copy.handle()) && cdd_info(copy.handle())->type != TYPE_BDD) {
-        copy = cdd_reduce(copy);
-        extraction_result exres = cdd_extract_bdd_and_dbm(copy);
-        cdd bottom = exres.BDD_part;
-        copy = cdd_reduce(cdd_remove_negative(exres.CDD_part));
+    cdd res = cdd_map_zones(copy, [&](raw_t* dbm) {
         for (int i = 0; i < num_clock_resets; i++) {
-            dbm_freeClock(exres.dbm, cdd_clocknum, clock_resets[i]);
+            dbm_freeClock(dbm, cdd_clocknum, clock_resets[i]);
         }
-        res |= (cdd(exres.dbm, cdd_clocknum) & bottom);
-        free(exres.dbm);
-    }
+    });
     return res & guard;
 }
 
@@ -24,6 +24,11 @@ static ddNode* cdd_bf_reduce_rec(ddNode* node, struct bellmanford* graph)
     ddNode* res;
     LevelInfo* info;
 
+    /* Back off in case of error */
+    if (cdd_errorcond) {
+        return 0;
+    }
+
     /* Termination conditions */
     if (cdd_isterminal(node))
         return node;
@@ -32,10 +37,13 @@ static ddNode* cdd_bf_reduce_rec(ddNode* node, struct bellmanford* graph)
     info = cdd_info(node);
     switch (info->type) {
     case TYPE_BDD:
-        n = cdd_bf_reduce_rec(cdd_neg_cond(bdd_node(node)->low, cdd_mask(node)), graph);
+        n = cdd_bf_reduce_rec(bdd_low(node), graph);
+        if (n == NULL) {
+            return 0;
+        }
         cdd_ref(n);
-        res = cdd_make_bdd_node(cdd_rglr(node)->level, n,
-                                cdd_bf_reduce_rec(cdd_neg_cond(bdd_node(node)->high, cdd_mask(node)), graph));
+        res = cdd_bf_reduce_rec(bdd_high(node), graph);
+        res = res == NULL ? NULL : cdd_make_bdd_node(cdd_rglr(node)->level, n, res);
         cdd_deref(n);
         break;
 
@@ -64,13 +72,17 @@ static ddNode* cdd_bf_reduce_rec(ddNode* node, struct bellmanford* graph)
         /* Do recursion for the first consistent child we found above.
          */
         prev = cdd_bf_reduce_rec(cdd_it_child(it), graph);
+        if (prev == NULL) {
+            cdd_bf_pop(graph);
+            return 0;
+        }
         mask = cdd_mask(prev);
         cdd_ref(prev);
 
         /* Repeat until next inconsistent bound or the last bound.
          */
         top = cdd_refstacktop;
-        for (cdd_it_next(it); !cdd_it_atend(it); cdd_it_next(it)) {
+        for (cdd_it_next(it); !cdd_it_atend(it) && !cdd_errorcond; cdd_it_next(it)) {
             cdd_bf_pop(graph);
             cdd_bf_push(graph, info->clock2, info->clock1, bnd_l2u(cdd_it_lower(it)));
             if (!cdd_bf_consistent(graph)) {
@@ -86,22 +98,36 @@ static ddNode* cdd_bf_reduce_rec(ddNode* node, struct bellmanford* graph)
                 n = cdd_bf_reduce_rec(cdd_it_child(it), graph);
             }
 
-            if (prev != n) {
+            if (!cdd_errorcond && prev != n) {
                 cdd_push(cdd_neg_cond(prev, mask), cdd_it_lower(it));
-                prev = n;
-                cdd_ref(prev);
+                if (!cdd_errorcond) {
+                    prev = n;
+                    cdd_ref(prev);
+                }
             }
         }
         cdd_bf_pop(graph);
-        cdd_push(cdd_neg_cond(prev, mask), INF);
+        if (!cdd_errorcond) {
+            cdd_push(cdd_neg_cond(prev, mask), INF);
+        }
+
+        /* Back off in case of error; prev is not on the stack */
+        if (cdd_errorcond) {
+            cdd_deref(prev);
+            cdd_unwind(top, top);
+            return 0;
+        }
 
         /* Create node */
-        res = cdd_neg_cond(cdd_make_cdd_node(cdd_rglr(node)->level, top, cdd_refstacktop - top), mask);
+        res = cdd_make_cdd_node(cdd_rglr(node)->level, top, cdd_refstacktop - top);
+        if (res != NULL) {
+            res = cdd_neg_cond(res, mask);
+        }
 
         /* Remove references */
         while (cdd_refstacktop > top) {
             cdd_refstacktop--;
-            cdd_deref(cdd_refstacktop->child);
+            cdd_deref(cdd_ptr(cdd_refstacktop->child));
         }
     }
     return res;
@@ -15,6 +15,7 @@
 #include "hash/compute.h"
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -28,6 +29,12 @@
 
 #ifdef WIN32
 #include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(CDD_CONCURRENT) || defined(CDD_COMPRESSED)
+#include <sched.h>
+#endif
 #endif
 
 #if defined(__APPLE__) && defined(__MACH__)
@@ -39,74 +46,189 @@
 #define HASH_DENSITY  4  /**< Max. density of hash table. */
 #define THRESHOLD     5  /**< Free nodes in percent for when to GBC. */
 #define MINFREE       20 /**< Minimum free nodes in percent. */
+#define RETENTION     16 /**< Default number of empty chunks kept by a node manager. */
 #define SIZEOF_INT    4  /**< Size of integer in bytes. */
 #define SIZEOF_VOID_P 4  /**< Size of void pointer in bytes. */
 
-#if defined(WIN32)
-#define CHUNKSIZE 0x10000 /* Size of chunk in bytes */
-#elif defined(ARCH_APPLE_DARWIN)
+/**
+ * Address space in bytes reserved for the reference stack of a
+ * context. Memory is committed as the stack grows, so the stack never
+ * moves and pointers into it stay valid.
+ */
+#define REFSTACK_RESERVE ((size_t)1 << (sizeof(void*) == 8 ? 30 : 24))
+
+#if defined(ARCH_APPLE_DARWIN)
 #include <mach/mach_init.h>
 #include <mach/vm_map.h>
-#define CHUNKSIZE 0x1000 /* Size of chunk in bytes */
-#else
+#elif !defined(WIN32)
 #include <malloc.h>
-#define CHUNKSIZE 0x10000 /* Size of chunk in bytes */
 #endif
 
-/** Returns a chunk in which \a node is allocated. */
-#define cdd_node2chunk(node) ((Chunk*)((uintptr_t)(node) & ~(CHUNKSIZE - 1)))
-
 /**
- * The terminal node. Since we can negate nodes by toggling a single
- * bit on the pointer to the node, we only need one terminal (the true
- * node).
+ * The nodes which are not allocated by a node manager. They are
+ * shared by all contexts and initialised statically, so that
+ * contexts set up by concurrent threads never write to them.
  */
-static ddNode cdd_terminal;
+static struct
+{
+    /**
+     * The terminal node. Since we can negate nodes by toggling a single
+     * bit on the pointer to the node, we only need one terminal (the true
+     * node).
+     */
+    ddNode terminal;
+    bddNode bddsentinel;  ///< "End of list" mark of BDD subtables
+    cddNode cddsentinel;  ///< "End of list" mark of CDD subtables
+} cdd_special = {.terminal = {.next = 0, .level = MAXLEVEL, .ref = MAXREF, .flag = 0}};
+
+#define cdd_terminal    (cdd_special.terminal)
+#define cdd_bddsentinel ((ddNode*)&cdd_special.bddsentinel)
+#define cdd_cddsentinel ((ddNode*)&cdd_special.cddsentinel)
+
+/*** KERNEL VARIABLES ***********************************************/
+ddNode* cddfalse = &cdd_terminal; /**< True terminal. */
+/** False terminal (negated true): the complement bit set on the terminal. */
+ddNode* cddtrue = (ddNode*)((char*)&cdd_terminal + 1);
+
+const raw_t cdd_infbound = INF;
+
+/** The context used by threads which have not selected another one. */
+static cdd_context cdd_default_context;
+
+CDD_THREAD_LOCAL cdd_context* cdd_current = &cdd_default_context;
+
+/*** CONTEXT VARIABLES **********************************************/
+#ifdef CDD_CONCURRENT
+/** The context owning the nodes of the current context. */
+#define cdd_forest (cdd_current->owner ? cdd_current->owner : cdd_current)
+#else
+#define cdd_forest cdd_current
+#endif
 
+#define bddmanager          (cdd_current->bddman)       /**< BDD Node manager. */
+#define cddmanager          (cdd_current->cddman)       /**< Array of CDD Node managers. */
+#define cdd_cddtables       (cdd_current->cddtables)    /**< Subtables of CDD nodes. */
+#define cdd_gbcclock        (cdd_forest->gbcclock)      /**< Acc. time used for garbage collection. */
+#define cdd_gbccnt          (cdd_forest->gbccnt)        /**< Number of times we have run GBC. */
+#define cdd_rehashclock     (cdd_forest->rehashclock)   /**< Acc. time used for rehashing. */
+#define cdd_rehashcnt       (cdd_forest->rehashcnt)     /**< Number of times we have rehashed. */
+#define cdd_maxcddsize      (cdd_current->maxcddsize)   /**< Max. arity of a node. */
+#define cdd_key             (cdd_current->key)          /**< Key of the CDD node being made. */
+#define cdd_maxcddused      (cdd_forest->maxcddused)    /**< Max. size class of any allocated node. */
+#define cdd_chunkcnt        (cdd_forest->chunkcnt)      /**< Total number of chunks allocated. */
+#define cdd_retention       (cdd_forest->retention)     /**< Number of empty chunks kept by a node manager. */
+#define cdd_compaction      (cdd_forest->compaction)    /**< Fragmentation in percent triggering compaction. */
+#define cdd_compactclock    (cdd_forest->compactclock)  /**< Acc. time used for compaction. */
+#define cdd_compactcnt      (cdd_forest->compactcnt)    /**< Number of times we have compacted. */
+#define cdd_roots           (cdd_current->roots)        /**< Registered roots. */
+#define cdd_rootcnt         (cdd_current->rootcnt)      /**< Number of registered roots. */
+#define cdd_rootsize        (cdd_current->rootsize)     /**< Size of root table. */
+#define cdd_overflow        (cdd_forest->overflow)      /**< Overflow table of reference counts. */
+#define cdd_overflowcnt     (cdd_forest->overflowcnt)   /**< Number of nodes in the overflow table. */
+#define cdd_overflowsize    (cdd_forest->overflowsize)  /**< Size of the overflow table. */
+#define cdd_running         (cdd_current->running)      /**< True if library has been initialised. */
+#define pregbc_handler      (cdd_current->pregbc)       /**< Pre-gbc handler */
+#define postgbc_handler     (cdd_current->postgbc)      /**< Post-gbc handler */
+#define prerehash_handler   (cdd_current->prerehash)    /**< Pre-rehash handler */
+#define postrehash_handler  (cdd_current->postrehash)   /**< Post-rehash handler */
+#define postcompact_handler (cdd_current->postcompact)  /**< Post-compaction handler */
 #ifdef MULTI_TERMINAL
-static ddNode** extra_terminals = NULL;
-static int32_t nb_extra_terminals = 0;
+#define extra_terminals    (cdd_current->xterms)
+#define nb_extra_terminals (cdd_current->xtermcnt)
+#endif
+#ifdef CDD_CONCURRENT
+#define cdd_freenodes (cdd_current->freenodes) /**< Free nodes taken from the node managers. */
 #endif
 
-/*** KERNEL VARIABLES ***********************************************/
-NodeManager* bddmanager;  /**< BDD Node manager. */
-NodeManager** cddmanager; /**< Array of CDD Node managers. */
-int32_t cdd_levelcnt;     /**< Number of levels allocated. */
-int32_t cdd_gbcclock;     /**< Acc. time used for garbage collection. */
-int32_t cdd_gbccnt;       /**< Number of times we have run GBC. */
-int32_t cdd_rehashclock;  /**< Acc. time used for rehashing. */
-int32_t cdd_rehashcnt;    /**< Number of times we have rehashed. */
-int32_t cdd_maxcddsize;   /**< Max. arity of a node. */
-int32_t cdd_maxcddused;   /**< Max. nodes the library may allocate. */
-int32_t cdd_chunkcnt;     /**< Total number of chunks allocated. */
-int32_t bdd_start_level;  /**< BDD start level */
-int32_t cdd_clocknum;     /**< Number of clocks allocated. */
-int32_t cdd_varnum;       /**< Number of BDD variables allocated. */
-LevelInfo* cdd_levelinfo;
-int32_t* cdd_diff2level;
-int32_t cdd_running;   /**< True if library has been initialised. */
-int32_t cdd_errorcond; /**< Last error code. */
-ddNode* cddfalse;      /**< True terminal. */
-ddNode* cddtrue;       /**< False terminal (negated true). */
-
-Elem* cdd_refstack;      /**< Base address of stack. */
-Elem* cdd_refstacktop;   /**< Top of stack. */
-size_t cdd_refstacksize; /**< Size of stack. */
-
-/*** STATIC KERNEL VARIABLES ***************************************/
-static void (*pregbc_handler)(void);               /**< Pre-gbc handler */
-static void (*postgbc_handler)(CddGbcStat*);       /**< Post-gbc handler */
-static void (*prerehash_handler)(void);            /**< Pre-rehash handler */
-static void (*postrehash_handler)(CddRehashStat*); /**< Post-rehash handler */
+/*** SYNCHRONISATION ************************************************/
+#if defined(CDD_CONCURRENT) || defined(CDD_COMPRESSED)
+/** Acquire a spin lock, yielding the processor while it is held by another thread. */
+static inline void cdd_spin_lock(cdd_lock_t* lock)
+{
+    int32_t spin = 0;
+    while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(lock, __ATOMIC_RELAXED)) {
+            if (++spin == 64) {
+#ifdef WIN32
+                SwitchToThread();
+#else
+                sched_yield();
+#endif
+                spin = 0;
+            }
+        }
+    }
+}
+
+/** Release a spin lock. */
+static inline void cdd_spin_unlock(cdd_lock_t* lock) { __atomic_store_n(lock, 0, __ATOMIC_RELEASE); }
+#endif
+
+#ifdef CDD_CONCURRENT
+/** Protects creation of node managers and subtables. */
+static cdd_lock_t cdd_structure_lock;
+
+/** Protects the overflow tables of reference counts. */
+static cdd_lock_t cdd_overflow_lock;
+
+/** Number of free nodes a context takes from a node manager at a time. */
+#define FREEBATCH 64
+
+#define cdd_lock(lock)   cdd_spin_lock(lock)
+#define cdd_unlock(lock) cdd_spin_unlock(lock)
+
+/** Returns the lock protecting the bucket for \a hash in \a tbl. */
+#define cdd_stripe(tbl, hash) (&(tbl)->lock[(uint32_t)(hash) >> CDD_STRIPE_SHIFT])
+
+/** Adds \a n to the counter \a var and returns the new value. */
+#define cdd_atomic_add(var, n) __atomic_add_fetch(&(var), (n), __ATOMIC_RELAXED)
+
+/** Reads a pointer published by another thread. */
+#define cdd_load(ptr) __atomic_load_n(&(ptr), __ATOMIC_ACQUIRE)
+
+/** Publishes a value to other threads. */
+#define cdd_store(ptr, val) __atomic_store_n(&(ptr), (val), __ATOMIC_RELEASE)
+
+/** True if the references held by \a node have been released. */
+#define cdd_isdead(node) (__atomic_load_n(cdd_header(node), __ATOMIC_RELAXED) & cdd_flagword(MARKDEAD))
+
+/**
+ * True if no other context sharing the nodes of the current one is in
+ * use, in which case garbage may be collected when allocating nodes.
+ */
+#define cdd_exclusive (cdd_current->owner == NULL && cdd_load(cdd_current->active) == 0)
+#else
+#define cdd_lock(lock)
+#define cdd_unlock(lock)
+#define cdd_stripe(tbl, hash)  NULL
+#define cdd_atomic_add(var, n) ((var) += (n))
+#define cdd_load(ptr)          (ptr)
+#define cdd_store(ptr, val)    ((ptr) = (val))
+#define cdd_isdead(node)       ((node)->flag & MARKDEAD)
+#define cdd_exclusive          1
+#endif
 
 /** Allocate a new subtable. */
 static SubTable* cdd_alloc_subtable(NodeManager*, int);
 
+/** Allocate a chunk of memory on a 64KB boundary. */
+static Chunk* cdd_allocate_chunk_from_os();
+
+/** Return a chunk allocated by \c cdd_allocate_chunk_from_os(). */
+static void cdd_deallocate_chunk_to_os(Chunk*);
+
 /** Deallocate a subtable. */
 static void cdd_dealloc_subtable(SubTable*);
 
-/** Allocate a node manager. */
-static NodeManager* cdd_alloc_nodemanager(int, NodeHashFunc);
+/** Deallocate an array of subtables, one for each level. */
+static void cdd_dealloc_subtables(SubTable**);
+
+/**
+ * Allocate a node manager. Its nodes are kept in the given subtables
+ * with the given sentinel, which may be shared with other node
+ * managers and are not owned by it.
+ */
+static NodeManager* cdd_alloc_nodemanager(int, NodeHashFunc, SubTable**, ddNode*);
 
 /** Deallocate a node manager. */
 static void cdd_dealloc_nodemanager(NodeManager*);
@@ -115,10 +237,18 @@ static void cdd_dealloc_nodemanager(NodeManager*);
 static void cdd_gbc_nodemanager(NodeManager*);
 
 /** Allocate a chunk. */
-static void cdd_alloc_chunk(NodeManager*);
+static int32_t cdd_alloc_chunk(NodeManager*);
 
 /** Dealloate a chunk. */
-static ddNode* cdd_alloc_node(NodeManager*);
+static ddNode* cdd_alloc_node(NodeManager*, int32_t);
+
+#ifdef CDD_CONCURRENT
+/** Allocate the free lists of the current context. */
+static ddNode** cdd_alloc_freenodes();
+
+/** Return the free nodes of the current context to the node managers. */
+static void cdd_return_freenodes(int32_t);
+#endif
 
 /** Rehash a subtable, doubling the size of it. */
 static void cdd_rehash(NodeManager*, SubTable*);
@@ -139,9 +269,10 @@ static void cdd_rehash(NodeManager*, SubTable*);
 #define bddHash(f, g) ((uint32_t)(((uint32_t)(f)*DD_P1 + (uint32_t)(g)) * DD_P2))
 
 /**
- * Hash function over an array of \a len Elem elements.
+ * Hash function over the bounds and children of a CDD node with \a
+ * len elements.
  */
-#define cddHash(elem, len) (hash_computeU32((uint32_t*)(elem), (len) * (sizeof(Elem) >> 2), (len)))
+#define cddHash(node, len) (hash_computeU32((uint32_t*)(node)->bnd, cdd_elemsize(len) >> 2, (len)))
 
 static uint32_t cdd_hash_func(NodeManager*, ddNode*);
 static uint32_t bdd_hash_func(NodeManager*, ddNode*);
@@ -154,6 +285,97 @@ int32_t cdd_error(int32_t e)
     return e;
 }
 
+/** Returns the size of a page of virtual memory, the unit in which the reference stack is committed. */
+static size_t cdd_pagesize()
+{
+#if defined(WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+/** Releases the reference stack of the current context. */
+static void cdd_refstack_free()
+{
+    if (cdd_refstack != NULL) {
+#if defined(WIN32)
+        VirtualFree(cdd_refstack, 0, MEM_RELEASE);
+#else
+        munmap(cdd_refstack, cdd_current->refstackreserve);
+#endif
+        cdd_refstack = cdd_refstacktop = cdd_refstacklimit = NULL;
+    }
+}
+
+/**
+ * Reserves the reference stack of the current context and commits
+ * room for \a stacksize elements. Leaves \c cdd_refstack NULL if out
+ * of memory.
+ */
+static void cdd_refstack_alloc(size_t stacksize)
+{
+    size_t page = cdd_pagesize();
+    size_t reserve = (stacksize * sizeof(Elem) + page - 1) & ~(page - 1);
+    char* base;
+
+    if (reserve < REFSTACK_RESERVE) {
+        reserve = REFSTACK_RESERVE;
+    }
+
+#if defined(WIN32)
+    base = (char*)VirtualAlloc(0, reserve, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    base = (char*)mmap(NULL, reserve, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        base = NULL;
+    }
+#endif
+    cdd_refstack = cdd_refstacktop = cdd_refstacklimit = (Elem*)base;
+    cdd_refstacksize = 0;
+    cdd_current->refstackreserve = reserve;
+    if (base != NULL && !cdd_refstack_grow(cdd_refstack + (stacksize > 0 ? stacksize : 1))) {
+        cdd_refstack_free();
+    }
+}
+
+int32_t cdd_refstack_grow(const void* end)
+{
+    size_t size = cdd_refstacksize * sizeof(Elem);
+    size_t need = (const char*)end - (const char*)cdd_refstack;
+    size_t page, commit, grow;
+
+    if (need <= size) {
+        return 1;
+    }
+    if (need > cdd_current->refstackreserve) {
+        cdd_errorcond = cdd_error(CDD_STACKOVERFLOW);
+        return 0;
+    }
+
+    // At least double the committed part, in whole pages after the committed ones
+    page = cdd_pagesize();
+    commit = (size + page - 1) & ~(page - 1);
+    grow = (need + page - 1) & ~(page - 1);
+    if (grow < 2 * commit) {
+        grow = 2 * commit < cdd_current->refstackreserve ? 2 * commit : cdd_current->refstackreserve;
+    }
+#if defined(WIN32)
+    if (grow > commit &&
+        VirtualAlloc((char*)cdd_refstack + commit, grow - commit, MEM_COMMIT, PAGE_READWRITE) == NULL) {
+#else
+    if (grow > commit && mprotect((char*)cdd_refstack + commit, grow - commit, PROT_READ | PROT_WRITE) != 0) {
+#endif
+        cdd_errorcond = cdd_error(CDD_MEMORY);
+        return 0;
+    }
+    cdd_refstacksize = grow / sizeof(Elem);
+    cdd_refstacklimit = cdd_refstack + cdd_refstacksize;
+    return 1;
+}
+
 int32_t cdd_init(int32_t maxsize, int32_t cs, size_t stacksize)
 {
     int32_t err;
@@ -162,43 +384,67 @@ int32_t cdd_init(int32_t maxsize, int32_t cs, size_t stacksize)
         return cdd_error(CDD_RUNNING);
     }
 
-    cdd_terminal.next = NULL;
-    cdd_terminal.ref = MAXREF;
-    cdd_terminal.level = MAXLEVEL;
-    cdd_terminal.flag = 0;
-    cddfalse = &cdd_terminal;
-    cddtrue = cdd_neg(cddfalse);
+#ifdef CDD_COMPRESSED
+    // Contexts may be initialised by several threads at once
+    assert(sizeof(cdd_special) <= CDD_SPECIALSIZE);
+    if (__atomic_load_n(&cdd_chunktable[0], __ATOMIC_RELAXED) == NULL) {
+        __atomic_store_n(&cdd_chunktable[0], (char*)&cdd_special, __ATOMIC_RELAXED);
+    }
+#endif
+    assert(cddtrue == cdd_neg(cddfalse));
 
     cdd_maxcddsize = maxsize;
     cdd_maxcddused = 0;
     cdd_levelcnt = cdd_chunkcnt = 0;
+    cdd_retention = RETENTION;
+    cdd_compaction = 0;
     cdd_gbcclock = 0;
     cdd_gbccnt = 0;
+    cdd_compactclock = 0;
+    cdd_compactcnt = 0;
+    cdd_roots = NULL;
+    cdd_rootcnt = cdd_rootsize = 0;
+    cdd_overflow = NULL;
+    cdd_overflowcnt = cdd_overflowsize = 0;
     postgbc_handler = NULL;
     pregbc_handler = NULL;
     prerehash_handler = NULL;
     postrehash_handler = NULL;
+    postcompact_handler = NULL;
     cdd_refstack = NULL;
+    cdd_key = NULL;
     cddmanager = NULL;
     bddmanager = NULL;
+#ifdef CDD_CONCURRENT
+    cdd_freenodes = NULL;
+#endif
+    cdd_cddtables = NULL;
     cdd_levelinfo = NULL;
     cdd_diff2level = NULL;
     cdd_clocknum = 0;
     cdd_varnum = 0;
     cdd_postgbc_hook(cdd_default_gbhandler);
     cdd_postrehash_hook(cdd_default_rehashhandler);
+    cdd_postcompact_hook(cdd_default_compacthandler);
 
     if ((err = cdd_operator_init(cs)) < 0) {
         cdd_done();
         return err;
     }
 
-    cdd_refstacksize = stacksize;
-    cdd_refstack = cdd_refstacktop = (Elem*)malloc(sizeof(Elem) * stacksize);
-    cddmanager = (NodeManager**)calloc(maxsize + 1, sizeof(NodeManager*));
-    bddmanager = cdd_alloc_nodemanager(sizeof(bddNode), bdd_hash_func);
+    cdd_refstack_alloc(stacksize);
+    cdd_key = (cddNode*)malloc(sizeof(cddNode) + cdd_elemsize(maxsize));
+    cddmanager = (NodeManager**)calloc(cdd_sizeclass(maxsize) + 1, sizeof(NodeManager*));
+    bddmanager = cdd_alloc_nodemanager(sizeof(bddNode), bdd_hash_func, NULL, cdd_bddsentinel);
+#ifdef CDD_CONCURRENT
+    cdd_freenodes = cdd_alloc_freenodes();
+    if (cdd_freenodes == NULL) {
+        cdd_done();
+        return cdd_error(CDD_MEMORY);
+    }
+#endif
 
-    if (cdd_refstack == NULL || cddmanager == NULL || bddmanager == NULL) {
+    if (cdd_refstack == NULL || cdd_key == NULL || cddmanager == NULL || bddmanager == NULL) {
         cdd_done();
         return cdd_error(CDD_MEMORY);
     }
@@ -219,6 +465,82 @@ void cdd_ensure_running()
     }
 }
 
+cdd_context* cdd_context_create() { return (cdd_context*)calloc(1, sizeof(cdd_context)); }
+
+void cdd_context_destroy(cdd_context* ctx)
+{
+    cdd_context* prev;
+
+    if (ctx == NULL || ctx == &cdd_default_context) {
+        return;
+    }
+
+    prev = cdd_context_set(ctx);
+    cdd_done();
+    cdd_context_set(prev == ctx ? NULL : prev);
+    free(ctx);
+}
+
+cdd_context* cdd_context_set(cdd_context* ctx)
+{
+    cdd_context* prev = cdd_current;
+    cdd_current = ctx ? ctx : &cdd_default_context;
+    return prev;
+}
+
+cdd_context* cdd_context_get() { return cdd_current; }
+
+cdd_context* cdd_context_default() { return &cdd_default_context; }
+
+#ifdef CDD_CONCURRENT
+int32_t cdd_context_share(cdd_context* ctx, int32_t cs, size_t stacksize)
+{
+    cdd_context* owner = cdd_forest;
+    cdd_context* prev;
+    int32_t err;
+
+    if (ctx->running) {
+        return cdd_error(CDD_RUNNING);
+    }
+
+    *ctx = *owner;
+    ctx->owner = owner;
+    ctx->shares = NULL;
+    ctx->active = 0;
+    ctx->freenodes = NULL;
+    ctx->operators = NULL;
+    ctx->errorcond = 0;
+    ctx->roots = NULL;
+    ctx->rootcnt = ctx->rootsize = 0;
+
+    prev = cdd_context_set(ctx);
+    if ((err = cdd_operator_init(cs)) < 0) {
+        cdd_context_set(prev);
+        return err;
+    }
+    cdd_refstack_alloc(stacksize);
+    cdd_key = (cddNode*)malloc(sizeof(cddNode) + cdd_elemsize(cdd_maxcddsize));
+    cdd_freenodes = cdd_alloc_freenodes();
+    if (cdd_refstack == NULL || cdd_key == NULL || cdd_freenodes == NULL) {
+        cdd_refstack_free();
+        free(cdd_key);
+        free(cdd_freenodes);
+        cdd_operator_done();
+        cdd_context_set(prev);
+        return cdd_error(CDD_MEMORY);
+    }
+    cdd_context_set(prev);
+
+    cdd_lock(&cdd_structure_lock);
+    ctx->next = owner->shares;
+    owner->shares = ctx;
+    cdd_atomic_add(owner->active, 1);
+    cdd_unlock(&cdd_structure_lock);
+
+    return 0;
+}
+#endif
+
 #ifdef MULTI_TERMINAL
 
 void cdd_add_tautologies(int32_t n)
@@ -226,20 +548,45 @@ void cdd_add_tautologies(int32_t n)
     int32_t oldn = nb_extra_terminals;
     int32_t newn = oldn + n;
     int32_t i;
+    ddNode** terminals;
     assert(n >= 0);
-    nb_extra_terminals = newn;
-    extra_terminals = (ddNode**)realloc(extra_terminals, newn * sizeof(ddNode*));
-    // FIXME: NULL.
+    terminals = (ddNode**)realloc(extra_terminals, newn * sizeof(ddNode*));
+    if (terminals == NULL) {
+        cdd_errorcond = cdd_error(CDD_MEMORY);
+        return;
+    }
+    extra_terminals = terminals;
 
     for (i = oldn; i < newn; ++i) {
+#ifdef CDD_COMPRESSED
+        // Handles can only address nodes in chunks
+        Chunk* chunk = cdd_current->xtermchunks;
+        xtermNode* node;
+        if (chunk == NULL || (chunk->freecnt + 1) * sizeof(xtermNode) > CHUNKSIZE - sizeof(Chunk)) {
+            chunk = cdd_allocate_chunk_from_os();
+            if (chunk == NULL) {
+                break;
+            }
+            chunk->man = NULL;
+            chunk->freecnt = 0;
+            chunk->next = cdd_current->xtermchunks;
+            cdd_current->xtermchunks = chunk;
+        }
+        node = (xtermNode*)chunk->nodes + chunk->freecnt++;
+#else
         xtermNode* node = (xtermNode*)malloc(sizeof(xtermNode));
-        // FIXME: NULL.
-        node->next = NULL;
+        if (node == NULL) {
+            cdd_errorcond = cdd_error(CDD_MEMORY);
+            break;
+        }
+#endif
+        node->next = 0;
         node->ref = MAXREF;
         node->level = MAXLEVEL;
         node->flag = 0;
         node->id = i;
         extra_terminals[i] = (ddNode*)node;
+        nb_extra_terminals = i + 1;
     }
 }
 
@@ -269,6 +616,10 @@ int32_t cdd_get_number_of_tautologies() { return nb_extra_terminals; }
 
 int32_t cdd_isrunning() { return cdd_running; }
 
+int32_t cdd_get_error() { return cdd_errorcond; }
+
+void cdd_clear_error() { cdd_errorcond = 0; }
+
 void cdd_done()
 {
     int32_t i;
@@ -277,19 +628,66 @@ void cdd_done()
         return;
     }
 
+#ifdef CDD_CONCURRENT
+    if (cdd_current->owner) {
+        cdd_context** p;
+        cdd_operator_done();
+        cdd_refstack_free();
+        free(cdd_key);
+        free(cdd_roots);
+        cdd_roots = NULL;
+        cdd_return_freenodes(1);
+        free(cdd_freenodes);
+        cdd_freenodes = NULL;
+        cdd_lock(&cdd_structure_lock);
+        for (p = &cdd_current->owner->shares; *p != cdd_current; p = &(*p)->next)
+            ;
+        *p = cdd_current->next;
+        cdd_atomic_add(cdd_current->owner->active, -1);
+        cdd_unlock(&cdd_structure_lock);
+        cdd_current->owner = NULL;
+        cdd_running = 0;
+        return;
+    }
+#endif
+
     cdd_operator_done();
-    cdd_dealloc_nodemanager(bddmanager);
-    for (i = 0; i <= cdd_maxcddsize; i++) {
-        cdd_dealloc_nodemanager(cddmanager[i]);
+#ifdef CDD_CONCURRENT
+    assert(cdd_current->shares == NULL);
+    free(cdd_freenodes);
+    cdd_freenodes = NULL;
+#endif
+    if (bddmanager) {
+        cdd_dealloc_subtables(bddmanager->subtables);
+        cdd_dealloc_nodemanager(bddmanager);
+    }
+    if (cddmanager) {
+        for (i = 0; i <= cdd_maxcddused; i++) {
+            cdd_dealloc_nodemanager(cddmanager[i]);
+        }
     }
+    cdd_dealloc_subtables(cdd_cddtables);
     free(cddmanager);
-    free(cdd_refstack);
+    cdd_refstack_free();
+    free(cdd_key);
+    free(cdd_roots);
+    cdd_roots = NULL;
+    free(cdd_overflow);
+    cdd_overflow = NULL;
     free(cdd_levelinfo);
     free(cdd_diff2level);
 #ifdef MULTI_TERMINAL
+#ifdef CDD_COMPRESSED
+    while (cdd_current->xtermchunks) {
+        Chunk* chunk = cdd_current->xtermchunks;
+        cdd_current->xtermchunks = chunk->next;
+        cdd_deallocate_chunk_to_os(chunk);
+    }
+#else
     for (i = 0; i < nb_extra_terminals; ++i) {
         free(extra_terminals[i]);
     }
+#endif
     nb_extra_terminals = 0;
     free(extra_terminals);
     extra_terminals = NULL;
@@ -297,21 +695,81 @@ void cdd_done()
     cdd_running = 0;
 }
 
+#ifdef CDD_COMPRESSED
+/*
+ * The chunk table is shared by all contexts. Unused entries form a
+ * list of indices, each entry holding the next index shifted left
+ * with the lowest bit set, which cannot be a chunk address.
+ */
+char* cdd_chunktable[CDD_MAXCHUNKS];
+static uint32_t cdd_chunkhigh = 1;  ///< Entries from here on have never been used
+static uint32_t cdd_chunkfree = 0;  ///< First unused entry below \c cdd_chunkhigh, 0 if none
+static cdd_lock_t cdd_chunklock;    ///< Protects the chunk table
+
+/** Reserves an entry in the chunk table. Returns 0 if the table is full. */
+static uint32_t cdd_alloc_chunk_index()
+{
+    uint32_t index = 0;
+
+    cdd_spin_lock(&cdd_chunklock);
+    if (cdd_chunkfree) {
+        index = cdd_chunkfree;
+        cdd_chunkfree = (uint32_t)((uintptr_t)cdd_chunktable[index] >> 1);
+    } else if (cdd_chunkhigh < CDD_MAXCHUNKS) {
+        index = cdd_chunkhigh++;
+    }
+    cdd_spin_unlock(&cdd_chunklock);
+    return index;
+}
+
+/** Returns entry \a index to the unused entries of the chunk table. */
+static void cdd_free_chunk_index(uint32_t index)
+{
+    cdd_spin_lock(&cdd_chunklock);
+    cdd_chunktable[index] = (char*)(((uintptr_t)cdd_chunkfree << 1) | 1);
+    cdd_chunkfree = index;
+    cdd_spin_unlock(&cdd_chunklock);
+}
+#endif
+
 static Chunk* cdd_allocate_chunk_from_os()
 {
+    Chunk* chunk;
+#ifdef CDD_COMPRESSED
+    uint32_t index = cdd_alloc_chunk_index();
+    if (index == 0) {
+        cdd_errorcond = cdd_error(CDD_MEMORY);
+        return NULL;
+    }
+#endif
 #if defined(WIN32)
-    return (Chunk*)VirtualAlloc(0, CHUNKSIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    chunk = (Chunk*)VirtualAlloc(0, CHUNKSIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
 #elif defined(ARCH_APPLE_DARWIN)
     vm_address_t address;
     vm_allocate(mach_task_self(), &address, CHUNKSIZE, true);
-    return (Chunk*)address;
+    chunk = (Chunk*)address;
 #else
-    return (Chunk*)memalign(CHUNKSIZE, CHUNKSIZE);
+    chunk = (Chunk*)memalign(CHUNKSIZE, CHUNKSIZE);
+#endif
+    if (chunk == NULL) {
+#ifdef CDD_COMPRESSED
+        cdd_free_chunk_index(index);
+#endif
+        cdd_errorcond = cdd_error(CDD_MEMORY);
+        return NULL;
+    }
+#ifdef CDD_COMPRESSED
+    chunk->index = index;
+    cdd_chunktable[index] = (char*)chunk;
 #endif
+    return chunk;
 }
 
 static void cdd_deallocate_chunk_to_os(Chunk* chunk)
 {
+#ifdef CDD_COMPRESSED
+    cdd_free_chunk_index(chunk->index);
+#endif
 #if defined(WIN32)
     VirtualFree(chunk, CHUNKSIZE, MEM_DECOMMIT | MEM_RELEASE);
 #elif defined(ARCH_APPLE_DARWIN)
@@ -324,18 +782,29 @@ static void cdd_deallocate_chunk_to_os(Chunk* chunk)
 static SubTable* cdd_alloc_subtable(NodeManager* man, int32_t level)
 {
     int32_t i;
-    SubTable* tbl = (SubTable*)malloc(sizeof(SubTable));
+    SubTable* tbl;
+
+    cdd_lock(&cdd_structure_lock);
+    if ((tbl = man->subtables[level]) != NULL) {
+        cdd_unlock(&cdd_structure_lock);
+        return tbl;
+    }
+    tbl = (SubTable*)malloc(sizeof(SubTable));
+#ifdef CDD_CONCURRENT
+    memset(tbl->lock, 0, sizeof(tbl->lock));
+#endif
     tbl->level = level;
     tbl->deadcnt = 0;
     tbl->shift = SIZEOF_INT * 8 - 8;
     tbl->buckets = 256;
     tbl->keys = 0;
     tbl->maxkeys = tbl->buckets * HASH_DENSITY;
-    tbl->hash = (ddNode**)malloc(tbl->buckets * sizeof(ddNode*));
+    tbl->hash = (cdd_handle_t*)malloc(tbl->buckets * sizeof(cdd_handle_t));
     for (i = 0; i < tbl->buckets; i++) {
-        tbl->hash[i] = man->sentinel;
+        tbl->hash[i] = cdd_handle(man->sentinel);
     }
-    man->subtables[level] = tbl;
+    cdd_store(man->subtables[level], tbl);
+    cdd_unlock(&cdd_structure_lock);
     return tbl;
 }
 
@@ -347,7 +816,19 @@ static void cdd_dealloc_subtable(SubTable* tbl)
     }
 }
 
-static NodeManager* cdd_alloc_nodemanager(int32_t size, NodeHashFunc hashfunc)
+static void cdd_dealloc_subtables(SubTable** tables)
+{
+    int32_t i;
+
+    if (tables) {
+        for (i = 0; i < cdd_levelcnt; i++) {
+            cdd_dealloc_subtable(tables[i]);
+        }
+        free(tables);
+    }
+}
+
+static NodeManager* cdd_alloc_nodemanager(int32_t size, NodeHashFunc hashfunc, SubTable** subtables, ddNode* sentinel)
 {
     NodeManager* man;
 
@@ -360,27 +841,23 @@ static NodeManager* cdd_alloc_nodemanager(int32_t size, NodeHashFunc hashfunc)
     man->deadcnt = 0;
     man->gbccnt = 0;
     man->gbcclock = 0;
-    man->free = NULL;
+    man->free = cddfalse;
     man->nodes = NULL;
     man->hashfunc = hashfunc;
-    man->subtables = calloc(cdd_levelcnt, sizeof(SubTable*));
-    man->sentinel = cdd_alloc_node(man);
-    memset(man->sentinel, 0, size);
+#ifdef CDD_CONCURRENT
+    man->lock = 0;
+#endif
+    man->subtables = subtables;
+    man->sentinel = sentinel;
 
     return man;
 }
 
 static void cdd_dealloc_nodemanager(NodeManager* man)
 {
-    int32_t i;
     Chunk *p, *q;
 
     if (man) {
-        /* Free sub tables */
-        for (i = 0; i < cdd_levelcnt; i++) {
-            cdd_dealloc_subtable(man->subtables[i]);
-        }
-
         /* Free chunks */
         p = man->nodes;
         while (p) {
@@ -390,222 +867,1237 @@ static void cdd_dealloc_nodemanager(NodeManager* man)
         }
 
         /* Free node manager */
-        free(man->subtables);
         free(man);
     }
 }
 
-static void cdd_alloc_chunk(NodeManager* man)
+/**
+ * Adds a chunk of free nodes to \a man.
+ * @return 1 if successful, 0 if out of memory, in which case the
+ * error condition is set
+ */
+static int32_t cdd_alloc_chunk(NodeManager* man)
+{
+    ddNode* node;
+    int32_t i;
+    int32_t nodes = (CHUNKSIZE - sizeof(Chunk)) / man->nodesize;
+    Chunk* chunk = cdd_allocate_chunk_from_os();
+
+    if (chunk == NULL) {
+        return 0;
+    }
+
+    // Add node to chunk chain
+    chunk->man = man;
+    chunk->next = man->nodes;
+    man->nodes = chunk;
+
+    // Init nodes
+    for (i = nodes - 1; i >= 0; i--) {
+        node = (ddNode*)((char*)chunk->nodes + i * man->nodesize);
+        node->next = cdd_handle(man->free);
+        man->free = node;
+    }
+
+    // Update counters
+    man->freecnt += nodes;
+    man->chunkcnt++;
+    man->alloccnt += nodes;
+    cdd_atomic_add(cdd_chunkcnt, 1);
+    return 1;
+}
+
+static uint32_t cdd_hash_func(NodeManager* man, ddNode* node)
+{
+    return cddHash(cdd_node(node), cdd_node(node)->len);
+}
+
+/**
+ * Compares the elements of \a key to the elements of \a node. CDD
+ * nodes are ordered by arity first, so the sentinel, which has no
+ * elements, is smaller than any node.
+ */
+static inline int32_t cdd_elemcmp(cddNode* key, cddNode* node)
+{
+    if (key->len != node->len) {
+        return key->len < node->len ? -1 : 1;
+    }
+    return memcmp(key->bnd, node->bnd, cdd_elemsize(key->len));
+}
+
+static uint32_t bdd_hash_func(NodeManager* man, ddNode* node)
+{
+    return bddHash(bdd_node(node)->low, bdd_node(node)->high);
+}
+
+/** Hash function of nodes in the overflow table. */
+#define cdd_overflowhash(node, size) ((uint32_t)(((uintptr_t)(node) >> 2) * DD_P4) & ((size)-1))
+
+/** Returns the entry of \a node in the overflow table, or the free entry where it belongs. */
+static RefOverflow* cdd_overflow_find(ddNode* node)
+{
+    uint32_t i = cdd_overflowhash(node, cdd_overflowsize);
+
+    while (cdd_overflow[i].node != NULL && cdd_overflow[i].node != node) {
+        i = (i + 1) & (cdd_overflowsize - 1);
+    }
+    return &cdd_overflow[i];
+}
+
+/** Doubles the size of the overflow table. Returns 0 if out of memory. */
+static int32_t cdd_overflow_grow()
+{
+    RefOverflow* old = cdd_overflow;
+    int32_t i, size = cdd_overflowsize;
+    RefOverflow* table = (RefOverflow*)calloc(size > 0 ? 2 * size : 64, sizeof(RefOverflow));
+
+    if (table == NULL) {
+        return 0;
+    }
+    cdd_overflow = table;
+    cdd_overflowsize = size > 0 ? 2 * size : 64;
+    for (i = 0; i < size; i++) {
+        if (old[i].node != NULL) {
+            *cdd_overflow_find(old[i].node) = old[i];
+        }
+    }
+    free(old);
+    return 1;
+}
+
+/** Removes entry \a i from the overflow table. */
+static void cdd_overflow_remove(uint32_t i)
+{
+    uint32_t j, k, mask = cdd_overflowsize - 1;
+
+    cdd_overflowcnt--;
+
+    // Move entries of the probe sequence into the hole, so no tombstones are needed
+    for (j = i;;) {
+        cdd_overflow[i].node = NULL;
+        do {
+            j = (j + 1) & mask;
+            if (cdd_overflow[j].node == NULL) {
+                return;
+            }
+            k = cdd_overflowhash(cdd_overflow[j].node, cdd_overflowsize);
+        } while (((j - k) & mask) < ((j - i) & mask));
+        cdd_overflow[i] = cdd_overflow[j];
+        i = j;
+    }
+}
+
+int32_t cdd_overflow_update(ddNode* node, int32_t delta)
+{
+    RefOverflow* entry;
+
+    if (delta < 0) {
+        if (cdd_overflow == NULL || (entry = cdd_overflow_find(node))->node == NULL) {
+            return 0;
+        }
+        if (--entry->count == 0) {
+            cdd_overflow_remove(entry - cdd_overflow);
+        }
+        return 1;
+    }
+
+    if (cdd_overflow == NULL || (entry = cdd_overflow_find(node))->node == NULL) {
+        if (2 * (cdd_overflowcnt + 1) > cdd_overflowsize) {
+            if (!cdd_overflow_grow()) {
+                // Fall back to making the node immortal
+#ifdef CDD_CONCURRENT
+                NodeHeader old, upd;
+                old.word = __atomic_load_n(cdd_header(node), __ATOMIC_RELAXED);
+                do {
+                    upd = old;
+                    upd.bits.ref = MAXREF;
+                } while (!__atomic_compare_exchange_n(cdd_header(node), &old.word, upd.word, 1, __ATOMIC_ACQ_REL,
+                                                      __ATOMIC_RELAXED));
+#else
+                node->ref = MAXREF;
+#endif
+                return 1;
+            }
+        }
+        entry = cdd_overflow_find(node);
+        entry->node = node;
+        entry->count = 0;
+        cdd_overflowcnt++;
+    }
+    entry->count++;
+    return 1;
+}
+
+#ifdef CDD_CONCURRENT
+NodeHeader cdd_atomic_addref_overflow(ddNode* node, int32_t delta)
+{
+    NodeHeader old, upd;
+
+    // Other threads may have moved the count away from OVERREF before
+    // the lock was taken, in which case the node is updated instead
+    cdd_lock(&cdd_overflow_lock);
+    old.word = __atomic_load_n(cdd_header(node), __ATOMIC_RELAXED);
+    do {
+        if (old.bits.ref == MAXREF || (old.bits.ref == OVERREF && cdd_overflow_update(node, delta))) {
+            break;
+        }
+        upd = old;
+        upd.bits.ref += delta;
+        if (delta > 0) {
+            upd.bits.flag &= ~MARKDEAD;
+        }
+    } while (!__atomic_compare_exchange_n(cdd_header(node), &old.word, upd.word, 1, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_RELAXED));
+    cdd_unlock(&cdd_overflow_lock);
+    return old;
+}
+
+/**
+ * Atomically decrements the reference count of \a node unless it is
+ * equal to MAXREF, setting \c MARKDEAD when it drops to zero.
+ * @return the new reference count, or -1 if it already was zero
+ */
+static int32_t cdd_release(ddNode* node)
+{
+    NodeHeader old, upd;
+    old.word = __atomic_load_n(cdd_header(node), __ATOMIC_RELAXED);
+    do {
+        if (old.bits.ref == 0) {
+            return -1;
+        }
+        if (old.bits.ref == MAXREF) {
+            return MAXREF;
+        }
+        if (old.bits.ref == OVERREF) {
+            // At least OVERREF - 1 references remain
+            cdd_atomic_addref_overflow(node, -1);
+            return OVERREF - 1;
+        }
+        upd = old;
+        upd.bits.ref--;
+        if (upd.bits.ref == 0) {
+            upd.bits.flag |= MARKDEAD;
+        }
+    } while (!__atomic_compare_exchange_n(cdd_header(node), &old.word, upd.word, 1, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_RELAXED));
+    return upd.bits.ref;
+}
+#endif
+
+/**
+ * Makes room above \a top on the reference stack for pushing the
+ * children of \a node.
+ * @return 0 if the stack overflowed
+ */
+static inline int32_t cdd_refstack_room(ddNode** top, ddNode* node)
+{
+    ddNode** end = top + (cdd_info(node)->type == TYPE_CDD ? cdd_node(node)->len : 2);
+    return (Elem*)end <= cdd_refstacklimit || cdd_refstack_grow(end);
+}
+
+void cdd_rec_deref(ddNode* node)
+{
+    cdd_iterator it;
+    int32_t ref;
+    ddNode** top = (ddNode**)cdd_refstacktop;
+    *(top++) = cdd_rglr(node);
+
+    do {
+        node = cdd_rglr(*(--top));
+#ifdef CDD_CONCURRENT
+        if ((ref = cdd_release(node)) < 0) {
+            cdd_error(CDD_DEREF);
+            return;
+        }
+#else
+        if (node->ref == 0) {
+            cdd_error(CDD_DEREF);
+            return;
+        }
+        cdd_deref(node);
+        if ((ref = node->ref) == 0) {
+            node->flag |= MARKDEAD;
+        }
+#endif
+        if (ref == 0) {
+            cdd_atomic_add(cdd_node2chunk(node)->man->usedcnt, -1);
+            cdd_atomic_add(cdd_node2chunk(node)->man->deadcnt, 1);
+            cdd_atomic_add(cdd_node2chunk(node)->man->subtables[node->level]->deadcnt, 1);
+            if (!cdd_refstack_room(top, node)) {
+                return;
+            }
+            switch (cdd_info(node)->type) {
+            case TYPE_BDD:
+                *(top++) = cdd_ptr(bdd_node(node)->low);
+                *(top++) = cdd_ptr(bdd_node(node)->high);
+                break;
+            case TYPE_CDD:
+                cdd_it_init(it, node);
+                while (!cdd_it_atend(it)) {
+                    *(top++) = cdd_it_child(it);
+                    cdd_it_next(it);
+                }
+            }
+        }
+    } while (top > (ddNode**)cdd_refstacktop);
+}
+
+#ifdef CDD_CONCURRENT
+void cdd_revive(ddNode* node)
+{
+    cdd_iterator it;
+    NodeManager* man = cdd_node2chunk(node)->man;
+
+    cdd_atomic_add(man->usedcnt, 1);
+    cdd_atomic_add(man->deadcnt, -1);
+    cdd_atomic_add(man->subtables[node->level]->deadcnt, -1);
+    switch (cdd_info(node)->type) {
+    case TYPE_CDD:
+        for (cdd_it_init(it, node); !cdd_it_atend(it); cdd_it_next(it)) {
+            cdd_ref(cdd_it_child(it));
+        }
+        break;
+    case TYPE_BDD: cdd_ref(cdd_ptr(bdd_node(node)->low)); cdd_ref(cdd_ptr(bdd_node(node)->high));
+    }
+}
+
+void cdd_reclaim(ddNode* node)
+{
+    NodeHeader old, upd;
+
+    node = cdd_rglr(node);
+    old.word = __atomic_load_n(cdd_header(node), __ATOMIC_RELAXED);
+    do {
+        if (!(old.bits.flag & MARKDEAD)) {
+            return;
+        }
+        upd = old;
+        upd.bits.flag &= ~MARKDEAD;
+    } while (!__atomic_compare_exchange_n(cdd_header(node), &old.word, upd.word, 1, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_RELAXED));
+    cdd_revive(node);
+}
+#else
+/** References \a child of a node being reclaimed and pushes it on \a top if it was dead. */
+static inline ddNode** cdd_reclaim_child(ddNode** top, ddNode* child)
+{
+    child = cdd_rglr(child);
+    if (cdd_isdead(child)) {
+        child->flag &= ~MARKDEAD;
+        *(top++) = child;
+    }
+    cdd_ref(child);
+    return top;
+}
+
+void cdd_reclaim(ddNode* node)
+{
+    cdd_iterator it;
+    ddNode** top = (ddNode**)cdd_refstacktop;
+
+    node = cdd_rglr(node);
+    if (!cdd_isdead(node)) {
+        return;
+    }
+    node->flag &= ~MARKDEAD;
+    *(top++) = node;
+
+    do {
+        node = *(--top);
+        cdd_node2chunk(node)->man->usedcnt++;
+        cdd_node2chunk(node)->man->deadcnt--;
+        cdd_node2chunk(node)->man->subtables[node->level]->deadcnt--;
+        if (!cdd_refstack_room(top, node)) {
+            return;
+        }
+        switch (cdd_info(node)->type) {
+        case TYPE_CDD:
+            cdd_it_init(it, node);
+            while (!cdd_it_atend(it)) {
+                top = cdd_reclaim_child(top, cdd_it_child(it));
+                cdd_it_next(it);
+            }
+            break;
+        case TYPE_BDD:
+            top = cdd_reclaim_child(top, cdd_ptr(bdd_node(node)->low));
+            top = cdd_reclaim_child(top, cdd_ptr(bdd_node(node)->high));
+        }
+    } while (top > (ddNode**)cdd_refstacktop);
+}
+#endif
+
+static void cdd_gbc_release(ddNode* node);
+
+/**
+ * Drops a reference from a node being freed. If it was the last one,
+ * \a node becomes dead and drops the references it holds itself.
+ * Unlike \c cdd_rec_deref() this does not use the reference stack,
+ * which may hold the children of a node being allocated.
+ */
+static void cdd_gbc_deref(ddNode* node)
+{
+    int32_t ref;
+
+    node = cdd_rglr(node);
+#ifdef CDD_CONCURRENT
+    ref = cdd_release(node);
+#else
+    if (node->ref == 0) {
+        return;
+    }
+    cdd_deref(node);
+    if ((ref = node->ref) == 0) {
+        node->flag |= MARKDEAD;
+    }
+#endif
+    if (ref == 0) {
+        cdd_node2chunk(node)->man->usedcnt--;
+        cdd_node2chunk(node)->man->deadcnt++;
+        cdd_node2chunk(node)->man->subtables[node->level]->deadcnt++;
+        cdd_gbc_release(node);
+    }
+}
+
+/** Drops the references held by \a node. */
+static void cdd_gbc_release(ddNode* node)
+{
+    cdd_iterator it;
+
+    switch (cdd_info(node)->type) {
+    case TYPE_CDD:
+        for (cdd_it_init(it, node); !cdd_it_atend(it); cdd_it_next(it)) {
+            cdd_gbc_deref(cdd_it_child(it));
+        }
+        break;
+    case TYPE_BDD: cdd_gbc_deref(cdd_ptr(bdd_node(node)->low)); cdd_gbc_deref(cdd_ptr(bdd_node(node)->high));
+    }
+}
+
+/**
+ * Returns the chunks of \a man in which all nodes are free to the
+ * OS, except for \c cdd_retention of them. Must be called right after
+ * a sweep.
+ */
+static void cdd_release_chunks(NodeManager* man)
+{
+    Chunk *chunk, **c;
+    ddNode *node, *last;
+    int32_t nodes = (CHUNKSIZE - sizeof(Chunk)) / man->nodesize;
+    int32_t release = -cdd_retention;
+
+    // Count free nodes per chunk
+    for (chunk = man->nodes; chunk != NULL; chunk = chunk->next) {
+        chunk->freecnt = 0;
+    }
+    for (node = man->free; node != cddfalse; node = cdd_ptr(node->next)) {
+        cdd_node2chunk(node)->freecnt++;
+    }
+
+    // Mark the empty chunks beyond the retention watermark
+    for (chunk = man->nodes; chunk != NULL; chunk = chunk->next) {
+        release += (chunk->freecnt == nodes);
+    }
+    if (release <= 0) {
+        return;
+    }
+    for (chunk = man->nodes; chunk != NULL && release > 0; chunk = chunk->next) {
+        if (chunk->freecnt == nodes) {
+            chunk->freecnt = -1;
+            release--;
+        }
+    }
+
+    // Unlink their nodes from the free list
+    last = NULL;
+    for (node = man->free; node != cddfalse; node = cdd_ptr(node->next)) {
+        if (cdd_node2chunk(node)->freecnt >= 0) {
+            if (last) {
+                last->next = cdd_handle(node);
+            } else {
+                man->free = node;
+            }
+            last = node;
+        }
+    }
+    if (last) {
+        last->next = cdd_handle(cddfalse);
+    } else {
+        man->free = cddfalse;
+    }
+
+    // Release them
+    c = &man->nodes;
+    while ((chunk = *c) != NULL) {
+        if (chunk->freecnt < 0) {
+            *c = chunk->next;
+            cdd_deallocate_chunk_to_os(chunk);
+            man->freecnt -= nodes;
+            man->alloccnt -= nodes;
+            man->chunkcnt--;
+            cdd_chunkcnt--;
+        } else {
+            c = &chunk->next;
+        }
+    }
+}
+
+/** Returns the BDD node manager for \a i = 0 and the CDD node manager of size class \a i otherwise. */
+static inline NodeManager* cdd_nodemanager(int32_t i) { return i == 0 ? bddmanager : cddmanager[i]; }
+
+static void cdd_gbc_nodemanager(NodeManager* man)
+{
+    SubTable* tbl;
+    NodeManager* owner;
+    ddNode *node, *next;
+    cdd_handle_t* p;
+    int64_t clk = clock();
+    int32_t i, j, first, last;
+
+    if (pregbc_handler != NULL) {
+        pregbc_handler();
+    }
+
+    for (i = 0; i < cdd_levelcnt; i++) {
+        tbl = man->subtables[i];
+        if (tbl == NULL || tbl->deadcnt == 0) {
+            continue;
+        }
+        for (j = 0; j < tbl->buckets; j++) {
+            p = &(tbl->hash[j]);
+            node = cdd_ptr(*p);
+            while (node != man->sentinel) {
+                next = cdd_ptr(node->next);
+                if (node->ref == 0) {
+                    // The node may belong to another manager sharing the subtables
+                    owner = cdd_node2chunk(node)->man;
+                    if (!(node->flag & MARKDEAD)) {
+                        // Never referenced, so it still holds references to its children
+                        owner->usedcnt--;
+                        tbl->deadcnt++;
+                        cdd_gbc_release(node);
+                    } else {
+                        owner->deadcnt--;
+                    }
+                    node->next = cdd_handle(owner->free);
+                    owner->free = node;
+                    owner->freecnt++;
+                } else {
+                    *p = cdd_handle(node);
+                    p = &node->next;
+                }
+                node = next;
+            }
+            *p = cdd_handle(man->sentinel);
+        }
+        tbl->keys -= tbl->deadcnt;
+        tbl->deadcnt = 0;
+    }
+
+    // The CDD node managers share their subtables, so all of them have been collected
+    first = man == bddmanager ? 0 : 1;
+    last = man == bddmanager ? 0 : cdd_maxcddused;
+    for (i = first; i <= last; i++) {
+        if ((owner = cdd_nodemanager(i)) != NULL) {
+            cdd_release_chunks(owner);
+        }
+    }
+
+    clk = clock() - clk;
+
+    for (i = first; i <= last; i++) {
+        if ((owner = cdd_nodemanager(i)) != NULL) {
+            owner->gbccnt++;
+            owner->gbcclock += clk;
+        }
+    }
+
+    cdd_gbcclock += clk;
+    cdd_gbccnt++;
+
+    if (postgbc_handler != NULL) {
+        CddGbcStat s;
+        s.nodes = s.freenodes = 0;
+        for (i = first; i <= last; i++) {
+            if ((owner = cdd_nodemanager(i)) != NULL) {
+                s.nodes += owner->alloccnt;
+                s.freenodes += owner->freecnt;
+            }
+        }
+        s.time = clk;
+        s.sumtime = cdd_gbcclock;
+        s.num = cdd_gbccnt;
+        postgbc_handler(&s);
+    }
+}
+
+/**
+ * Flushes the operation caches of all contexts using the nodes of the
+ * current one with \a flush, i.e. \c cdd_operator_flush() or \c
+ * cdd_operator_reset().
+ */
+static void cdd_flush_caches(void (*flush)(void))
+{
+#ifdef CDD_CONCURRENT
+    cdd_context *self = cdd_current, *ctx;
+
+    cdd_context_set(cdd_forest);
+    flush();
+    cdd_lock(&cdd_structure_lock);
+    for (ctx = cdd_current->shares; ctx != NULL; ctx = ctx->next) {
+        cdd_context_set(ctx);
+        flush();
+    }
+    cdd_unlock(&cdd_structure_lock);
+    cdd_context_set(self);
+#else
+    flush();
+#endif
+}
+
+/**
+ * Returns the free nodes in chunks holding nodes in use in percent of
+ * the nodes in those chunks.
+ */
+static int32_t cdd_fragmentation()
+{
+    NodeManager* man;
+    Chunk* chunk;
+    ddNode* node;
+    int64_t used = 0, free = 0;
+    int32_t i, nodes;
+
+    for (i = 0; i <= cdd_maxcddused; i++) {
+        if ((man = cdd_nodemanager(i)) == NULL) {
+            continue;
+        }
+        nodes = (CHUNKSIZE - sizeof(Chunk)) / man->nodesize;
+        for (chunk = man->nodes; chunk != NULL; chunk = chunk->next) {
+            chunk->freecnt = 0;
+        }
+        for (node = man->free; node != cddfalse; node = cdd_ptr(node->next)) {
+            cdd_node2chunk(node)->freecnt++;
+        }
+        for (chunk = man->nodes; chunk != NULL; chunk = chunk->next) {
+            if (chunk->freecnt < nodes) {
+                used += nodes - chunk->freecnt;
+                free += chunk->freecnt;
+            }
+        }
+    }
+    return used + free > 0 ? (int32_t)(100 * free / (used + free)) : 0;
+}
+
+int32_t cdd_usednodes()
+{
+    NodeManager* man;
+    int32_t i, cnt = cdd_load(bddmanager->usedcnt);
+
+    for (i = 1; i <= cdd_sizeclass(cdd_maxcddsize); i++) {
+        if ((man = cdd_load(cddmanager[i])) != NULL) {
+            cnt += cdd_load(man->usedcnt);
+        }
+    }
+    return cnt;
+}
+
+void cdd_gbc()
+{
+    int32_t i;
+    int64_t clk = clock();
+
+    if (!cdd_exclusive) {
+        return;
+    }
+
+    cdd_flush_caches(cdd_operator_flush);
+#ifdef CDD_CONCURRENT
+    // The free nodes held by the context would keep their chunks from being released
+    cdd_return_freenodes(0);
+#endif
+
+    cdd_gbcclock += clock() - clk;
+
+    // Check BDD manager
+    if (THRESHOLD * bddmanager->alloccnt >= 100 * bddmanager->freecnt &&
+        MINFREE * bddmanager->alloccnt < 100 * bddmanager->deadcnt) {
+        cdd_gbc_nodemanager(bddmanager);
+    }
+
+    // Check CDD managers; collecting one collects all, as they share their subtables
+    for (i = 1; i <= cdd_maxcddused; i++) {
+        if (cddmanager[i] && THRESHOLD * cddmanager[i]->alloccnt >= 100 * cddmanager[i]->freecnt &&
+            MINFREE * cddmanager[i]->alloccnt < 100 * cddmanager[i]->deadcnt) {
+            cdd_gbc_nodemanager(cddmanager[i]);
+            break;
+        }
+    }
+
+    // Compact if the remaining nodes are spread over too many chunks
+    if (cdd_compaction > 0 && cdd_fragmentation() > cdd_compaction) {
+        cdd_compact();
+    }
+}
+
+/*** COMPACTION *****************************************************/
+
+/**
+ * State of a compaction. The slots of all chunks are numbered
+ * consecutively; while compacting, the \c freecnt field of a chunk
+ * holds the number of its first slot.
+ */
+typedef struct
+{
+    int32_t* incoming;  ///< References from live nodes and roots per slot, -1 once ordered
+    ddNode** forward;   ///< New address of the node in a slot, the node itself if pinned
+    ddNode** order;     ///< Live nodes in depth first order
+    int32_t cnt;        ///< Number of nodes in \a order
+} Compaction;
+
+/** Hash of a root location for a root table of \a size entries. */
+#define cdd_roothash(root, size) ((uint32_t)(((uintptr_t)(root) >> 3) * DD_P4) & ((size)-1))
+
+/** Returns the slot number of the regular non-terminal \a node. */
+static inline int32_t cdd_slot(ddNode* node)
+{
+    Chunk* chunk = cdd_node2chunk(node);
+    return chunk->freecnt + (int32_t)(((char*)node - (char*)chunk->nodes) / chunk->man->nodesize);
+}
+
+/** Returns the address of node \a i in \a chunk of \a man. */
+#define cdd_slot_node(man, chunk, i) ((ddNode*)((char*)(chunk)->nodes + (i) * (man)->nodesize))
+
+/** Returns the location of child \a i of the regular \a node, or NULL after the last child. */
+static inline cdd_handle_t* cdd_child_ref(ddNode* node, int32_t i)
+{
+    if (cdd_info(node)->type == TYPE_BDD) {
+        return i == 0 ? &bdd_node(node)->low : i == 1 ? &bdd_node(node)->high : NULL;
+    }
+    return i < (int32_t)cdd_node(node)->len ? &cdd_children(node)[i] : NULL;
+}
+
+/** Appends the nodes reachable from \a node which are not yet ordered, depth first. */
+static void cdd_compact_visit(Compaction* c, ddNode* node)
 {
-    ddNode** p;
-    int32_t size = man->nodesize / sizeof(ddNode*);
-    int32_t nodes = (CHUNKSIZE - sizeof(Chunk)) / man->nodesize;
-    Chunk* chunk = cdd_allocate_chunk_from_os();
-
-    // Add node to chunk chain
-    chunk->man = man;
-    chunk->next = man->nodes;
-    man->nodes = chunk;
+    cdd_handle_t* p;
+    int32_t i, slot;
 
-    // Init nodes
-    p = chunk->nodes + (nodes - 1) * size;
-    *p = man->free;
-    man->free = (ddNode*)(chunk->nodes);
-    for (p -= size; p >= chunk->nodes; p -= size) {
-        *p = (ddNode*)(p + size);
+    node = cdd_rglr(node);
+    if (node->level == MAXLEVEL || c->incoming[slot = cdd_slot(node)] < 0) {
+        return;
+    }
+    c->incoming[slot] = -1;
+    c->order[c->cnt++] = node;
+    for (i = 0; (p = cdd_child_ref(node, i)) != NULL; i++) {
+        cdd_compact_visit(c, cdd_ptr(*p));
     }
-
-    // Update counters
-    man->freecnt += nodes;
-    man->chunkcnt++;
-    man->alloccnt += nodes;
-    cdd_chunkcnt++;
 }
 
-static uint32_t cdd_hash_func(NodeManager* man, ddNode* node)
+/** Inserts \a node in its hash chain, keeping the order used by \c cdd_make_bdd_node() and \c cdd_make_cdd_node(). */
+static void cdd_compact_insert(NodeManager* man, ddNode* node)
 {
-    return cddHash(cdd_node(node)->elem, (man->nodesize - sizeof(cddNode)) / sizeof(Elem));
+    SubTable* tbl = man->subtables[node->level];
+    cdd_handle_t* p = &tbl->hash[man->hashfunc(man, node) >> tbl->shift];
+
+    if (man == bddmanager) {
+        cdd_handle_t low = bdd_node(node)->low, high = bdd_node(node)->high;
+        while (low < bdd_node(cdd_ptr(*p))->low) {
+            p = &cdd_ptr(*p)->next;
+        }
+        while (low == bdd_node(cdd_ptr(*p))->low && high < bdd_node(cdd_ptr(*p))->high) {
+            p = &cdd_ptr(*p)->next;
+        }
+    } else {
+        while (cdd_elemcmp(cdd_node(node), cdd_node(cdd_ptr(*p))) < 0) {
+            p = &cdd_ptr(*p)->next;
+        }
+    }
+    node->next = *p;
+    *p = cdd_handle(node);
+    tbl->keys++;
 }
 
-static uint32_t bdd_hash_func(NodeManager* man, ddNode* node)
+/**
+ * Releases the work space of \c cdd_compact() and the fresh chunks
+ * allocated so far when running out of memory, before any node has
+ * moved, and sets the error condition.
+ */
+static void cdd_compact_abort(Compaction* c, ddNode** live, int32_t* next, Chunk*** fresh)
 {
-    return bddHash(bdd_node(node)->low, bdd_node(node)->high);
+    Chunk *chunk, *q;
+    int32_t i;
+
+    for (i = 0; fresh != NULL && i <= cdd_maxcddused; i++) {
+        if (fresh[i] != NULL) {
+            for (chunk = fresh[i][0]; chunk != NULL; chunk = q) {
+                q = chunk->next;
+                cdd_deallocate_chunk_to_os(chunk);
+            }
+            free(fresh[i]);
+        }
+    }
+    free(c->incoming);
+    free(c->forward);
+    free(c->order);
+    free(live);
+    free(next);
+    free(fresh);
+    cdd_errorcond = cdd_error(CDD_MEMORY);
 }
 
-void cdd_rec_deref(ddNode* node)
+void cdd_compact()
 {
-    cdd_iterator it;
-    ddNode** top = (ddNode**)cdd_refstacktop;
-    *(top++) = cdd_rglr(node);
+    Compaction c;
+    NodeManager* man;
+    SubTable *tbl, **tables;
+    Chunk *chunk, ***fresh, **q;
+    ddNode *node, *child, *sentinel, **live, **root;
+    cdd_handle_t* p;
+    int32_t *next, i, j, k, n, slots, livecnt, nodes, empty, pos;
+    int64_t clk = clock();
+    CddCompactStat s;
 
-    do {
-        node = cdd_rglr(*(--top));
-        if (node->ref == 0) {
-            cdd_error(CDD_DEREF);
-            return;
+    if (!cdd_exclusive) {
+        return;
+    }
+
+    // Cached results refer to nodes which are about to move
+    cdd_flush_caches(cdd_operator_reset);
+#ifdef CDD_CONCURRENT
+    // The free lists are rebuilt below
+    cdd_return_freenodes(0);
+#endif
+
+    // Number the slots
+    slots = 0;
+    for (i = 0; i <= cdd_maxcddused; i++) {
+        if ((man = cdd_nodemanager(i)) != NULL) {
+            for (chunk = man->nodes; chunk != NULL; chunk = chunk->next) {
+                chunk->freecnt = slots;
+                slots += (CHUNKSIZE - sizeof(Chunk)) / man->nodesize;
+            }
         }
-        cdd_deref(node);
-        if (node->ref == 0) {
-            cdd_node2chunk(node)->man->usedcnt--;
-            cdd_node2chunk(node)->man->deadcnt++;
-            cdd_node2chunk(node)->man->subtables[node->level]->deadcnt++;
-            switch (cdd_info(node)->type) {
-            case TYPE_BDD:
-                *(top++) = bdd_node(node)->low;
-                *(top++) = bdd_node(node)->high;
-                break;
-            case TYPE_CDD:
-                cdd_it_init(it, node);
-                while (!cdd_it_atend(it)) {
-                    *(top++) = cdd_it_child(it);
-                    cdd_it_next(it);
+    }
+    c.incoming = (int32_t*)calloc(slots, sizeof(int32_t));
+    c.forward = (ddNode**)calloc(slots, sizeof(ddNode*));
+    c.order = (ddNode**)malloc(slots * sizeof(ddNode*));
+    c.cnt = 0;
+    live = (ddNode**)malloc(slots * sizeof(ddNode*));
+    next = (int32_t*)malloc((cdd_levelcnt + 1) * sizeof(int32_t));
+    fresh = (Chunk***)calloc(cdd_maxcddused + 1, sizeof(Chunk**));
+    if (!c.incoming || !c.forward || !c.order || !live || !next || !fresh) {
+        cdd_compact_abort(&c, live, next, fresh);
+        return;
+    }
+
+    // Collect the live nodes of the BDD and CDD subtables and count the references they hold; dead nodes are dropped
+    livecnt = 0;
+    for (i = 0; i < 2; i++) {
+        tables = i == 0 ? bddmanager->subtables : cdd_cddtables;
+        sentinel = i == 0 ? bddmanager->sentinel : cdd_cddsentinel;
+        for (j = 0; j < cdd_levelcnt; j++) {
+            if ((tbl = tables[j]) == NULL) {
+                continue;
+            }
+            for (k = 0; k < tbl->buckets; k++) {
+                for (node = cdd_ptr(tbl->hash[k]); node != sentinel; node = cdd_ptr(node->next)) {
+                    if (cdd_isdead(node)) {
+                        continue;
+                    }
+                    live[livecnt++] = node;
+                    for (n = 0; (p = cdd_child_ref(node, n)) != NULL; n++) {
+                        if ((child = cdd_rglr(cdd_ptr(*p)))->level != MAXLEVEL) {
+                            c.incoming[cdd_slot(child)]++;
+                        }
+                    }
                 }
             }
         }
-    } while (top > (ddNode**)cdd_refstacktop);
-}
+    }
+    for (i = 0; i < cdd_rootsize; i++) {
+        if (cdd_roots[i] != NULL && cdd_rglr(*cdd_roots[i])->level != MAXLEVEL) {
+            c.incoming[cdd_slot(cdd_rglr(*cdd_roots[i]))]++;
+        }
+    }
 
-void cdd_reclaim(ddNode* node)
-{
-    cdd_iterator it;
-    ddNode** top = (ddNode**)cdd_refstacktop;
-    *(top++) = cdd_rglr(node);
+    // Nodes referenced from elsewhere, e.g. from the C interface, are pinned, and so are nodes of single chunk managers
+    // and nodes in the overflow table, which is keyed by address
+    s.pinned = 0;
+    for (i = 0; i < livecnt; i++) {
+        node = live[i];
+        if (node->ref >= OVERREF || node->ref > c.incoming[cdd_slot(node)] ||
+            cdd_node2chunk(node)->man->chunkcnt == 1) {
+            c.forward[cdd_slot(node)] = node;
+            s.pinned++;
+        }
+    }
 
-    do {
-        node = cdd_rglr(*(--top));
-        cdd_node2chunk(node)->man->usedcnt++;
-        cdd_node2chunk(node)->man->deadcnt--;
-        cdd_node2chunk(node)->man->subtables[node->level]->deadcnt--;
-        switch (cdd_info(node)->type) {
-        case TYPE_CDD:
-            cdd_it_init(it, node);
-            while (!cdd_it_atend(it)) {
-                if (cdd_rglr(cdd_it_child(it))->ref == 0)
-                    *(top++) = cdd_it_child(it);
-                cdd_ref(cdd_it_child(it));
-                cdd_it_next(it);
+    // Order depth first from the roots, the pinned nodes and finally the unreferenced nodes
+    for (i = 0; i < cdd_rootsize; i++) {
+        if (cdd_roots[i] != NULL) {
+            cdd_compact_visit(&c, *cdd_roots[i]);
+        }
+    }
+    for (i = 0; i < livecnt; i++) {
+        if (c.forward[cdd_slot(live[i])] == live[i]) {
+            cdd_compact_visit(&c, live[i]);
+        }
+    }
+    for (i = 0; i < livecnt; i++) {
+        cdd_compact_visit(&c, live[i]);
+    }
+
+    // Copy the other nodes to fresh chunks, level by level in depth first order
+    s.moved = 0;
+    for (i = 0; i <= cdd_maxcddused; i++) {
+        if ((man = cdd_nodemanager(i)) == NULL) {
+            continue;
+        }
+        memset(next, 0, (cdd_levelcnt + 1) * sizeof(int32_t));
+        for (j = 0; j < c.cnt; j++) {
+            node = c.order[j];
+            if (cdd_node2chunk(node)->man == man && c.forward[cdd_slot(node)] == NULL) {
+                next[node->level + 1]++;
             }
-            break;
-        case TYPE_BDD:
-            if (cdd_rglr(bdd_node(node)->low)->ref == 0) {
-                *(top++) = bdd_node(node)->low;
+        }
+        for (j = 0; j < cdd_levelcnt; j++) {
+            next[j + 1] += next[j];
+        }
+        if (next[cdd_levelcnt] == 0) {
+            continue;
+        }
+        // The freecnt field of a fresh chunk is its number of free nodes
+        nodes = (CHUNKSIZE - sizeof(Chunk)) / man->nodesize;
+        n = (next[cdd_levelcnt] + nodes - 1) / nodes;
+        // Nothing has moved yet, so running out of memory leaves the forest as it was
+        fresh[i] = (Chunk**)calloc(n, sizeof(Chunk*));
+        if (fresh[i] == NULL) {
+            cdd_compact_abort(&c, live, next, fresh);
+            return;
+        }
+        for (j = 0; j < n; j++) {
+            chunk = fresh[i][j] = cdd_allocate_chunk_from_os();
+            if (chunk == NULL) {
+                cdd_compact_abort(&c, live, next, fresh);
+                return;
             }
-            if (cdd_rglr(bdd_node(node)->high)->ref == 0) {
-                *(top++) = bdd_node(node)->high;
+            chunk->man = man;
+            chunk->next = NULL;
+            chunk->freecnt = 0;
+            if (j > 0) {
+                fresh[i][j - 1]->next = chunk;
             }
-            cdd_ref(bdd_node(node)->low);
-            cdd_ref(bdd_node(node)->high);
         }
-    } while (top > (ddNode**)cdd_refstacktop);
-}
+        fresh[i][n - 1]->freecnt = n * nodes - next[cdd_levelcnt];
+        s.moved += next[cdd_levelcnt];
+        for (j = 0; j < c.cnt; j++) {
+            node = c.order[j];
+            if (cdd_node2chunk(node)->man == man && c.forward[cdd_slot(node)] == NULL) {
+                pos = next[node->level]++;
+                c.forward[cdd_slot(node)] = cdd_slot_node(man, fresh[i][pos / nodes], pos % nodes);
+                memcpy(c.forward[cdd_slot(node)], node, man->nodesize);
+            }
+        }
+    }
 
-static void cdd_gbc_nodemanager(NodeManager* man)
-{
-    SubTable* tbl;
-    ddNode *node, *next, **p;
-    int64_t clk = clock();
-    int32_t i;
-    int32_t j;
+    // Redirect the children of the relocated and pinned nodes and the roots
+    for (i = 0; i < livecnt; i++) {
+        node = c.forward[cdd_slot(live[i])];
+        for (n = 0; (p = cdd_child_ref(node, n)) != NULL; n++) {
+            if (cdd_rglr(child = cdd_ptr(*p))->level != MAXLEVEL) {
+                *p = cdd_handle(cdd_neg_cond(c.forward[cdd_slot(cdd_rglr(child))], cdd_mask(child)));
+            }
+        }
+    }
+    for (i = 0; i < cdd_rootsize; i++) {
+        if (cdd_roots[i] != NULL && cdd_rglr(*cdd_roots[i])->level != MAXLEVEL) {
+            root = cdd_roots[i];
+            *root = cdd_neg_cond(c.forward[cdd_slot(cdd_rglr(*root))], cdd_mask(*root));
+        }
+    }
 
-    if (pregbc_handler != NULL) {
-        pregbc_handler();
+    // Rebuild the hash chains, as the hash of a node depends on the addresses of its children
+    for (i = 0; i < 2; i++) {
+        tables = i == 0 ? bddmanager->subtables : cdd_cddtables;
+        sentinel = i == 0 ? bddmanager->sentinel : cdd_cddsentinel;
+        for (j = 0; j < cdd_levelcnt; j++) {
+            if ((tbl = tables[j]) != NULL) {
+                for (k = 0; k < tbl->buckets; k++) {
+                    tbl->hash[k] = cdd_handle(sentinel);
+                }
+                tbl->keys = 0;
+                tbl->deadcnt = 0;
+            }
+        }
+    }
+    for (i = 0; i < livecnt; i++) {
+        node = c.forward[cdd_slot(live[i])];
+        cdd_compact_insert(cdd_node2chunk(live[i])->man, node);
     }
 
-    for (i = 0; i < cdd_levelcnt; i++) {
-        tbl = man->subtables[i];
-        if (tbl == NULL || tbl->deadcnt == 0) {
+    // Rebuild the free lists, releasing the emptied chunks beyond the retention watermark
+    s.freed = 0;
+    for (i = 0; i <= cdd_maxcddused; i++) {
+        if ((man = cdd_nodemanager(i)) == NULL) {
             continue;
         }
-        for (j = 0; j < tbl->buckets; j++) {
-            p = &(tbl->hash[j]);
-            node = *p;
-            while (node != man->sentinel) {
-                next = node->next;
-                if (node->ref == 0) {
-                    node->next = man->free;
+        nodes = (CHUNKSIZE - sizeof(Chunk)) / man->nodesize;
+        man->free = cddfalse;
+        man->freecnt = 0;
+        empty = 0;
+        q = &man->nodes;
+        while ((chunk = *q) != NULL) {
+            for (k = j = 0; j < nodes; j++) {
+                k += c.forward[chunk->freecnt + j] == cdd_slot_node(man, chunk, j);
+            }
+            if (k == 0 && empty++ >= cdd_retention) {
+                *q = chunk->next;
+                cdd_deallocate_chunk_to_os(chunk);
+                man->alloccnt -= nodes;
+                man->chunkcnt--;
+                cdd_chunkcnt--;
+                s.freed++;
+                continue;
+            }
+            for (j = nodes - 1; j >= 0; j--) {
+                node = cdd_slot_node(man, chunk, j);
+                if (c.forward[chunk->freecnt + j] != node) {
+                    node->next = cdd_handle(man->free);
                     man->free = node;
-                } else {
-                    *p = node;
-                    p = &node->next;
+                    man->freecnt++;
                 }
-                node = next;
             }
-            *p = man->sentinel;
+            q = &chunk->next;
         }
-        tbl->keys -= tbl->deadcnt;
-        tbl->deadcnt = 0;
+        for (*q = fresh[i] ? fresh[i][0] : NULL; (chunk = *q) != NULL; q = &chunk->next) {
+            for (j = nodes - 1; j >= nodes - chunk->freecnt; j--) {
+                node = cdd_slot_node(man, chunk, j);
+                node->next = cdd_handle(man->free);
+                man->free = node;
+            }
+            man->freecnt += chunk->freecnt;
+            man->alloccnt += nodes;
+            man->chunkcnt++;
+            cdd_chunkcnt++;
+        }
+        man->deadcnt = 0;
+        man->usedcnt = man->alloccnt - man->freecnt;
+        free(fresh[i]);
     }
 
+    free(c.incoming);
+    free(c.forward);
+    free(c.order);
+    free(live);
+    free(next);
+    free(fresh);
+
     clk = clock() - clk;
+    cdd_compactclock += clk;
+    cdd_compactcnt++;
 
-    man->freecnt += man->deadcnt;
-    man->deadcnt = 0;
-    man->gbccnt++;
-    man->gbcclock += clk;
+    if (postcompact_handler != NULL) {
+        s.chunks = cdd_chunkcnt;
+        s.time = clk;
+        s.sumtime = cdd_compactclock;
+        s.num = cdd_compactcnt;
+        postcompact_handler(&s);
+    }
+}
 
-    cdd_gbcclock += clk;
-    cdd_gbccnt++;
+void cdd_compact_threshold(int32_t percent)
+{
+    cdd_compaction = percent;
+    if (percent > 0 && cdd_roots == NULL) {
+        cdd_rootcnt = 0;
+        cdd_roots = (ddNode***)calloc(1024, sizeof(ddNode**));
+        if (cdd_roots == NULL) {
+            cdd_error(CDD_MEMORY);
+            return;
+        }
+        cdd_rootsize = 1024;
+    }
+}
 
-    if (postgbc_handler != NULL) {
-        CddGbcStat s;
-        s.nodes = man->alloccnt;
-        s.freenodes = man->freecnt;
-        s.time = clk;
-        s.sumtime = cdd_gbcclock;
-        s.num = cdd_gbccnt;
-        postgbc_handler(&s);
+/** Inserts \a root in the root table, which must have a free entry. */
+static void cdd_insert_root(ddNode** root)
+{
+    uint32_t i = cdd_roothash(root, cdd_rootsize);
+
+    while (cdd_roots[i] != NULL) {
+        i = (i + 1) & (cdd_rootsize - 1);
     }
+    cdd_roots[i] = root;
 }
 
-void cdd_gbc()
+void cdd_register_root(ddNode** root)
 {
-    int32_t i;
-    int64_t clk = clock();
+    ddNode ***old, ***table;
+    int32_t i, size;
 
-    cdd_operator_flush();
+    if (cdd_roots == NULL) {
+        return;
+    }
+    if (2 * (cdd_rootcnt + 1) > cdd_rootsize) {
+        table = (ddNode***)calloc(2 * (size_t)cdd_rootsize, sizeof(ddNode**));
+        if (table == NULL) {
+            /* Keep the old table. A root which does not fit is not
+             * tracked, which pins its node during compaction. */
+            cdd_error(CDD_MEMORY);
+            if (cdd_rootcnt + 1 >= cdd_rootsize) {
+                return;
+            }
+        } else {
+            old = cdd_roots;
+            size = cdd_rootsize;
+            cdd_roots = table;
+            cdd_rootsize <<= 1;
+            for (i = 0; i < size; i++) {
+                if (old[i] != NULL) {
+                    cdd_insert_root(old[i]);
+                }
+            }
+            free(old);
+        }
+    }
+    cdd_insert_root(root);
+    cdd_rootcnt++;
+}
 
-    cdd_gbcclock += clock() - clk;
+void cdd_unregister_root(ddNode** root)
+{
+    uint32_t i, j, k, mask;
 
-    // Check BDD manager
-    if (THRESHOLD * bddmanager->alloccnt >= 100 * bddmanager->freecnt &&
-        MINFREE * bddmanager->alloccnt < 100 * bddmanager->deadcnt) {
-        cdd_gbc_nodemanager(bddmanager);
+    if (cdd_roots == NULL) {
+        return;
     }
+    mask = cdd_rootsize - 1;
+    for (i = cdd_roothash(root, cdd_rootsize); cdd_roots[i] != root; i = (i + 1) & mask) {
+        if (cdd_roots[i] == NULL) {
+            return;  // Registered before roots were tracked
+        }
+    }
+    cdd_rootcnt--;
+
+    // Move entries of the probe sequence into the hole, so no tombstones are needed
+    for (j = i;;) {
+        cdd_roots[i] = NULL;
+        do {
+            j = (j + 1) & mask;
+            if (cdd_roots[j] == NULL) {
+                return;
+            }
+            k = cdd_roothash(cdd_roots[j], cdd_rootsize);
+        } while (((j - k) & mask) < ((j - i) & mask));
+        cdd_roots[i] = cdd_roots[j];
+        i = j;
+    }
+}
 
-    // Check CDD managers
-    for (i = 2; i <= cdd_maxcddused; i++) {
-        if (cddmanager[i] && THRESHOLD * cddmanager[i]->alloccnt >= 100 * cddmanager[i]->freecnt &&
-            MINFREE * cddmanager[i]->alloccnt < 100 * cddmanager[i]->deadcnt) {
-            cdd_gbc_nodemanager(cddmanager[i]);
+#ifdef CDD_CONCURRENT
+static ddNode** cdd_alloc_freenodes()
+{
+    int32_t i, n = cdd_sizeclass(cdd_maxcddsize) + 1;
+    ddNode** freenodes = (ddNode**)malloc(n * sizeof(ddNode*));
+
+    for (i = 0; freenodes != NULL && i < n; i++) {
+        freenodes[i] = cddfalse;
+    }
+    return freenodes;
+}
+
+/**
+ * Puts the free nodes of the current context back on the free lists
+ * of their node managers, taking the lock of a manager if \a locked
+ * is true. Without it, no other context may be using the managers.
+ */
+static void cdd_return_freenodes(int32_t locked)
+{
+    NodeManager* man;
+    ddNode *node, *next;
+    int32_t i;
+
+    for (i = 0; cdd_freenodes != NULL && i <= cdd_sizeclass(cdd_maxcddsize); i++) {
+        if ((node = cdd_freenodes[i]) == cddfalse) {
+            continue;
         }
+        man = cdd_nodemanager(i);
+        if (locked) {
+            cdd_lock(&man->lock);
+        }
+        for (; node != cddfalse; node = next) {
+            next = cdd_ptr(node->next);
+            node->next = cdd_handle(man->free);
+            man->free = node;
+            man->freecnt++;
+        }
+        if (locked) {
+            cdd_unlock(&man->lock);
+        }
+        cdd_freenodes[i] = cddfalse;
     }
 }
+#endif
 
-static ddNode* cdd_alloc_node(NodeManager* man)
+/**
+ * Allocates a node of \a man, the BDD node manager for \a c = 0 and
+ * the CDD node manager of size class \a c otherwise. With \c
+ * CDD_CONCURRENT, each context takes up to FREEBATCH free nodes at a
+ * time from the manager, such that its lock is not taken for every
+ * node.
+ * @return the node, or NULL if out of memory
+ */
+static ddNode* cdd_alloc_node(NodeManager* man, int32_t c)
 {
     ddNode* node;
+#ifdef CDD_CONCURRENT
+    ddNode* last;
+    int32_t n;
+
+    if ((node = cdd_freenodes[c]) != cddfalse) {
+        cdd_freenodes[c] = cdd_ptr(node->next);
+        cdd_atomic_add(man->usedcnt, 1);
+        return node;
+    }
+#endif
+
+    cdd_lock(&man->lock);
 
     // Free nodes left?
-    if (man->free == NULL) {
-        if (MINFREE * man->alloccnt < 100 * man->deadcnt) {
+    if (man->free == cddfalse) {
+        if (cdd_exclusive && MINFREE * man->alloccnt < 100 * man->deadcnt) {
 #ifdef JIT_GBC
-            cdd_operator_flush();
+            cdd_flush_caches(cdd_operator_flush);
             cdd_gbc_nodemanager(man);
 #else
             cdd_gbc();
 #endif
-        } else {
-            cdd_alloc_chunk(man);
+        }
+        if (man->free == cddfalse && !cdd_alloc_chunk(man)) {
+            cdd_unlock(&man->lock);
+            return NULL;
         }
     }
 
     // Get node from free list
     node = man->free;
-    man->free = node->next;
+#ifdef CDD_CONCURRENT
+    // Keep the rest of the batch for later allocations
+    for (last = node, n = 1; n < FREEBATCH && cdd_ptr(last->next) != cddfalse; n++) {
+        last = cdd_ptr(last->next);
+    }
+    man->free = cdd_ptr(last->next);
+    last->next = cdd_handle(cddfalse);
+    cdd_freenodes[c] = cdd_ptr(node->next);
+    man->freecnt -= n;
+#else
+    man->free = cdd_ptr(node->next);
+    man->freecnt--;
+#endif
 
     // Update counters
-    man->usedcnt++;
-    man->freecnt--;
+    cdd_atomic_add(man->usedcnt, 1);
+
+    cdd_unlock(&man->lock);
 
     return node;
 }
@@ -613,8 +2105,9 @@ static ddNode* cdd_alloc_node(NodeManager* man)
 ddNode* cdd_make_bdd_node(int32_t level, ddNode* low, ddNode* high)
 {
     bddNode* node;
-    bddNode** p;
-    int32_t bucket, cnt, mask;
+    cdd_handle_t *p, lo, hi;
+    int32_t bucket, cnt, mask, keys;
+    uint32_t hash;
     SubTable* tbl;
 
     // Eliminate redundant nodes
@@ -628,25 +2121,31 @@ ddNode* cdd_make_bdd_node(int32_t level, ddNode* low, ddNode* high)
     high = cdd_neg_cond(high, mask);
 
     // Find sub table
-    tbl = bddmanager->subtables[level];
+    tbl = cdd_load(bddmanager->subtables[level]);
     if (tbl == NULL) {
         tbl = cdd_alloc_subtable(bddmanager, level);
     }
 
     // Look for existing node
-    bucket = bddHash(low, high) >> tbl->shift;
-    p = (bddNode**)&(tbl->hash[bucket]);
-    while (low < (*p)->low) {
-        p = (bddNode**)&((*p)->next);
+    lo = cdd_handle(low);
+    hi = cdd_handle(high);
+    hash = bddHash(lo, hi);
+    cdd_lock(cdd_stripe(tbl, hash));
+    bucket = hash >> tbl->shift;
+    p = &tbl->hash[bucket];
+    while (lo < bdd_node(cdd_ptr(*p))->low) {
+        p = &cdd_ptr(*p)->next;
     }
-    while (low == (*p)->low && high < (*p)->high) {
-        p = (bddNode**)&((*p)->next);
+    while (lo == bdd_node(cdd_ptr(*p))->low && hi < bdd_node(cdd_ptr(*p))->high) {
+        p = &cdd_ptr(*p)->next;
     }
-    if (low == (*p)->low && high == (*p)->high) {
-        if ((*p)->ref == 0) {
-            cdd_reclaim((ddNode*)*p);
+    node = bdd_node(cdd_ptr(*p));
+    if (lo == node->low && hi == node->high) {
+        if (cdd_isdead(node)) {
+            cdd_reclaim((ddNode*)node);
         }
-        return cdd_neg_cond((ddNode*)*p, mask);
+        cdd_unlock(cdd_stripe(tbl, hash));
+        return cdd_neg_cond((ddNode*)node, mask);
     }
 
     // Increment references
@@ -655,32 +2154,40 @@ ddNode* cdd_make_bdd_node(int32_t level, ddNode* low, ddNode* high)
 
     // Create new node
     cnt = cdd_gbccnt;
-    node = (bddNode*)cdd_alloc_node(bddmanager);
+    node = (bddNode*)cdd_alloc_node(bddmanager, 0);
+    if (node == NULL) {
+        cdd_unlock(cdd_stripe(tbl, hash));
+        cdd_deref(low);
+        cdd_deref(high);
+        return NULL;
+    }
 
     // If garbage collection has occured we need to recalc node pos
     if (cnt != cdd_gbccnt) {
-        p = (bddNode**)&(tbl->hash[bucket]);
-        while (low < (*p)->low) {
-            p = (bddNode**)&((*p)->next);
+        p = &tbl->hash[bucket];
+        while (lo < bdd_node(cdd_ptr(*p))->low) {
+            p = &cdd_ptr(*p)->next;
         }
-        while (low == (*p)->low && high < (*p)->high) {
-            p = (bddNode**)&((*p)->next);
+        while (lo == bdd_node(cdd_ptr(*p))->low && hi < bdd_node(cdd_ptr(*p))->high) {
+            p = &cdd_ptr(*p)->next;
         }
     }
 
     // Add node to hash chain
-    node->next = (ddNode*)*p;
-    *p = node;
+    node->next = *p;
+    *p = cdd_handle((ddNode*)node);
 
     // Initialise node
     node->ref = 0;
+    node->flag = 0;
     node->level = level;
-    node->low = low;
-    node->high = high;
+    node->low = lo;
+    node->high = hi;
 
     // Check whether max keys has been reached
-    tbl->keys++;
-    if (tbl->keys > tbl->maxkeys) {
+    keys = cdd_atomic_add(tbl->keys, 1);
+    cdd_unlock(cdd_stripe(tbl, hash));
+    if (keys > cdd_load(tbl->maxkeys)) {
         cdd_rehash(bddmanager, tbl);
     }
 
@@ -691,76 +2198,107 @@ ddNode* cdd_make_cdd_node(int32_t level, Elem* elem, int32_t len)
 {
     SubTable* tbl;
     NodeManager* man;
-    int32_t bucket, i, size;
+    int32_t bucket, i, size, keys, c;
+    uint32_t hash;
     cddNode* node;
-    cddNode** p;
+    cddNode* key = cdd_key;
+    cdd_handle_t* p;
 
     if (len > cdd_maxcddsize) {
-        cdd_error(CDD_MAXSIZE);
+        cdd_errorcond = cdd_error(CDD_MAXSIZE);
         return NULL;
     }
 
     // Eliminate redundant nodes
     if (len == 1) {
-        return elem[0].child;
+        return cdd_ptr(elem[0].child);
     }
 
-    // Find manager and subtable
-    man = cddmanager[len];
+    // Split the elements into bounds and children. The padding is
+    // cleared, as nodes are hashed and compared bytewise.
+    key->len = len;
+    memset((char*)key->bnd + cdd_boundsize(len) - sizeof(cdd_handle_t), 0, sizeof(cdd_handle_t));
+    for (i = 0; i < len; i++) {
+        key->bnd[i] = elem[i].bnd;
+        cdd_children(key)[i] = elem[i].child;
+    }
+
+    // Find manager of the size class and the shared subtable
+    c = cdd_sizeclass(len);
+    man = cdd_load(cddmanager[c]);
     if (man == NULL) {
-        size = sizeof(cddNode) + sizeof(Elem) * len;
-        man = cddmanager[len] = cdd_alloc_nodemanager(size, cdd_hash_func);
-        if (len > cdd_maxcddused) {
-            cdd_maxcddused = len;
+        cdd_lock(&cdd_structure_lock);
+        if ((man = cddmanager[c]) == NULL) {
+            size = sizeof(cddNode) + cdd_elemsize(cdd_classsize(c));
+            man = cdd_alloc_nodemanager(size, cdd_hash_func, cdd_cddtables, cdd_cddsentinel);
+            cdd_store(cddmanager[c], man);
+            if (c > cdd_maxcddused) {
+                cdd_maxcddused = c;
+            }
         }
+        cdd_unlock(&cdd_structure_lock);
     }
-    tbl = man->subtables[level];
+    tbl = cdd_load(man->subtables[level]);
     if (tbl == NULL) {
         tbl = cdd_alloc_subtable(man, level);
     }
 
     // Look for existing node
-    bucket = cddHash(elem, len) >> tbl->shift;
-    p = (cddNode**)&(tbl->hash[bucket]);
-    while ((i = memcmp(elem, (*p)->elem, len * sizeof(Elem))) < 0) {
-        p = (cddNode**)&((*p)->next);
+    hash = cddHash(key, len);
+    cdd_lock(cdd_stripe(tbl, hash));
+    bucket = hash >> tbl->shift;
+    p = &tbl->hash[bucket];
+    while ((i = cdd_elemcmp(key, cdd_node(cdd_ptr(*p)))) < 0) {
+        p = &cdd_ptr(*p)->next;
     }
     if (i == 0) {
-        if ((*p)->ref == 0) {
-            cdd_reclaim((ddNode*)*p);
+        node = cdd_node(cdd_ptr(*p));
+        if (cdd_isdead(node)) {
+            cdd_reclaim((ddNode*)node);
         }
-        return (ddNode*)*p;
+        cdd_unlock(cdd_stripe(tbl, hash));
+        return (ddNode*)node;
     }
 
     // Increment references
     for (i = 0; i < len; i++) {
-        cdd_ref(elem[i].child);
+        cdd_ref(cdd_ptr(elem[i].child));
     }
 
     // Alloc node
     i = cdd_gbccnt;
-    node = (cddNode*)cdd_alloc_node(man);
+    node = (cddNode*)cdd_alloc_node(man, c);
+    if (node == NULL) {
+        cdd_unlock(cdd_stripe(tbl, hash));
+        for (i = 0; i < len; i++) {
+            cdd_deref(cdd_ptr(elem[i].child));
+        }
+        return NULL;
+    }
 
     // If garbage collection has occured we need to recalc the node pos
     if (i != cdd_gbccnt) {
-        p = (cddNode**)&(tbl->hash[bucket]);
-        while (memcmp(elem, (*p)->elem, len * sizeof(Elem)) < 0) {
-            p = (cddNode**)&((*p)->next);
+        p = &tbl->hash[bucket];
+        while (cdd_elemcmp(key, cdd_node(cdd_ptr(*p))) < 0) {
+            p = &cdd_ptr(*p)->next;
         }
     }
 
     // Add node to hash chain
-    node->next = (ddNode*)*p;
-    *p = node;
+    node->next = *p;
+    *p = cdd_handle((ddNode*)node);
 
     // Initialise node
     node->level = level;
     node->ref = 0;
-    memcpy(node->elem, elem, sizeof(Elem) * len);
+    node->flag = 0;
+    node->len = len;
+    memcpy(node->bnd, key->bnd, cdd_elemsize(len));
 
     // Check whether max keys has been reached
-    tbl->keys++;
-    if (tbl->keys > tbl->maxkeys) {
+    keys = cdd_atomic_add(tbl->keys, 1);
+    cdd_unlock(cdd_stripe(tbl, hash));
+    if (keys > cdd_load(tbl->maxkeys)) {
         cdd_rehash(man, tbl);
     }
 
@@ -769,12 +2307,16 @@ ddNode* cdd_make_cdd_node(int32_t level, Elem* elem, int32_t len)
 
 void cdd_pregbc_hook(void (*func)(void)) { pregbc_handler = func; }
 
+void cdd_chunk_retention(int32_t chunks) { cdd_retention = chunks; }
+
 void cdd_postgbc_hook(void (*func)(CddGbcStat*)) { postgbc_handler = func; }
 
 void cdd_prerehash_hook(void (*func)(void)) { prerehash_handler = func; }
 
 void cdd_postrehash_hook(void (*func)(CddRehashStat*)) { postrehash_handler = func; }
 
+void cdd_postcompact_hook(void (*func)(CddCompactStat*)) { postcompact_handler = func; }
+
 const char* cdd_versionstr()
 {
     static char str[100];
@@ -797,52 +2339,77 @@ void cdd_default_rehashhandler(CddRehashStat* s)
             s->buckets, s->keys, s->max, ((double)s->time) / CLOCKS_PER_SEC, ((double)s->sumtime) / CLOCKS_PER_SEC);
 }
 
+void cdd_default_compacthandler(CddCompactStat* s)
+{
+    fprintf(stderr, "Compaction #%d: %d moved / %d pinned / %d chunks / %d freed / %.1fs / %.1fs total\n", s->num,
+            s->moved, s->pinned, s->chunks, s->freed, ((double)s->time) / CLOCKS_PER_SEC,
+            ((double)s->sumtime) / CLOCKS_PER_SEC);
+}
+
 /* Doubles the size of the hash table */
 static void cdd_rehash(NodeManager* man, SubTable* tbl)
 {
     int32_t i, bucket;
     int32_t oldsize;
-    ddNode **p, **q, *node, **oldhash;
+    cdd_handle_t *p, *q, *oldhash;
+    ddNode* node;
     int64_t clk = clock();
+    CddRehashStat s;
+
+#ifdef CDD_CONCURRENT
+    // Several threads may have seen the table overflow
+    for (i = 0; i < CDD_STRIPES; i++) {
+        cdd_lock(&tbl->lock[i]);
+    }
+    if (tbl->keys <= tbl->maxkeys) {
+        for (i = 0; i < CDD_STRIPES; i++) {
+            cdd_unlock(&tbl->lock[i]);
+        }
+        return;
+    }
+#endif
 
     oldsize = tbl->buckets;
     oldhash = tbl->hash;
     tbl->buckets <<= 1;
-    tbl->maxkeys <<= 1;
+    cdd_store(tbl->maxkeys, tbl->maxkeys << 1);
     tbl->shift -= 1;
-    tbl->hash = malloc(tbl->buckets * sizeof(ddNode*));
+    tbl->hash = malloc(tbl->buckets * sizeof(cdd_handle_t));
 
     for (i = 0; i < oldsize; i++) {
         p = &(tbl->hash[i << 1]);
         q = p + 1;
-        for (node = oldhash[i]; node != man->sentinel; node = node->next) {
+        for (node = cdd_ptr(oldhash[i]); node != man->sentinel; node = cdd_ptr(node->next)) {
             bucket = man->hashfunc(man, node) >> tbl->shift;
             if (bucket & 0x1) {
-                *q = node;
+                *q = cdd_handle(node);
                 q = &(node->next);
             } else {
-                *p = node;
+                *p = cdd_handle(node);
                 p = &(node->next);
             }
         }
-        *p = *q = man->sentinel;
+        *p = *q = cdd_handle(man->sentinel);
     }
 
     free(oldhash);
 
     clk = clock() - clk;
-    cdd_rehashclock += clk;
-    cdd_rehashcnt++;
+    s.level = tbl->level;
+    s.buckets = tbl->buckets;
+    s.keys = tbl->keys;
+    s.max = tbl->maxkeys;
+    s.time = clk;
+    s.sumtime = cdd_atomic_add(cdd_rehashclock, clk);
+    s.num = cdd_atomic_add(cdd_rehashcnt, 1);
+
+#ifdef CDD_CONCURRENT
+    for (i = 0; i < CDD_STRIPES; i++) {
+        cdd_unlock(&tbl->lock[i]);
+    }
+#endif
 
     if (postgbc_handler != NULL) {
-        CddRehashStat s;
-        s.level = tbl->level;
-        s.buckets = tbl->buckets;
-        s.keys = tbl->keys;
-        s.max = tbl->maxkeys;
-        s.time = clk;
-        s.sumtime = cdd_rehashclock;
-        s.num = cdd_rehashcnt;
         postrehash_handler(&s);
     }
 }
@@ -852,24 +2419,27 @@ ddNode* cdd_bddvar(int32_t level) { return cdd_make_bdd_node(level, cddfalse, cd
 ddNode* cdd_interval_from_level(int32_t level, raw_t low, raw_t high)
 {
     Elem* top = cdd_refstacktop;
+    ddNode* res;
     if (low > -INF) {
         cdd_push(cddfalse, low);
         cdd_push(cddtrue, high);
         if (high < INF)
             cdd_push(cddfalse, INF);
         cdd_refstacktop = top;
-        return cdd_make_cdd_node(level, top, 2 + (high < INF));
+        return cdd_errorcond ? NULL : cdd_make_cdd_node(level, top, 2 + (high < INF));
     } else {
         cdd_push(cddfalse, high);
         cdd_push(cddtrue, INF);
         cdd_refstacktop = top;
-        return cdd_neg(cdd_make_cdd_node(level, top, 2));
+        res = cdd_errorcond ? NULL : cdd_make_cdd_node(level, top, 2);
+        return res == NULL ? NULL : cdd_neg(res);
     }
 }
 
 ddNode* cdd_upper_from_level(int32_t level, raw_t bnd)
 {
     Elem* top = cdd_refstacktop;
+    ddNode* res;
     if (bnd == INF) {
         return cddtrue;
     } else if (bnd == -INF) {
@@ -878,7 +2448,8 @@ ddNode* cdd_upper_from_level(int32_t level, raw_t bnd)
     cdd_push(cddfalse, bnd);
     cdd_push(cddtrue, INF);
     cdd_refstacktop = top;
-    return cdd_neg(cdd_make_cdd_node(level, top, 2));
+    res = cdd_errorcond ? NULL : cdd_make_cdd_node(level, top, 2);
+    return res == NULL ? NULL : cdd_neg(res);
 }
 
 ddNode* cdd_interval(int32_t i, int32_t j, raw_t low, raw_t high)
@@ -889,10 +2460,12 @@ ddNode* cdd_interval(int32_t i, int32_t j, raw_t low, raw_t high)
 
 ddNode* cdd_upper(int32_t i, int32_t j, raw_t bnd)
 {
+    ddNode* res;
     if (i > j) {
         return cdd_upper_from_level(cdd_diff2level[cdd_difference(i, j)], bnd);
     } else {
-        return cdd_neg(cdd_upper_from_level(cdd_diff2level[cdd_difference(j, i)], bnd_u2l(bnd)));
+        res = cdd_upper_from_level(cdd_diff2level[cdd_difference(j, i)], bnd_u2l(bnd));
+        return res == NULL ? NULL : cdd_neg(res);
     }
 }
 
@@ -910,7 +2483,7 @@ void cdd_mark(ddNode* node)
         for (cdd_it_init(it, node); !cdd_it_atend(it); cdd_it_next(it))
             cdd_mark(cdd_it_child(it));
         break;
-    case TYPE_BDD: cdd_mark(bdd_node(node)->low); cdd_mark(bdd_node(node)->high);
+    case TYPE_BDD: cdd_mark(cdd_ptr(bdd_node(node)->low)); cdd_mark(cdd_ptr(bdd_node(node)->high));
     }
 }
 
@@ -929,7 +2502,7 @@ void cdd_markcount(ddNode* node, int32_t* cnt)
         for (cdd_it_init(it, node); !cdd_it_atend(it); cdd_it_next(it))
             cdd_markcount(cdd_it_child(it), cnt);
         break;
-    case TYPE_BDD: cdd_markcount(bdd_node(node)->low, cnt); cdd_markcount(bdd_node(node)->high, cnt);
+    case TYPE_BDD: cdd_markcount(cdd_ptr(bdd_node(node)->low), cnt); cdd_markcount(cdd_ptr(bdd_node(node)->high), cnt);
     }
 }
 
@@ -951,8 +2524,8 @@ void cdd_markedgecount(ddNode* node, int32_t* cnt)
         break;
     case TYPE_BDD:
         (*cnt) += 2;
-        cdd_markedgecount(bdd_node(node)->low, cnt);
-        cdd_markedgecount(bdd_node(node)->high, cnt);
+        cdd_markedgecount(cdd_ptr(bdd_node(node)->low), cnt);
+        cdd_markedgecount(cdd_ptr(bdd_node(node)->high), cnt);
     }
 }
 
@@ -976,7 +2549,7 @@ void cdd_unmark(ddNode* node)
         for (cdd_it_init(it, node); !cdd_it_atend(it); cdd_it_next(it))
             cdd_unmark(cdd_it_child(it));
         break;
-    case TYPE_BDD: cdd_unmark(bdd_node(node)->low); cdd_unmark(bdd_node(node)->high);
+    case TYPE_BDD: cdd_unmark(cdd_ptr(bdd_node(node)->low)); cdd_unmark(cdd_ptr(bdd_node(node)->high));
     }
 }
 
@@ -1002,7 +2575,7 @@ void cdd_force_unmark(ddNode* node)
         for (cdd_it_init(it, node); !cdd_it_atend(it); cdd_it_next(it))
             cdd_force_unmark(cdd_it_child(it));
         break;
-    case TYPE_BDD: cdd_force_unmark(bdd_node(node)->low); cdd_force_unmark(bdd_node(node)->high);
+    case TYPE_BDD: cdd_force_unmark(cdd_ptr(bdd_node(node)->low)); cdd_force_unmark(cdd_ptr(bdd_node(node)->high));
     }
 }
 
@@ -1030,9 +2603,15 @@ static void add_levels(int32_t n)
 {
     int32_t i;
     add_levels_to_nodemanager(bddmanager, n);
-    for (i = 0; i < cdd_maxcddsize; i++) {
+
+    // The CDD node managers share their subtables
+    cdd_cddtables = realloc(cdd_cddtables, (cdd_levelcnt + n) * sizeof(SubTable*));
+    for (i = cdd_levelcnt; i < cdd_levelcnt + n; i++) {
+        cdd_cddtables[i] = NULL;
+    }
+    for (i = 1; i <= cdd_maxcddused; i++) {
         if (cddmanager[i]) {
-            add_levels_to_nodemanager(cddmanager[i], n);
+            cddmanager[i]->subtables = cdd_cddtables;
         }
     }
 }
@@ -1098,8 +2677,8 @@ int32_t cdd_get_bdd_level_count() { return cdd_varnum; }
 void cdd_dump_nodes()
 {
     SubTable* tbl;
-    ddNode *node, **p;
-    int32_t i, j, k;
+    ddNode* node;
+    int32_t i, j;
 
     fprintf(stdout, "\"%p\" [true]\n", cddfalse);
 
@@ -1107,32 +2686,26 @@ void cdd_dump_nodes()
         tbl = bddmanager->subtables[i];
         if (tbl) {
             for (j = 0; j < tbl->buckets; j++) {
-                p = &(tbl->hash[j]);
-                node = *p;
+                node = cdd_ptr(tbl->hash[j]);
                 while (node != bddmanager->sentinel) {
                     if (node->ref != 0) {
                         fprintf(stdout, "\"%p\" [level %d]\n", node, node->level);
                     }
-                    node = node->next;
+                    node = cdd_ptr(node->next);
                 }
             }
         }
 
-        for (k = 0; k < cdd_maxcddsize; k++) {
-            if (cddmanager[k]) {
-                tbl = cddmanager[k]->subtables[i];
-                if (tbl) {
-                    for (j = 0; j < tbl->buckets; j++) {
-                        p = &(tbl->hash[j]);
-                        node = *p;
-                        while (node != cddmanager[k]->sentinel) {
-                            if (node->ref != 0) {
-                                fprintf(stdout, "\"%p\" [level %d : %d-%d]\n", node, node->level,
-                                        cdd_info(node)->clock1, cdd_info(node)->clock2);
-                            }
-                            node = node->next;
-                        }
+        tbl = cdd_cddtables[i];
+        if (tbl) {
+            for (j = 0; j < tbl->buckets; j++) {
+                node = cdd_ptr(tbl->hash[j]);
+                while (node != cdd_cddsentinel) {
+                    if (node->ref != 0) {
+                        fprintf(stdout, "\"%p\" [level %d : %d-%d]\n", node, node->level, cdd_info(node)->clock1,
+                                cdd_info(node)->clock2);
                     }
+                    node = cdd_ptr(node->next);
                 }
             }
         }
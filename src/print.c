@@ -137,6 +137,8 @@ static void cdd_fprintdot_rec(FILE* ofile, ddNode* r, bool flip_negated, bool ne
 
     if (cdd_info(r)->type == TYPE_BDD) {
         bddNode* node = bdd_node(r);
+        ddNode* low = cdd_ptr(node->low);
+        ddNode* high = cdd_ptr(node->high);
 
         // We annotate each location in the dot file with a 0 if it was reached with an even number of negations,
         // and with a 1 if it was reached with an odd number of negations.
@@ -154,9 +156,9 @@ static void cdd_fprintdot_rec(FILE* ofile, ddNode* r, bool flip_negated, bool ne
         }
 
         // Terminal children nodes don't need the annotation.
-        if (cdd_isterminal((void*)node->high))
+        if (cdd_isterminal((void*)high))
             high_neg_appendix = "";
-        if (cdd_isterminal((void*)node->low))
+        if (cdd_isterminal((void*)low))
             low_neg_appendix = "";
 
         // Check whether we already reached this node via an array of strings keeping track of the pointers plus
@@ -172,32 +174,32 @@ static void cdd_fprintdot_rec(FILE* ofile, ddNode* r, bool flip_negated, bool ne
                     node_color, node->level);
 
             // Print arrow to high.
-            if (flip_negated && (negated ^ cdd_is_negated(r)) && cdd_isterminal((void*)node->high)) {
+            if (flip_negated && (negated ^ cdd_is_negated(r)) && cdd_isterminal((void*)high)) {
                 // Flip arrow to the negated terminal if we had negation.
                 fprintf(ofile, "\"%p%s\" -> \"%p\" [style=\"filled", (void*)r, current_neg_appendix,
-                        cdd_neg((void*)node->high));
+                        cdd_neg((void*)high));
                 fprintf(ofile, "\"];\n");
             } else {
                 // Print normal arrows with annotation for children.
                 fprintf(ofile, "\"%p%s\" -> \"%p%s\" [style=\"filled", (void*)r, current_neg_appendix,
-                        (void*)node->high, high_neg_appendix);
+                        (void*)high, high_neg_appendix);
                 fprintf(ofile, "\"];\n");
             }
             // Print arrow to low.
-            if (flip_negated && (negated ^ cdd_is_negated(r)) && cdd_isterminal((void*)node->low)) {
+            if (flip_negated && (negated ^ cdd_is_negated(r)) && cdd_isterminal((void*)low)) {
                 // Flip arrow to the negated terminal if we had negation.
                 fprintf(ofile, "\"%p%s\" -> \"%p\" [style=\"dashed", (void*)r, current_neg_appendix,
-                        cdd_neg((void*)node->low));
+                        cdd_neg((void*)low));
                 fprintf(ofile, "\"];\n");
             } else {
                 // Print normal arrows with annotation for children.
-                fprintf(ofile, "\"%p%s\" -> \"%p%s\" [style=\"dashed", (void*)r, current_neg_appendix, (void*)node->low,
+                fprintf(ofile, "\"%p%s\" -> \"%p%s\" [style=\"dashed", (void*)r, current_neg_appendix, (void*)low,
                         low_neg_appendix);
                 fprintf(ofile, "\"];\n");
             }
 
-            cdd_fprintdot_rec(ofile, node->high, flip_negated, negated ^ cdd_is_negated(r), a);
-            cdd_fprintdot_rec(ofile, node->low, flip_negated, negated ^ cdd_is_negated(r), a);
+            cdd_fprintdot_rec(ofile, high, flip_negated, negated ^ cdd_is_negated(r), a);
+            cdd_fprintdot_rec(ofile, low, flip_negated, negated ^ cdd_is_negated(r), a);
         }
 
     } else {
@@ -208,7 +210,8 @@ static void cdd_fprintdot_rec(FILE* ofile, ddNode* r, bool flip_negated, bool ne
 
         raw_t bnd = -INF;
         cddNode* node = cdd_node(r);
-        Elem* p = node->elem;
+        raw_t* b = node->bnd;
+        cdd_handle_t* c = cdd_children(node);
 
         char* current_neg_appendix = "0";
         char* child_neg_appendix = "0";
@@ -225,7 +228,7 @@ static void cdd_fprintdot_rec(FILE* ofile, ddNode* r, bool flip_negated, bool ne
                 node_color, cdd_info(node)->clock1, cdd_info(node)->clock2);
 
         do {
-            ddNode* child = p->child;
+            ddNode* child = cdd_ptr(*c);
             if (child != cddfalse) {
                 // Terminal children nodes don't need the annotation.
                 if (child == cddtrue) {
@@ -234,13 +237,14 @@ static void cdd_fprintdot_rec(FILE* ofile, ddNode* r, bool flip_negated, bool ne
 
                 fprintf(ofile, "\"%p%s\" -> \"%p%s\" [style=%s, label=\"", (void*)r, current_neg_appendix,
                         (void*)(child), child_neg_appendix, cdd_mask(child) ? "dashed" : "filled");
-                printInterval(ofile, bnd, p->bnd);
+                printInterval(ofile, bnd, *b);
                 fprintf(ofile, "\"];\n");
 
                 cdd_fprintdot_rec(ofile, child, flip_negated, negated ^ cdd_is_negated(r), a);
             }
-            bnd = p->bnd;
-            p++;
+            bnd = *b;
+            b++;
+            c++;
         } while (bnd < INF);
     }
 
@@ -327,10 +331,12 @@ static void cdd_freduce_dump_rec(FILE* ofile, int maskSize, ddNode* r, infor* pa
 
     if (info->type != TYPE_BDD) {
         cddNode* node = cdd_node(r);
-        Elem* p;
+        raw_t* b;
+        cdd_handle_t* c;
         raw_t bnd;
         int ifstatement = 0;
-        p = node->elem;
+        b = node->bnd;
+        c = cdd_children(node);
         bnd = -INF;
         const LevelInfo* levinf = cdd_get_levelinfo(node->level);
 
@@ -341,14 +347,14 @@ static void cdd_freduce_dump_rec(FILE* ofile, int maskSize, ddNode* r, infor* pa
         }
 
         do {
-            ddNode* child = p->child;
+            ddNode* child = cdd_ptr(*c);
             if (child != cddfalse) {
                 cdd_freduce_dump_rec(ofile, maskSize, cdd_rglr(child), NULL, labelPrinter, clockPrinter, data,
                                      dotFormat);
                 if (dotFormat) {
                     fprintf(ofile, "\"%p\" -> \"%p\" [style=%s, label=\"", (void*)node, (void*)cdd_rglr(child),
                             cdd_mask(child) ? "dashed" : "filled");
-                    printInterval(ofile, bnd, p->bnd);
+                    printInterval(ofile, bnd, *b);
                     fprintf(ofile, "\"];\n");
                 } else {
                     raw_t lower = bnd_l2u(bnd);
@@ -356,18 +362,19 @@ static void cdd_freduce_dump_rec(FILE* ofile, int maskSize, ddNode* r, infor* pa
                     ifstatement = 1;
                     clockPrinter(ofile, levinf->clock1, levinf->clock2, data);
                     fprintf(ofile, "%s%d", dbm_rawIsWeak(lower) ? ">=" : ">", -dbm_raw2bound(lower));
-                    if (p->bnd != dbm_LS_INFINITY) {
+                    if (*b != dbm_LS_INFINITY) {
                         fprintf(ofile, " && ");
                         clockPrinter(ofile, levinf->clock1, levinf->clock2, data);
-                        fprintf(ofile, "%s%d", dbm_rawIsWeak(p->bnd) ? "<=" : "<", dbm_raw2bound(p->bnd));
+                        fprintf(ofile, "%s%d", dbm_rawIsWeak(*b) ? "<=" : "<", dbm_raw2bound(*b));
                     }
                     fprintf(ofile, ") goto ");
                     print_node2label(ofile, cdd_rglr(child));
                     fprintf(ofile, ";\n");
                 }
             }
-            bnd = p->bnd;
-            p++;
+            bnd = *b;
+            b++;
+            c++;
         } while (bnd < INF);
 
         if (ifstatement) {
@@ -377,11 +384,13 @@ static void cdd_freduce_dump_rec(FILE* ofile, int maskSize, ddNode* r, infor* pa
         cdd_setmark(r);
     } else {
         bddNode* node = bdd_node(r);
-        if (parentInfo == NULL || (parentInfo->other != node->high && parentInfo->other != node->low)) {
+        ddNode* low = cdd_ptr(node->low);
+        ddNode* high = cdd_ptr(node->high);
+        if (parentInfo == NULL || (parentInfo->other != high && parentInfo->other != low)) {
             // No possible reduction, start exploration by low child
             infor myInfo;
-            myInfo.current = node->low;
-            myInfo.other = node->high;
+            myInfo.current = low;
+            myInfo.other = high;
             myInfo.mask = malloc(maskSize * sizeof(uint32_t));
             myInfo.value = malloc(maskSize * sizeof(uint32_t));
             int k;
@@ -391,18 +400,18 @@ static void cdd_freduce_dump_rec(FILE* ofile, int maskSize, ddNode* r, infor* pa
             }
             base_setOneBit(myInfo.mask, node->level);
             myInfo.stringFound = false;
-            cdd_freduce_dump_rec(ofile, maskSize, node->low, &myInfo, labelPrinter, clockPrinter, data, dotFormat);
+            cdd_freduce_dump_rec(ofile, maskSize, low, &myInfo, labelPrinter, clockPrinter, data, dotFormat);
 
             // Exploration of high child
             if (myInfo.stringFound) {
                 // Do not search for any string in high child
-                cdd_freduce_dump_rec(ofile, maskSize, node->high, NULL, labelPrinter, clockPrinter, data, dotFormat);
+                cdd_freduce_dump_rec(ofile, maskSize, high, NULL, labelPrinter, clockPrinter, data, dotFormat);
             } else {
                 assert(*(myInfo.value) == 0);
-                myInfo.current = node->high;
-                myInfo.other = node->low;
+                myInfo.current = high;
+                myInfo.other = low;
                 base_setOneBit(myInfo.value, node->level);
-                cdd_freduce_dump_rec(ofile, maskSize, node->high, &myInfo, labelPrinter, clockPrinter, data, dotFormat);
+                cdd_freduce_dump_rec(ofile, maskSize, high, &myInfo, labelPrinter, clockPrinter, data, dotFormat);
             }
 
             // Print node, mask, value, and children
@@ -436,18 +445,16 @@ static void cdd_freduce_dump_rec(FILE* ofile, int maskSize, ddNode* r, infor* pa
         } else {
             parentInfo->stringFound = true;
             base_setOneBit(parentInfo->mask, node->level);
-            if (parentInfo->other == node->high) {
-                parentInfo->current = node->low;
-                cdd_freduce_dump_rec(ofile, maskSize, node->low, parentInfo, labelPrinter, clockPrinter, data,
-                                     dotFormat);
-                cdd_freduce_dump_rec(ofile, maskSize, node->high, NULL, labelPrinter, clockPrinter, data, dotFormat);
+            if (parentInfo->other == high) {
+                parentInfo->current = low;
+                cdd_freduce_dump_rec(ofile, maskSize, low, parentInfo, labelPrinter, clockPrinter, data, dotFormat);
+                cdd_freduce_dump_rec(ofile, maskSize, high, NULL, labelPrinter, clockPrinter, data, dotFormat);
             } else {
-                assert(parentInfo->other == node->low);
-                parentInfo->current = node->high;
+                assert(parentInfo->other == low);
+                parentInfo->current = high;
                 base_setOneBit(parentInfo->value, node->level);
-                cdd_freduce_dump_rec(ofile, maskSize, node->high, parentInfo, labelPrinter, clockPrinter, data,
-                                     dotFormat);
-                cdd_freduce_dump_rec(ofile, maskSize, node->low, NULL, labelPrinter, clockPrinter, data, dotFormat);
+                cdd_freduce_dump_rec(ofile, maskSize, high, parentInfo, labelPrinter, clockPrinter, data, dotFormat);
+                cdd_freduce_dump_rec(ofile, maskSize, low, NULL, labelPrinter, clockPrinter, data, dotFormat);
             }
         }
     }
@@ -23,6 +23,10 @@ int CddRelaxCache_init(CddRelaxCache* cache, int size)
 
     memset(cache->table, 0, sizeof(CddRelaxCacheData) * size);
     cache->tablesize = size;
+    cache->epoch = 1;
+#ifdef CDD_CACHESTATS
+    memset(&cache->stat, 0, sizeof(CddCacheStat));
+#endif
 
     return 0;
 }
@@ -38,3 +42,12 @@ void CddRelaxCache_reset(CddRelaxCache* cache)
 {
     memset(cache->table, 0, cache->tablesize * sizeof(CddRelaxCacheData));
 }
+
+/* Voids all entries by starting a new epoch */
+void CddRelaxCache_flush(CddRelaxCache* cache)
+{
+    if (++cache->epoch == 0) {
+        CddRelaxCache_reset(cache);
+        cache->epoch = 1;
+    }
+}
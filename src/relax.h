@@ -12,16 +12,25 @@ typedef struct
     int clock1;
     int clock2;
     int op;
+    unsigned epoch;
 } CddRelaxCacheData;
 
 typedef struct
 {
     CddRelaxCacheData* table;
     int tablesize;
+    unsigned epoch;
+#ifdef CDD_CACHESTATS
+    CddCacheStat stat;
+#endif
 } CddRelaxCache;
 
 int CddRelaxCache_init(CddRelaxCache*, int);
 void CddRelaxCache_reset(CddRelaxCache*);
+void CddRelaxCache_flush(CddRelaxCache*);
 void CddRelaxCache_done(CddRelaxCache*);
 
+/* Returns the entry for the given hash value, which you can assign to. */
+#define CddRelaxCache_lookup(cache, hash) (CddCache_count(cache, lookups), &(cache)->table[(hash) % (cache)->tablesize])
+
 #endif
@@ -25,9 +25,13 @@
 #include <doctest/doctest.h>
 
 #include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 #include <cstdio>
 #include <cstdlib>
 
+#include <dbm/fed.h>
 #include <dbm/print.h>
 
 using std::endl;
@@ -105,6 +109,58 @@ std::ostream& operator<<(std::ostream& os, const dbm_wrap& d)
     return os << "}";
 }
 
+/**
+ * Initialises the library for the lifetime of the object. Declare it
+ * before the cdds of a test, so that they are released before cdd_done().
+ */
+struct cdd_session
+{
+    cdd_session(int32_t clocks, int32_t bools)
+    {
+        cdd_init(100000, 10000, 10000);
+        cdd_add_clocks(clocks);
+        cdd_add_bddvar(bools);
+    }
+    ~cdd_session() { cdd_done(); }
+    cdd_session(const cdd_session&) = delete;
+    cdd_session& operator=(const cdd_session&) = delete;
+};
+
+/** Returns the constraint x_i - x_j <= bound. */
+static cdd at_most(int32_t i, int32_t j, int32_t bound) { return cdd_upperpp(i, j, dbm_bound2raw(bound, dbm_WEAK)); }
+
+/** Returns the constraint x_i - x_j >= bound. */
+static cdd at_least(int32_t i, int32_t j, int32_t bound) { return cdd_lowerpp(i, j, dbm_bound2raw(bound, dbm_STRICT)); }
+
+/** Returns the zone holding only the valuation x1 = \a x1, x2 = \a x2. */
+static dbm_wrap point(int32_t x1, int32_t x2)
+{
+    auto dbm = dbm_wrap{3};
+    dbm_init(dbm.raw(), 3);
+    dbm_constrainClock(dbm.raw(), 3, 1, x1);
+    dbm_constrainClock(dbm.raw(), 3, 2, x2);
+    return dbm;
+}
+
+/** Two clocks, three booleans and a few CDDs shared by the tests of the CDD operators. */
+struct cdd_sample : cdd_session
+{
+    cdd_sample(): cdd_session{3, 3} {}
+
+    cdd b0 = cdd_bddvarpp(bdd_start_level);
+    cdd b1 = cdd_bddvarpp(bdd_start_level + 1);
+    cdd b2 = cdd_bddvarpp(bdd_start_level + 2);
+    /** 2 <= x1 <= 10 */
+    cdd x1_range = at_least(1, 0, 2) & at_most(1, 0, 10);
+    /** 4 <= x2 <= 8 */
+    cdd x2_range = at_least(2, 0, 4) & at_most(2, 0, 8);
+    cdd a = x1_range | x2_range;
+    /** 0 <= x2 - x1 <= 6 */
+    cdd b = at_least(2, 1, 0) & at_most(2, 1, 6);
+    /** x1 <= 1 and x2 >= 3 and x2 - x1 <= 1, which no valuation satisfies */
+    cdd empty = at_most(1, 0, 1) & at_least(2, 0, 3) & at_most(2, 1, 1);
+};
+
 /** Generate a random cdd with only BDD nodes. */
 static cdd generate_bdd(size_t size)
 {
@@ -971,6 +1027,25 @@ TEST_CASE("CDD timed predecessor static test")
     cdd_done();
 }
 
+TEST_CASE("CDD timed predecessor with many booleans")
+{
+    auto session = cdd_session{2, 24};
+    cdd b0 = cdd_bddvarpp(bdd_start_level), b1 = cdd_bddvarpp(bdd_start_level + 1);
+    cdd bad = cdd_remove_negative(cdd_intervalpp(1, 0, 10, 20));
+    cdd good = cdd_remove_negative(cdd_intervalpp(1, 0, 4, 12));
+
+    // Only the valuations of b0 and b1 matter, the other 22 booleans are free
+    cdd result = cdd_predt(bad & b0, good & !b1);
+    cdd expected = (cdd_past(bad) & b0 & b1) | (cdd_predt(bad, good) & b0 & !b1);
+    REQUIRE(cdd_equiv(result, expected));
+
+    // The predecessors of a union of targets are the union of their predecessors
+    cdd bad2 = cdd_remove_negative(cdd_intervalpp(1, 0, 0, 6));
+    cdd safe = (good & !b1) | (bad2 & b0 & b1);
+    cdd target = (bad & b0) | (bad2 & !b0);
+    REQUIRE(cdd_equiv(cdd_predt(target, safe), cdd_predt(bad & b0, safe) | cdd_predt(bad2 & !b0, safe)));
+}
+
 bool equal(int32_t* arr1, int32_t* arr2, int size)
 {
     for (int i = 0; i < size; ++i) {
@@ -1053,6 +1128,844 @@ TEST_CASE("CDD reduce with size 3")
 }
 #endif /* 32-bit */
 
+/** Builds and combines a few CDDs in a fresh context of its own. */
+static void context_worker(int32_t clocks, bool* ok)
+{
+    cdd_context* ctx = cdd_context_create();
+    cdd_context_set(ctx);
+    cdd_init(100000, 10000, 10000);
+    cdd_add_clocks(clocks);
+    cdd_add_bddvar(2);
+    {
+        bool result = cdd_clocknum == clocks;
+        for (int32_t k = 0; k < 200; ++k) {
+            cdd a = cdd_intervalpp(1, 0, 0, 2 * k + 1) & cdd_bddvarpp(bdd_start_level);
+            cdd b = cdd_intervalpp(clocks - 1, 0, k, dbm_LS_INFINITY) | cdd_bddnvarpp(bdd_start_level + 1);
+            result = result && cdd_equiv(a & b, b & a) && cdd_reduce(a - a) == cdd_false();
+        }
+        *ok = result;
+    }
+    cdd_context_destroy(ctx);
+}
+
+TEST_CASE("CDD independent contexts")
+{
+    cdd_init(100000, 10000, 10000);
+    cdd_add_clocks(3);
+    cdd_add_bddvar(3);
+    {
+        cdd c = cdd_intervalpp(1, 0, 2, 8);
+        bool ok1 = false, ok2 = false;
+        std::thread t1{context_worker, 4, &ok1};
+        std::thread t2{context_worker, 6, &ok2};
+        t1.join();
+        t2.join();
+        REQUIRE(ok1);
+        REQUIRE(ok2);
+
+        // The default context is left untouched by the worker threads.
+        REQUIRE(cdd_context_get() == cdd_context_default());
+        REQUIRE(cdd_clocknum == 3);
+        REQUIRE(cdd_equiv(c & cdd_intervalpp(1, 0, 2, 8), c));
+    }
+    cdd_done();
+}
+
+#ifdef CDD_CONCURRENT
+/** Builds the same CDDs as the other workers in the shared forest, starting at \a offset. */
+static void shared_worker(cdd_context* ctx, int32_t offset, std::vector<cdd>* out)
+{
+    int32_t size = out->size();
+    cdd_context_set(ctx);
+    for (int32_t i = 0; i < size; ++i) {
+        int32_t k = (i + offset) % size;
+        (*out)[k] =
+            (cdd_intervalpp(1, 0, k, k + 5) & cdd_intervalpp(2, 1, 0, k)) | cdd_bddvarpp(bdd_start_level + k % 2);
+    }
+    cdd_context_set(nullptr);
+}
+
+TEST_CASE("CDD shared forest")
+{
+    const int32_t threads = 4, size = 2000;
+    cdd_init(100000, 10000, 10000);
+    cdd_add_clocks(3);
+    cdd_add_bddvar(2);
+    {
+        std::vector<cdd_context*> contexts;
+        std::vector<std::vector<cdd>> results(threads, std::vector<cdd>(size));
+        std::vector<std::thread> workers;
+        for (int32_t t = 0; t < threads; ++t) {
+            contexts.push_back(cdd_context_create());
+            REQUIRE(cdd_context_share(contexts[t], 10000, 10000) == 0);
+        }
+        for (int32_t t = 0; t < threads; ++t) {
+            workers.emplace_back(shared_worker, contexts[t], t * size / threads, &results[t]);
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        for (auto* ctx : contexts) {
+            cdd_context_destroy(ctx);
+        }
+
+        // Equal CDDs are represented by the same node in all threads.
+        for (int32_t k = 0; k < size; ++k) {
+            cdd expected =
+                (cdd_intervalpp(1, 0, k, k + 5) & cdd_intervalpp(2, 1, 0, k)) | cdd_bddvarpp(bdd_start_level + k % 2);
+            for (int32_t t = 0; t < threads; ++t) {
+                REQUIRE(results[t][k].handle() == expected.handle());
+            }
+        }
+    }
+    cdd_done();
+}
+#endif /* CDD_CONCURRENT */
+
+TEST_CASE("CDD parallel apply")
+{
+    cdd_init(100000, 10000, 10000);
+    cdd_add_clocks(4);
+    cdd_add_bddvar(3);
+    cdd_parallel_cutoff(4);
+    {
+        cdd a = cdd_false(), b = cdd_false();
+        for (int32_t k = 0; k < 40; ++k) {
+            a |= cdd_intervalpp(1, 0, 3 * k, 3 * k + 2) & cdd_intervalpp(2, 0, k, 2 * k + 7) &
+                 cdd_bddvarpp(bdd_start_level + k % 3);
+            b |= cdd_intervalpp(3, 1, k, k + 4) & cdd_intervalpp(2, 1, 0, 5 * k) &
+                 cdd_bddnvarpp(bdd_start_level + k % 2);
+        }
+        for (int32_t nthreads : {1, 2, 4}) {
+            // Hash-consing makes the result the same node as the sequential one.
+            REQUIRE(cdd_apply_parallel(a, b, cddop_and, nthreads).handle() == cdd_apply(a, b, cddop_and).handle());
+            REQUIRE(cdd_apply_parallel(a, !b, cddop_xor, nthreads).handle() == cdd_apply(a, !b, cddop_xor).handle());
+        }
+#ifdef CDD_CACHESTATS
+        // The top level is looked up before forking, so repeating the apply is a single cache hit
+        CddCacheStats before, after;
+        cdd c = cdd_apply_parallel(a, !b, cddop_and, 4);
+        cdd_cache_stats(&before);
+        REQUIRE(cdd_apply_parallel(a, !b, cddop_and, 4).handle() == c.handle());
+        cdd_cache_stats(&after);
+        REQUIRE(after.apply.lookups == before.apply.lookups + 1);
+        REQUIRE(after.apply.hits == before.apply.hits + 1);
+#endif
+    }
+    cdd_done();
+}
+
+TEST_CASE("CDD releases empty chunks")
+{
+    cdd_init(100000, 10000, 10000);
+    cdd_add_clocks(2);
+    cdd_chunk_retention(1);
+    int32_t peak;
+    {
+        // Bounded intervals are nodes with three children.
+        std::vector<cdd> intervals;
+        for (int32_t k = 0; k < 5000; ++k) {
+            intervals.push_back(cdd_intervalpp(1, 0, k, k + 1));
+        }
+        peak = cdd_context_get()->cddman[cdd_sizeclass(3)]->chunkcnt;
+        REQUIRE(peak > 2);
+    }
+    NodeManager* man = cdd_context_get()->cddman[cdd_sizeclass(3)];
+    int32_t gbccnt = man->gbccnt;
+    for (int32_t k = 5000; man->gbccnt == gbccnt; ++k) {
+        cdd_intervalpp(1, 0, k, k + 1);
+    }
+    // All nodes were dead, so only the retained chunk is left.
+    REQUIRE(man->chunkcnt == 1);
+    REQUIRE(man->freecnt + man->usedcnt + man->deadcnt == man->alloccnt);
+    cdd_done();
+}
+
+TEST_CASE("CDD node size classes")
+{
+    cdd_init(100000, 10000, 10000);
+    cdd_add_clocks(2);
+    {
+        // The classes grow by alternating factors of 3/2 and 4/3
+        const int32_t sizes[] = {2, 3, 4, 6, 8, 12, 16, 24, 32, 48, 64};
+        for (int32_t c = 1; c <= 11; ++c) {
+            REQUIRE(cdd_classsize(c) == sizes[c - 1]);
+            REQUIRE(cdd_sizeclass(sizes[c - 1]) == c);
+            REQUIRE(cdd_sizeclass(sizes[c - 1] + 1) == c + 1);
+        }
+
+        // Nodes of every arity from 2 to 64 take one chunk in each of 11 managers
+        int32_t level = cdd_rglr(cdd_intervalpp(1, 0, 2, 4).handle())->level;
+        auto make = [level](int32_t len) {
+            Elem* top = cdd_refstacktop;
+            for (int32_t i = 0; i < len; ++i) {
+                cdd_push(i % 2 ? cddtrue : cddfalse, i < len - 1 ? 2 * i + 1 : INF);
+            }
+            cdd_refstacktop = top;
+            return cdd_make_cdd_node(level, top, len);
+        };
+        std::vector<cdd> nodes;
+        for (int32_t len = 2; len <= 64; ++len) {
+            nodes.push_back(cdd(make(len)));
+        }
+        cdd_context* ctx = cdd_context_get();
+        REQUIRE(ctx->maxcddused == cdd_sizeclass(64));
+        for (int32_t c = 1; c <= ctx->maxcddused; ++c) {
+            REQUIRE(ctx->cddman[c]->chunkcnt == 1);
+        }
+
+        // Nodes of a class differing only in arity are told apart in the shared subtable
+        cdd_gbc();
+        for (int32_t len = 2; len <= 64; ++len) {
+            REQUIRE(cdd_node(nodes[len - 2].handle())->len == (uint32_t)len);
+            REQUIRE(make(len) == nodes[len - 2].handle());
+        }
+    }
+    cdd_done();
+}
+
+static CddCompactStat last_compaction;
+
+static cdd compaction_sample(int32_t k)
+{
+    return (cdd_intervalpp(1, 0, k % 40, k % 40 + 3) & cdd_intervalpp(2, 1, k % 7, 2 * (k % 7) + 5)) |
+           (cdd_intervalpp(3, 0, k, k + 2) & cdd_bddvarpp(bdd_start_level + k % 2));
+}
+
+TEST_CASE("CDD compaction")
+{
+    cdd_init(100000, 10000, 10000);
+    cdd_add_clocks(4);
+    cdd_add_bddvar(2);
+    cdd_compact_threshold(100);
+    cdd_chunk_retention(0);
+    cdd_postcompact_hook([](CddCompactStat* s) { last_compaction = *s; });
+    {
+        std::vector<cdd> kept;
+        for (int32_t k = 0; k < 3000; ++k) {
+            kept.push_back(compaction_sample(k));
+        }
+        // Keep every fifth, leaving the survivors scattered over the chunks.
+        for (int32_t i = 0; i < (int32_t)kept.size() / 5; ++i) {
+            kept[i] = kept[5 * i];
+        }
+        kept.resize(kept.size() / 5);
+        // A node referenced through the C interface must stay where it is.
+        ddNode* raw;
+        {
+            cdd c = compaction_sample(1);
+            raw = c.handle();
+            cdd_ref(raw);
+        }
+        int32_t chunks = cdd_context_get()->chunkcnt;
+
+        cdd_compact();
+        REQUIRE(last_compaction.num == 1);
+        REQUIRE(last_compaction.moved > 0);
+        REQUIRE(last_compaction.pinned > 0);
+        REQUIRE(cdd_context_get()->chunkcnt < chunks);
+        REQUIRE(raw == compaction_sample(1).handle());
+        for (int32_t i = 0; i < (int32_t)kept.size(); ++i) {
+            // The relocated nodes are found again by the unique tables.
+            REQUIRE(kept[i] == compaction_sample(5 * i));
+            REQUIRE((kept[i] & !kept[i]) == cdd_false());
+        }
+        NodeManager* man = cdd_context_get()->bddman;
+        REQUIRE(man->freecnt + man->usedcnt + man->deadcnt == man->alloccnt);
+        for (int32_t i = 1; i <= cdd_context_get()->maxcddused; ++i) {
+            if ((man = cdd_context_get()->cddman[i]) != nullptr) {
+                REQUIRE(man->freecnt + man->usedcnt + man->deadcnt == man->alloccnt);
+            }
+        }
+        cdd_rec_deref(raw);
+    }
+    cdd_done();
+}
+
+TEST_CASE("CDD node handles")
+{
+    cdd_init(100000, 10000, 10000);
+    cdd_add_clocks(3);
+    cdd_add_bddvar(2);
+    cdd_add_tautologies(2);
+    {
+        cdd b = cdd_bddvarpp(bdd_start_level);
+        cdd c = cdd_intervalpp(1, 0, 2, 5) & b;
+        cdd d(cdd_apply_tautology(c.handle(), 1));
+        std::vector<ddNode*> nodes = {cddfalse, cddtrue, b.handle(), c.handle(), d.handle(),
+                                      cdd_context_get()->xterms[0], cdd_context_get()->xterms[1]};
+        for (ddNode* node : nodes) {
+            REQUIRE(cdd_ptr(cdd_handle(node)) == node);
+            REQUIRE(cdd_ptr(cdd_handle(cdd_neg(node))) == cdd_neg(node));
+        }
+        REQUIRE(bdd_low(cdd_neg(b.handle())) == cddtrue);
+        REQUIRE(bdd_high(cdd_neg(b.handle())) == cddfalse);
+    }
+#ifdef CDD_COMPRESSED
+    REQUIRE(sizeof(Elem) == 8);
+    REQUIRE(sizeof(bddNode) == 16);
+#endif
+    cdd_done();
+}
+
+TEST_CASE("CDD reference count overflow")
+{
+    cdd_init(100000, 10000, 10000);
+    cdd_add_clocks(2);
+    {
+        std::vector<ddNode*> nodes;
+        for (int32_t k = 0; k < 100; ++k) {
+            cdd c = cdd_intervalpp(1, 0, 2 * k, 2 * k + 10);
+            nodes.push_back(c.handle());
+            cdd_ref(nodes.back());
+        }
+        for (ddNode* node : nodes) {
+            for (int32_t i = 0; i < 2 * MAXREF; ++i) {
+                cdd_ref(node);
+            }
+            REQUIRE(cdd_rglr(node)->ref == OVERREF);
+        }
+        REQUIRE(cdd_context_get()->overflowcnt == 100);
+        for (ddNode* node : nodes) {
+            for (int32_t i = 0; i < 2 * MAXREF; ++i) {
+                cdd_deref(node);
+            }
+            REQUIRE(cdd_rglr(node)->ref == 1);
+        }
+        REQUIRE(cdd_context_get()->overflowcnt == 0);
+
+        // Nodes which had overflowed can still die
+        for (ddNode* node : nodes) {
+            cdd_rec_deref(node);
+            REQUIRE((cdd_rglr(node)->flag & MARKDEAD) != 0);
+        }
+    }
+    cdd_done();
+}
+
+TEST_CASE("CDD reference stack grows")
+{
+    cdd_init(100000, 10000, 16);
+    cdd_add_clocks(2);
+    {
+        Elem* base = cdd_refstack;
+        size_t size = cdd_refstacksize;
+        for (size_t i = 0; i < 4 * size; ++i) {
+            cdd_push(cddtrue, (raw_t)i);
+        }
+        REQUIRE(cdd_get_error() == 0);
+        REQUIRE(cdd_refstack == base);
+        REQUIRE(cdd_refstacksize >= 4 * size);
+        REQUIRE(cdd_refstacktop == base + 4 * size);
+        for (size_t i = 0; i < 4 * size; ++i) {
+            REQUIRE(base[i].bnd == (raw_t)i);
+        }
+        cdd_refstacktop = base;
+
+        // Growing beyond the reserved address space is an error, which stays set until it is cleared
+        REQUIRE(cdd_refstack_grow((char*)base + cdd_context_get()->refstackreserve + 1) == 0);
+        REQUIRE(cdd_get_error() == CDD_STACKOVERFLOW);
+        REQUIRE(cdd_apply(cddtrue, cddfalse, cddop_xor) == nullptr);
+        cdd_clear_error();
+        REQUIRE(cdd_get_error() == 0);
+        REQUIRE(cdd_apply(cddtrue, cddfalse, cddop_xor) == cddtrue);
+    }
+    cdd_done();
+}
+
+TEST_CASE("CDD operators back off on errors")
+{
+    cdd_init(8, 10000, 10000);  // nodes have at most 8 children
+    cdd_add_clocks(2);
+    {
+        // 5 children each, while their exclusive or has 9
+        cdd a = cdd_intervalpp(1, 0, 0, 4) | cdd_intervalpp(1, 0, 8, 12);
+        cdd b = cdd_intervalpp(1, 0, 2, 6) | cdd_intervalpp(1, 0, 10, 14);
+        cdd_gbc();
+        int32_t used = cdd_usednodes();
+
+        REQUIRE(cdd_apply(a.handle(), b.handle(), cddop_xor) == nullptr);
+        REQUIRE(cdd_get_error() == CDD_MAXSIZE);
+        REQUIRE(cdd_refstacktop == cdd_refstack);
+
+        // Operations back off while the error is set
+        REQUIRE(cdd_apply(a.handle(), b.handle(), cddop_and) == nullptr);
+        cdd_clear_error();
+
+        REQUIRE(cdd_ite(a.handle(), b.handle(), cdd_neg(b.handle())) == nullptr);
+        REQUIRE(cdd_get_error() == CDD_MAXSIZE);
+        REQUIRE(cdd_refstacktop == cdd_refstack);
+        cdd_clear_error();
+
+        // The C++ interface throws and clears the error
+        REQUIRE_THROWS_AS(a ^ b, std::runtime_error);
+        REQUIRE(cdd_get_error() == 0);
+
+        // No reference was leaked by the partial results
+        REQUIRE(cdd_usednodes() == used);
+
+        cdd d = a & b;
+        REQUIRE(cdd_equiv(d, cdd_intervalpp(1, 0, 2, 4) | cdd_intervalpp(1, 0, 10, 12)));
+    }
+    cdd_done();
+}
+
+TEST_CASE("CDD cache statistics")
+{
+    cdd_init(100000, 10000, 10000);
+    cdd_add_clocks(3);
+    {
+        cdd a = cdd_intervalpp(1, 0, 2, 10) | cdd_intervalpp(2, 0, 4, 8);
+        cdd b = cdd_intervalpp(2, 1, 0, 6);
+        cdd c = a & b;
+        cdd d = a & b;
+        CddCacheStats stats;
+        cdd_cache_stats(&stats);
+#ifdef CDD_CACHESTATS
+        REQUIRE(stats.apply.lookups > 0);
+        REQUIRE(stats.apply.hits > 0);
+        REQUIRE(stats.apply.hits + stats.apply.overwrites <= stats.apply.lookups);
+#else
+        REQUIRE(stats.apply.lookups == 0);
+        REQUIRE(stats.apply.hits == 0);
+#endif
+        REQUIRE(stats.relax.lookups == 0);
+    }
+    cdd_done();
+}
+
+TEST_CASE("CDD two-way operation cache")
+{
+    cdd_init(100000, 4, 10000);  // the smallest cache, two sets of two entries
+    cdd_add_clocks(3);
+    cdd_cache_limit(0);
+    {
+        // A conjunction of single nodes on different levels with terminal children stores one entry
+        cdd a = cdd_upperpp(1, 0, 10), b = cdd_upperpp(2, 0, 20);
+        cdd c = cdd_upperpp(2, 1, 4), d = cdd_upperpp(1, 0, 30);
+        cdd ab = a & b;
+        cdd cd = c & d;
+        CddCacheStats before, after;
+        cdd_cache_stats(&before);
+        REQUIRE((a & b).handle() == ab.handle());
+        REQUIRE((c & d).handle() == cd.handle());
+        cdd_cache_stats(&after);
+#ifdef CDD_CACHESTATS
+        // Both entries are kept even if their keys select the same set
+        REQUIRE(after.apply.lookups == before.apply.lookups + 2);
+        REQUIRE(after.apply.hits == before.apply.hits + 2);
+        REQUIRE(after.apply.overwrites == before.apply.overwrites);
+#endif
+    }
+    cdd_done();
+}
+
+TEST_CASE("CDD cache entries do not survive garbage collection")
+{
+    cdd_init(100000, 10000, 10000);
+    cdd_add_clocks(3);
+    {
+        cdd a = cdd_intervalpp(1, 0, 2, 10) | cdd_intervalpp(2, 0, 4, 8);
+        cdd b = cdd_intervalpp(2, 1, 0, 6);
+        cdd c = a & b;
+        CddCacheStats before, between, after;
+        cdd_cache_stats(&before);
+        REQUIRE((a & b).handle() == c.handle());
+        cdd_cache_stats(&between);
+        cdd_gbc();
+        REQUIRE((a & b).handle() == c.handle());
+        cdd_cache_stats(&after);
+#ifdef CDD_CACHESTATS
+        // Answered from the cache before the collection, recomputed after it
+        REQUIRE(between.apply.hits == before.apply.hits + 1);
+        REQUIRE(between.apply.lookups == before.apply.lookups + 1);
+        REQUIRE(after.apply.hits == between.apply.hits);
+        REQUIRE(after.apply.lookups > between.apply.lookups);
+        REQUIRE(after.apply.stale >= 1);
+#else
+        REQUIRE(after.apply.stale == 0);
+#endif
+    }
+    cdd_done();
+}
+
+TEST_CASE("CDD adaptive operation caches")
+{
+    cdd_init(100000, 16, 10000);
+    cdd_add_clocks(4);
+    {
+        // The tiny caches are resized many times, also while operations are in progress
+        cdd x = cdd_false(), y = cdd_false();
+        for (int32_t i = 0; i < 40; ++i) {
+            x |= cdd_intervalpp(1 + i % 3, 0, i, i + 5) & cdd_intervalpp(2 + i % 2, 1, -i, 3);
+        }
+        cdd_cache_limit(0);
+        for (int32_t i = 39; i >= 0; --i) {
+            y |= cdd_intervalpp(1 + i % 3, 0, i, i + 5) & cdd_intervalpp(2 + i % 2, 1, -i, 3);
+        }
+        REQUIRE(cdd_equiv(x, y));
+
+        // A ceiling below the minimum size keeps the caches usable
+        cdd_cache_limit(1);
+        REQUIRE(cdd_equiv(x & y, x));
+    }
+    cdd_done();
+}
+
+TEST_CASE_FIXTURE(cdd_sample, "CDD reduce of a reduced CDD")
+{
+    // The first disjunct is empty, so its node is removed by reduce
+    cdd c = empty | (b & b0);
+    cdd r = cdd_reduce(c);
+    REQUIRE(cdd_equiv(r, c));
+    REQUIRE(cdd_equiv(r, b & b0));
+
+    CddCacheStats before, after;
+    cdd_cache_stats(&before);
+    REQUIRE(cdd_reduce(r) == r);
+    REQUIRE(cdd_reduce(c) == r);
+    cdd_cache_stats(&after);
+#ifdef CDD_CACHESTATS
+    REQUIRE(after.apply.hits >= before.apply.hits + 2);
+#endif
+
+    // The results are recomputed after garbage collection
+    cdd_gbc();
+    REQUIRE(cdd_reduce(r) == r);
+    REQUIRE(cdd_reduce(b0 & r) == cdd_reduce(b0 & c));
+}
+
+TEST_CASE_FIXTURE(cdd_sample, "CDD emptiness, equivalence and inclusion")
+{
+    REQUIRE(cdd_is_empty(cdd_false()));
+    REQUIRE_FALSE(cdd_is_empty(cdd_true()));
+    REQUIRE(cdd_is_empty(empty));
+    REQUIRE(cdd_is_empty(empty & b0));
+    REQUIRE_FALSE(cdd_is_empty(a));
+    REQUIRE(cdd_is_empty(a & !a));
+    REQUIRE(cdd_is_empty(b0 & !b0 & a));
+
+    REQUIRE(cdd_equiv(a & b, b & a));
+    REQUIRE(cdd_equiv(a | empty, a));
+    REQUIRE(cdd_equiv((b0 & a) | (!b0 & a), a));
+    REQUIRE(cdd_equiv(!(a & b1), !a | !b1));
+    REQUIRE_FALSE(cdd_equiv(a, b));
+    REQUIRE_FALSE(cdd_equiv(a & b0, a));
+    REQUIRE_FALSE(cdd_equiv(a, !a));
+    REQUIRE(cdd_contains(b, point(0, 0).raw(), 3));  // x1 < 2 and x2 < 4 is outside a
+    REQUIRE_FALSE(cdd_contains(a, point(0, 0).raw(), 3));
+
+    REQUIRE(cdd_subset(a & b, a));
+    REQUIRE(cdd_subset(empty, b & b0));
+    REQUIRE(cdd_subset(a, cdd_true()));
+    REQUIRE(cdd_subset(cdd_false(), a));
+    REQUIRE(cdd_subset(a & b0, a | b));
+    REQUIRE_FALSE(cdd_subset(a, a & b));
+    REQUIRE_FALSE(cdd_subset(a, a & b0));
+    REQUIRE_FALSE(cdd_subset(cdd_true(), a));
+
+    // Valuations outside the supersets
+    REQUIRE(cdd_contains(a & b, point(2, 3).raw(), 3));
+    REQUIRE(cdd_contains(a, point(2, 0).raw(), 3));  // x2 - x1 = -2 is below b
+    REQUIRE_FALSE(cdd_contains(a & b, point(2, 0).raw(), 3));
+    REQUIRE_FALSE(cdd_contains(a | b, point(1, 9).raw(), 3));
+    REQUIRE(cdd_subset(x2_range & b, at_most(1, 0, 8)));  // x1 <= x2 <= 8
+    REQUIRE_FALSE(cdd_subset(x2_range & b, at_most(1, 0, 7)));
+    REQUIRE(cdd_contains(x2_range & b, point(8, 8).raw(), 3));
+
+    // The walk agrees with reducing the symmetric difference
+    cdd cases[] = {a, b, empty, a & b, a - b, (a & b0) | (b & b1), (a ^ b) & empty};
+    for (const cdd& x : cases) {
+        REQUIRE(cdd_is_empty(x) == (cdd_reduce(x) == cdd_false()));
+        for (const cdd& y : cases) {
+            REQUIRE(cdd_equiv(x, y) == (cdd_reduce(x ^ y) == cdd_false()));
+            REQUIRE(cdd_subset(x, y) == (cdd_reduce(x - y) == cdd_false()));
+        }
+    }
+}
+
+TEST_CASE_FIXTURE(cdd_sample, "CDD if then else")
+{
+    cdd c = b & b2;
+    cdd cases[] = {cdd_true(), cdd_false(), b0, !b1, a, !a, c, a & b0, (a & !b1) | c, b0 ^ b2};
+    for (const cdd& f : cases) {
+        for (const cdd& g : cases) {
+            for (const cdd& h : cases) {
+                cdd ite = cdd_ite(f, g, h);
+                REQUIRE(cdd_equiv(ite, (f & g) | (!f & h)));
+                REQUIRE(cdd_ite(f, g, h) == ite);
+            }
+        }
+    }
+    REQUIRE(cdd_ite(b0, b1, b1) == b1);
+    REQUIRE(cdd_ite(b0, cdd_true(), cdd_false()) == b0);
+    REQUIRE(cdd_ite(b0, cdd_false(), cdd_true()) == !b0);
+    REQUIRE(cdd_equiv(cdd_ite(b0, x1_range, x2_range), (x1_range & b0) | (x2_range & !b0)));
+    REQUIRE(cdd_equiv(cdd_ite(x1_range, b1, b1), b1));
+}
+
+TEST_CASE_FIXTURE(cdd_sample, "CDD fused conjunction and quantification")
+{
+    cdd l = (x1_range & b0) | (x2_range & !b1);
+    cdd r = (b & b2) | (b0 & b1);
+
+    int32_t bools[] = {bdd_start_level, bdd_start_level + 2};
+    REQUIRE(cdd_equiv(cdd_and_exist(l, r, bools, nullptr, 2, 0), cdd_exist(l & r, bools, nullptr, 2, 0)));
+    REQUIRE(cdd_equiv(cdd_and_exist(r, l, bools, nullptr, 1, 0), cdd_exist(l & r, bools, nullptr, 1, 0)));
+    REQUIRE(cdd_equiv(cdd_and_exist(l, !l, bools, nullptr, 2, 0), cdd_false()));
+    REQUIRE(cdd_equiv(cdd_and_exist(l, cdd_true(), bools, nullptr, 2, 0), cdd_exist(l, bools, nullptr, 2, 0)));
+
+    // b0 must hold in the first conjunct, which selects b in the second one
+    REQUIRE(cdd_equiv(cdd_and_exist(a & b0, b | !b0, bools, nullptr, 2, 0), a & b));
+    REQUIRE(cdd_equiv(cdd_and_exist(a & b2, b & !b2, bools, nullptr, 2, 0), cdd_false()));
+    REQUIRE(cdd_equiv(cdd_and_exist(l, b1, bools, nullptr, 1, 0), x1_range & b1));
+
+    // The clock array is indexed by clock number when constraints are relaxed
+    int32_t clocks[] = {2, 0, 0};
+    REQUIRE(cdd_equiv(cdd_and_exist(l, r, bools, clocks, 2, 1), cdd_exist(l & r, bools, clocks, 2, 1)));
+    REQUIRE(cdd_equiv(cdd_and_exist(l, r, nullptr, clocks, 0, 1), cdd_exist(l & r, nullptr, clocks, 0, 1)));
+
+    int32_t set = cdd_register_exist_set(bools, nullptr, 2, 0);
+    REQUIRE(cdd_equiv(cdd_and_exist_set(l, r, set), cdd_exist(l & r, bools, nullptr, 2, 0)));
+}
+
+TEST_CASE_FIXTURE(cdd_sample, "CDD zone iterator")
+{
+    cdd c = (x1_range & b0) | (x2_range & b & !b1);
+    auto dbm = dbm_wrap{3};
+    for (int i = 0; i < 4; ++i) {
+        dbm.generate();
+        c |= cdd(dbm.raw(), 3) & (b0 ^ b1);
+    }
+
+    // The zones are disjoint, consistent and make up the CDD without its negative part
+    std::vector<cdd> zones;
+    cdd all = cdd_false();
+    auto zone = dbm_wrap{3};
+    ddNode* bdd_part;
+    cdd_dbm_iterator* it = cdd_dbm_iterator_create(c.handle(), 3);
+    while (cdd_dbm_iterator_next(it, zone.raw(), &bdd_part)) {
+        REQUIRE(dbm_isValid(zone.raw(), 3));
+        REQUIRE(bdd_part != cddfalse);
+        REQUIRE((cdd_isterminal(bdd_part) || cdd_info(bdd_part)->type == TYPE_BDD));
+        cdd part = cdd(zone.raw(), 3) & cdd(bdd_part);
+        for (auto& other : zones) {
+            REQUIRE(cdd_is_empty(part & other));
+        }
+        zones.push_back(part);
+        all |= part;
+    }
+    REQUIRE(cdd_dbm_iterator_next(it, zone.raw(), &bdd_part) == 0);
+    cdd_dbm_iterator_destroy(it);
+    REQUIRE(cdd_equiv(all, cdd_remove_negative(c)));
+
+    // A BDD is a single zone
+    auto init = dbm_wrap{3};
+    dbm_init(init.raw(), 3);
+    it = cdd_dbm_iterator_create(b0.handle(), 3);
+    REQUIRE(cdd_dbm_iterator_next(it, zone.raw(), &bdd_part) == 1);
+    REQUIRE(zone == init);
+    REQUIRE(bdd_part == b0.handle());
+    REQUIRE(cdd_dbm_iterator_next(it, zone.raw(), &bdd_part) == 0);
+    cdd_dbm_iterator_destroy(it);
+
+    it = cdd_dbm_iterator_create(cddfalse, 3);
+    REQUIRE(cdd_dbm_iterator_next(it, zone.raw(), &bdd_part) == 0);
+    cdd_dbm_iterator_destroy(it);
+
+    // An interval of x1 is a single zone with x2 unconstrained
+    auto expected = dbm_wrap{3};
+    dbm_init(expected.raw(), 3);
+    dbm_constrain1(expected.raw(), 3, 1, 0, dbm_bound2raw(10, dbm_WEAK));
+    dbm_constrain1(expected.raw(), 3, 0, 1, dbm_bound2raw(-2, dbm_WEAK));
+    cdd single = x1_range & b0;
+    it = cdd_dbm_iterator_create(single.handle(), 3);
+    REQUIRE(cdd_dbm_iterator_next(it, zone.raw(), &bdd_part) == 1);
+    REQUIRE(zone == expected);
+    REQUIRE(bdd_part == b0.handle());
+    REQUIRE(cdd_dbm_iterator_next(it, zone.raw(), &bdd_part) == 0);
+    cdd_dbm_iterator_destroy(it);
+}
+
+TEST_CASE("CDD delay and past per node")
+{
+    auto session = cdd_session{4, 2};
+    cdd b0 = cdd_bddvarpp(bdd_start_level), b1 = cdd_bddvarpp(bdd_start_level + 1);
+    cdd c = (cdd_intervalpp(1, 0, 2, 10) & cdd_intervalpp(3, 0, 1, 4) & b0) |
+            (cdd_intervalpp(2, 0, 4, 8) & cdd_intervalpp(2, 1, 0, 6) & !b1);
+    auto dbm = dbm_wrap{4};
+    for (int i = 0; i < 6; ++i) {
+        dbm.generate();
+        c |= cdd(dbm.raw(), 4) & (i % 2 ? b0 : b1);
+    }
+
+    // Compare with delaying the zones one by one
+    cdd up = cdd_false(), down = cdd_false();
+    ddNode* bdd_part;
+    cdd_dbm_iterator* it = cdd_dbm_iterator_create(c.handle(), 4);
+    while (cdd_dbm_iterator_next(it, dbm.raw(), &bdd_part)) {
+        auto copy = dbm;
+        dbm_up(dbm.raw(), 4);
+        up |= cdd(dbm.raw(), 4) & cdd(bdd_part);
+        dbm_down(copy.raw(), 4);
+        down |= cdd(copy.raw(), 4) & cdd(bdd_part);
+    }
+    cdd_dbm_iterator_destroy(it);
+
+    REQUIRE(cdd_equiv(cdd_delay(c), up));
+    REQUIRE(cdd_equiv(cdd_past(c), down));
+    REQUIRE(cdd_equiv(cdd_up(cdd_up(c)), cdd_up(c)));
+    REQUIRE(cdd_equiv(cdd_up(b0), b0));
+
+    // x1 <= 5 and x2 >= 3 keeps x1 - x2 <= 2 when delayed
+    cdd x2_from_3 = cdd_intervalpp(2, 0, 6, dbm_LS_INFINITY);
+    cdd z = cdd_intervalpp(1, 0, 0, dbm_bound2raw(5, dbm_WEAK)) & x2_from_3;
+    REQUIRE(cdd_equiv(cdd_delay(z), cdd_remove_negative(cdd_upperpp(1, 2, dbm_bound2raw(2, dbm_WEAK)) & x2_from_3)));
+
+    // 2 <= x1 <= 5 and 1 <= x2 <= 3 keep -1 <= x1 - x2 <= 4 in the future and in the past
+    cdd w = at_least(1, 0, 2) & at_most(1, 0, 5) & at_least(2, 0, 1) & at_most(2, 0, 3);
+    cdd diagonal = at_most(1, 2, 4) & at_most(2, 1, 1);
+    cdd w_up = at_least(1, 0, 2) & at_least(2, 0, 1) & diagonal;
+    REQUIRE(cdd_equiv(cdd_up(w), w_up));
+    REQUIRE(cdd_equiv(cdd_down(w), at_most(1, 0, 5) & at_most(2, 0, 3) & diagonal));
+
+    // Each BDD part is delayed on its own, and x1 <= 1 reaches any valuation
+    REQUIRE(cdd_equiv(cdd_up((w & b0) | (at_most(1, 0, 1) & !b0)), (w_up & b0) | !b0));
+    REQUIRE(cdd_equiv(cdd_down((w & b1) | (at_least(3, 0, 7) & b0)), (cdd_down(w) & b1) | b0));
+}
+
+TEST_CASE_FIXTURE(cdd_sample, "CDD to federation")
+{
+    cdd zones = x1_range | (x2_range & b);
+    auto dbm = dbm_wrap{3};
+    for (int i = 0; i < 4; ++i) {
+        dbm.generate();
+        zones |= cdd(dbm.raw(), 3);
+    }
+    REQUIRE(cdd_equiv(cdd_from_fed(cdd_to_fed(zones)), cdd_remove_negative(zones)));
+    REQUIRE(cdd_to_fed(cdd_false()).isEmpty());
+
+    // One federation per BDD part, which together make up the CDD
+    cdd c = (zones & b0) | (cdd_intervalpp(1, 0, 4, 12) & !b0 & b1);
+    auto parts = cdd_to_fed_partitioned(c);
+    cdd rebuilt = cdd_false();
+    for (size_t i = 0; i < parts.size(); ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            REQUIRE(parts[i].first != parts[j].first);
+        }
+        REQUIRE(cdd_isBDD(parts[i].first));
+        rebuilt |= cdd_from_fed(parts[i].second) & parts[i].first;
+    }
+    REQUIRE(cdd_equiv(rebuilt, cdd_remove_negative(c)));
+
+    // The zones under b0 and !b0 are merged by cdd_to_fed and kept apart by the partition
+    cdd low = at_least(1, 0, 2) & at_most(1, 0, 5), high = at_least(1, 0, 7) & at_most(1, 0, 9);
+    cdd two = (low & b0) | (high & !b0);
+    REQUIRE(cdd_equiv(cdd_from_fed(cdd_to_fed(two)), cdd_remove_negative(low | high)));
+    auto split = cdd_to_fed_partitioned(two);
+    REQUIRE(split.size() == 2);
+    for (auto& [part, fed] : split) {
+        REQUIRE((part == b0 || part == !b0));
+        REQUIRE(cdd_equiv(cdd_from_fed(fed), cdd_remove_negative(part == b0 ? low : high)));
+    }
+}
+
+TEST_CASE_FIXTURE(cdd_sample, "CDD registered variable maps")
+{
+    cdd c = (x1_range & b0) | (x2_range & b & !b1);
+
+    int32_t bools[] = {bdd_start_level};
+    int32_t set = cdd_register_exist_set(bools, nullptr, 1, 0);
+    REQUIRE(set >= 0);
+    cdd e = cdd_exist_set(c, set);
+    REQUIRE(cdd_equiv(e, cdd_exist(c, bools, nullptr, 1, 0)));
+    REQUIRE(cdd_equiv(e, x1_range | (x2_range & b & !b1)));
+
+    // A later call with the same handle is answered from the cache
+    CddCacheStats before, after;
+    cdd_cache_stats(&before);
+    REQUIRE(cdd_exist_set(c, set) == e);
+    cdd_cache_stats(&after);
+#ifdef CDD_CACHESTATS
+    REQUIRE(after.quant.hits > before.quant.hits);
+#endif
+
+    std::vector<int32_t> levels(cdd_levelcnt);
+    for (int32_t i = 0; i < cdd_levelcnt; ++i) {
+        levels[i] = i;
+    }
+    int32_t clocks[] = {0, 1, 2};
+    int32_t map = cdd_register_replace_map(levels.data(), clocks);
+    REQUIRE(map >= 0);
+    REQUIRE(map != set);
+    REQUIRE(cdd_equiv(cdd_replace_map(c, map), cdd_replace(c, levels.data(), clocks)));
+    REQUIRE(cdd_equiv(cdd_replace_map(c, map), c));
+
+    REQUIRE(cdd_exist_set(c.handle(), map + 1) == nullptr);
+
+    // A handle of the other kind, or registered before variables were added, is rejected
+    REQUIRE(cdd_exist_set(c.handle(), map) == nullptr);
+    REQUIRE(cdd_replace_map(c.handle(), set) == nullptr);
+    cdd_add_bddvar(1);
+    REQUIRE(cdd_exist_set(c.handle(), set) == nullptr);
+    REQUIRE(cdd_replace_map(c.handle(), map) == nullptr);
+}
+
+/** Returns the zone where \a lower <= x1 <= \a upper. */
+static void interval_dbm(raw_t* dbm, int32_t lower, int32_t upper)
+{
+    dbm_init(dbm, 2);
+    dbm_constrain1(dbm, 2, 1, 0, dbm_bound2raw(upper, dbm_WEAK));
+    dbm_constrain1(dbm, 2, 0, 1, dbm_bound2raw(-lower, dbm_WEAK));
+}
+
+TEST_CASE("CDD bound search")
+{
+    std::vector<raw_t> bnd;
+    for (int32_t len = 0; len < 20; ++len) {
+        for (raw_t x = -12; x <= 2 * len - 8; ++x) {
+            int32_t expected = 0;
+            while (expected < len && bnd[expected] < x) {
+                expected++;
+            }
+            REQUIRE(cdd_bound_search(bnd.data(), len, x) == expected);
+        }
+        bnd.push_back(2 * len - 10);
+    }
+
+    cdd_init(100000, 10000, 10000);
+    cdd_add_clocks(2);
+    {
+        raw_t dbm[4];
+        cdd c = cdd_false();
+        for (int32_t k = 0; k < 30; ++k) {
+            interval_dbm(dbm, 4 * k, 4 * k + 1);
+            c |= cdd(dbm, 2);
+        }
+
+        // The bounds are sorted and followed by the children.
+        ddNode* node = cdd_rglr(c.handle());
+        REQUIRE(cdd_info(node)->type == TYPE_CDD);
+        cddNode* wide = cdd_node(node);
+        REQUIRE(wide->len > 8);
+        REQUIRE(wide->bnd[wide->len - 1] == INF);
+        for (uint32_t i = 1; i < wide->len; ++i) {
+            REQUIRE(wide->bnd[i - 1] < wide->bnd[i]);
+        }
+        REQUIRE((char*)cdd_children(node) >= (char*)(wide->bnd + wide->len));
+
+        for (int32_t k = 0; k < 30; ++k) {
+            interval_dbm(dbm, 4 * k, 4 * k + 1);
+            REQUIRE(cdd_contains(c, dbm, 2));
+            interval_dbm(dbm, 4 * k + 2, 4 * k + 3);
+            REQUIRE_FALSE(cdd_contains(c, dbm, 2));
+            interval_dbm(dbm, 4 * k, 4 * k + 2);
+            REQUIRE_FALSE(cdd_contains(c, dbm, 2));
+        }
+    }
+    cdd_done();
+}
+
 TEST_CASE("Big CDD test")
 {
     uint32_t seed{};